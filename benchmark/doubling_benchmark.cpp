@@ -0,0 +1,177 @@
+/*
+  Copyright (c) 2016 Genome Research Ltd.
+
+  Author: Jouni Siren <jouni.siren@iki.fi>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include <gcsa/gcsa.h>
+#include <gcsa/lcp.h>
+
+using namespace gcsa;
+
+/*
+  Compares building an index of the same order from short kmers with more doubling steps
+  and from long kmers with fewer doubling steps. Both inputs should be generated from the
+  same graph, with the long kmers 2^i times the length of the short kmers. Kmers longer
+  than 16 require compiling GCSA and this program with GCSA_WIDE_KEYS.
+*/
+
+//------------------------------------------------------------------------------
+
+struct BuildResult
+{
+  double    seconds;
+  size_type read_bytes, write_bytes;
+  size_type kmers, paths, order;
+  std::string index;  // Serialized index.
+};
+
+BuildResult buildIndex(const std::string& base_name, bool binary, ConstructionParameters parameters, size_type steps);
+void printResult(const std::string& header, const BuildResult& result);
+
+//------------------------------------------------------------------------------
+
+int
+main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    std::cerr << "usage: doubling_benchmark [options] short_base long_base" << std::endl;
+    std::cerr << "  -d N  Doubling steps with the short kmers (default " << ConstructionParameters::DOUBLING_STEPS << ")" << std::endl;
+    std::cerr << "  -m N  Limit the memory usage of construction to N gigabytes (default " << ConstructionParameters::MEMORY_LIMIT << ")" << std::endl;
+    std::cerr << "  -t    Read the input in text format" << std::endl;
+    std::cerr << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+
+  int c = 0;
+  bool binary = true;
+  size_type short_steps = ConstructionParameters::DOUBLING_STEPS;
+  ConstructionParameters parameters;
+  while((c = getopt(argc, argv, "d:m:t")) != -1)
+  {
+    switch(c)
+    {
+    case 'd':
+      short_steps = std::stoul(optarg); break;
+    case 'm':
+      parameters.setMemoryLimit(std::stoul(optarg)); break;
+    case 't':
+      binary = false; break;
+    case '?':
+      std::exit(EXIT_FAILURE);
+    default:
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if(optind + 1 >= argc)
+  {
+    std::cerr << "doubling_benchmark: Two base names required" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string short_name = argv[optind], long_name = argv[optind + 1];
+
+  // Determine the number of doubling steps with the long kmers.
+  size_type short_k = 0, long_k = 0;
+  {
+    std::vector<std::string> short_files(1, short_name + (binary ? InputGraph::BINARY_EXTENSION : InputGraph::TEXT_EXTENSION));
+    std::vector<std::string> long_files(1, long_name + (binary ? InputGraph::BINARY_EXTENSION : InputGraph::TEXT_EXTENSION));
+    size_type old_level = Verbosity::level; Verbosity::set(Verbosity::SILENT);
+    InputGraph short_graph(short_files, binary), long_graph(long_files, binary);
+    Verbosity::set(old_level);
+    short_k = short_graph.k(); long_k = long_graph.k();
+  }
+  size_type saved_steps = 0;
+  while(short_k << (saved_steps + 1) <= long_k) { saved_steps++; }
+  if(short_k == 0 || (short_k << saved_steps) != long_k || saved_steps == 0 || saved_steps > short_steps)
+  {
+    std::cerr << "doubling_benchmark: Cannot match " << short_k << "-mers with " << short_steps
+              << " doubling steps using " << long_k << "-mers" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  size_type long_steps = short_steps - saved_steps;
+
+  std::cout << "GCSA doubling benchmark" << std::endl;
+  std::cout << std::endl;
+  printHeader("Short kmers"); std::cout << short_name << " (k = " << short_k << ", " << short_steps << " steps)" << std::endl;
+  printHeader("Long kmers"); std::cout << long_name << " (k = " << long_k << ", " << long_steps << " steps)" << std::endl;
+  printHeader("Input format"); std::cout << (binary ? "binary" : "text") << std::endl;
+  printHeader("Memory limit"); std::cout << inGigabytes(parameters.memory_limit) << " GB" << std::endl;
+  printHeader("Threads"); std::cout << omp_get_max_threads() << std::endl;
+  printHeader("Key width"); std::cout << (sizeof(key_type) * BYTE_BITS) << " bits" << std::endl;
+  std::cout << std::endl;
+
+  BuildResult short_result = buildIndex(short_name, binary, parameters, short_steps);
+  printResult("Short kmers", short_result);
+  BuildResult long_result = buildIndex(long_name, binary, parameters, long_steps);
+  printResult("Long kmers", long_result);
+
+  printHeader("Speedup"); std::cout << (short_result.seconds / long_result.seconds) << "x" << std::endl;
+  printHeader("Same index"); std::cout << (short_result.index == long_result.index ? "yes" : "no") << std::endl;
+  printHeader("Memory usage"); std::cout << inGigabytes(memoryUsage()) << " GB (peak of both builds)" << std::endl;
+  std::cout << std::endl;
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+BuildResult
+buildIndex(const std::string& base_name, bool binary, ConstructionParameters parameters, size_type steps)
+{
+  BuildResult result;
+  parameters.setSteps(steps);
+  size_type old_level = Verbosity::level; Verbosity::set(Verbosity::SILENT);
+  size_type read_start = readVolume(), write_start = writeVolume();
+
+  double start = readTimer();
+  std::vector<std::string> files(1, base_name + (binary ? InputGraph::BINARY_EXTENSION : InputGraph::TEXT_EXTENSION));
+  InputGraph graph(files, binary);
+  GCSA index(graph, parameters);
+  result.seconds = readTimer() - start;
+
+  result.read_bytes = readVolume() - read_start;
+  result.write_bytes = writeVolume() - write_start;
+  result.kmers = graph.size(); result.paths = index.size(); result.order = index.order();
+  std::ostringstream out;
+  index.serialize(out);
+  result.index = out.str();
+  Verbosity::set(old_level);
+
+  return result;
+}
+
+void
+printResult(const std::string& header, const BuildResult& result)
+{
+  printHeader(header);
+  std::cout << result.kmers << " kmers -> " << result.paths << " paths of order " << result.order << std::endl;
+  printHeader(header);
+  std::cout << "Built in " << result.seconds << " seconds, I/O " << inGigabytes(result.read_bytes) << " GB read, "
+            << inGigabytes(result.write_bytes) << " GB write" << std::endl;
+  std::cout << std::endl;
+}
+
+//------------------------------------------------------------------------------
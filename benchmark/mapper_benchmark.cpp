@@ -0,0 +1,293 @@
+/*
+  Copyright (c) 2016 Genome Research Ltd.
+
+  Author: Jouni Siren <jouni.siren@iki.fi>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <random>
+#include <string>
+#include <unistd.h>
+
+#include <gcsa/dbg.h>
+#include <gcsa/files.h>
+
+using namespace gcsa;
+
+/*
+  Measures the size of the DeBruijnGraph used as the kmer mapper in GCSA construction
+  and the throughput of LF(), which dominates the time spent in the predecessor queries
+  of the final construction loop. The results are compared to the baseline encoding,
+  which stored the predecessors in a single interleaved bitvector. Before the timings,
+  the benchmark checks that both encodings give the same access, rank, select, and LF()
+  answers for every node and comp.
+
+  The baseline bitvector has sigma * edges bits, but only the first sigma * nodes bits
+  are used. The new encoding uses a plain bitvector of nodes bits for each fast comp and
+  sparse bitvectors for the rest. With the default alphabet (sigma = 7, 4 fast comps),
+  the expected reduction is about (7 / 4) * (edges / nodes), or roughly 2x for typical
+  inputs. Each fast comp still needs a bit per node for the plain rank in LF(), so a
+  larger reduction would require a slower encoding.
+*/
+
+//------------------------------------------------------------------------------
+
+struct BaselineMapper
+{
+  sdsl::bit_vector_il<>                bwt;
+  sdsl::bit_vector_il<>::rank_1_type   bwt_rank;
+  sdsl::bit_vector_il<>::select_1_type bwt_select;
+  const DeBruijnGraph*                 mapper;
+
+  BaselineMapper(const std::vector<key_type>& keys, const DeBruijnGraph& _mapper);
+
+  inline bool hasPredecessor(size_type node, comp_type comp) const
+  {
+    return this->bwt[comp * this->mapper->size() + node];
+  }
+
+  // Number of nodes before the given node with predecessor comp.
+  inline size_type rank(size_type node, comp_type comp) const
+  {
+    return this->bwt_rank(comp * this->mapper->size() + node) - this->bwt_rank(comp * this->mapper->size());
+  }
+
+  // The i-th node with predecessor comp, starting from 1.
+  inline size_type select(size_type i, comp_type comp) const
+  {
+    return this->bwt_select(this->bwt_rank(comp * this->mapper->size()) + i) - comp * this->mapper->size();
+  }
+
+  inline size_type LF(size_type node, comp_type comp) const
+  {
+    return this->mapper->node_rank(this->bwt_rank(comp * this->mapper->size() + node));
+  }
+
+  inline size_type bytes() const { return sdsl::size_in_bytes(this->bwt) + sdsl::size_in_bytes(this->bwt_rank); }
+};
+
+BaselineMapper::BaselineMapper(const std::vector<key_type>& keys, const DeBruijnGraph& _mapper) :
+  mapper(&_mapper)
+{
+  // As in the baseline, the bitvector is allocated for sigma * edges bits.
+  sdsl::bit_vector buffer(_mapper.alpha.sigma * _mapper.edgeCount(), 0);
+  for(size_type i = 0; i < keys.size(); i++)
+  {
+    size_type pred = Key::predecessors(keys[i]);
+    for(size_type comp = 0; comp < _mapper.alpha.sigma; comp++)
+    {
+      if(pred & (((size_type)1) << comp)) { buffer[comp * _mapper.size() + i] = 1; }
+    }
+  }
+  this->bwt = buffer; sdsl::util::clear(buffer);
+  sdsl::util::init_support(this->bwt_rank, &(this->bwt));
+  sdsl::util::init_support(this->bwt_select, &(this->bwt));
+}
+
+//------------------------------------------------------------------------------
+
+// Returns the number of queries with different answers.
+size_type verifyMapper(const DeBruijnGraph& mapper, const BaselineMapper& baseline);
+
+//------------------------------------------------------------------------------
+
+template<class Mapper>
+size_type runQueries(const std::string& header, const Mapper& mapper, const std::vector<range_type>& queries);
+
+void printSize(const std::string& header, size_type bytes, size_type nodes);
+
+//------------------------------------------------------------------------------
+
+int
+main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "usage: mapper_benchmark [options] base_name" << std::endl;
+    std::cerr << "  -n N  Run N random queries (default 10000000)" << std::endl;
+    std::cerr << "  -t    Read the input in text format" << std::endl;
+    std::cerr << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+
+  int c = 0;
+  bool binary = true;
+  size_type query_count = 10000000;
+  while((c = getopt(argc, argv, "n:t")) != -1)
+  {
+    switch(c)
+    {
+    case 'n':
+      query_count = std::stoul(optarg); break;
+    case 't':
+      binary = false; break;
+    case '?':
+      std::exit(EXIT_FAILURE);
+    default:
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if(optind >= argc)
+  {
+    std::cerr << "mapper_benchmark: Base name required" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string base_name = argv[optind];
+
+  std::cout << "GCSA mapper benchmark" << std::endl;
+  std::cout << std::endl;
+  printHeader("Base name"); std::cout << base_name << std::endl;
+  printHeader("Input format"); std::cout << (binary ? "binary" : "text") << std::endl;
+  std::cout << std::endl;
+
+  std::vector<key_type> keys;
+  size_type order = 0;
+  Alphabet alpha;
+  {
+    std::vector<std::string> files(1, base_name + (binary ? InputGraph::BINARY_EXTENSION : InputGraph::TEXT_EXTENSION));
+    size_type old_level = Verbosity::level; Verbosity::set(Verbosity::SILENT);
+    InputGraph graph(files, binary);
+    graph.readKeys(keys);
+    Verbosity::set(old_level);
+    order = graph.k(); alpha = graph.alpha;
+  }
+
+  double start = readTimer();
+  DeBruijnGraph mapper(keys, order, alpha);
+  double seconds = readTimer() - start;
+  printHeader("Mapper");
+  std::cout << mapper.size() << " nodes, " << mapper.edgeCount() << " edges, built in " << seconds << " seconds" << std::endl;
+  BaselineMapper baseline(keys, mapper);
+
+  size_type fast_bytes = 0, sparse_bytes = 0;
+  for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
+  {
+    fast_bytes += sdsl::size_in_bytes(mapper.fast_bwt[comp]) + sdsl::size_in_bytes(mapper.fast_rank[comp]);
+    sparse_bytes += sdsl::size_in_bytes(mapper.sparse_bwt[comp]) + sdsl::size_in_bytes(mapper.sparse_rank[comp]);
+  }
+  printSize("Fast comps", fast_bytes, mapper.size());
+  printSize("Sparse comps", sparse_bytes, mapper.size());
+  printSize("Nodes", sdsl::size_in_bytes(mapper.nodes) + sdsl::size_in_bytes(mapper.node_rank), mapper.size());
+  printSize("Mapper", sdsl::size_in_bytes(mapper), mapper.size());
+  printSize("Baseline BWT", baseline.bytes(), mapper.size());
+  printHeader("BWT reduction"); std::cout << (baseline.bytes() / (double)(fast_bytes + sparse_bytes)) << "x" << std::endl;
+  printHeader("Expected");
+  std::cout << (mapper.alpha.sigma * mapper.edgeCount()) / (double)(mapper.alpha.fast_chars * mapper.size())
+            << "x (sigma " << mapper.alpha.sigma << ", " << mapper.alpha.fast_chars << " fast comps, "
+            << (mapper.edgeCount() / (double)(mapper.size())) << " edges/node)" << std::endl;
+  std::cout << std::endl;
+
+  start = readTimer();
+  size_type mismatches = verifyMapper(mapper, baseline);
+  seconds = readTimer() - start;
+  printHeader("Verification");
+  if(mismatches == 0) { std::cout << "same answers as the baseline (" << seconds << " seconds)" << std::endl; }
+  else { std::cout << mismatches << " different answers" << std::endl; }
+  std::cout << std::endl;
+  if(mismatches > 0) { std::exit(EXIT_FAILURE); }
+
+  // Random edges. predecessor() queries existing edges in label order.
+  std::vector<range_type> edges;
+  for(size_type i = 0; i < keys.size(); i++)
+  {
+    size_type pred = Key::predecessors(keys[i]);
+    for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
+    {
+      if(pred & (((size_type)1) << comp)) { edges.push_back(range_type(i, comp)); }
+    }
+  }
+  sdsl::util::clear(keys);
+  if(edges.empty())
+  {
+    std::cerr << "mapper_benchmark: The graph has no edges" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::vector<range_type> queries(query_count);
+  std::mt19937_64 rng(0xDEADBEEF);
+  for(size_type i = 0; i < queries.size(); i++) { queries[i] = edges[rng() % edges.size()]; }
+  sdsl::util::clear(edges);
+
+  size_type random_sum = runQueries("LF() random", mapper, queries);
+  size_type baseline_random_sum = runQueries("Baseline random", baseline, queries);
+  std::sort(queries.begin(), queries.end());
+  size_type sorted_sum = runQueries("LF() sorted", mapper, queries);
+  size_type baseline_sorted_sum = runQueries("Baseline sorted", baseline, queries);
+
+  printHeader("Same results");
+  std::cout << (random_sum == baseline_random_sum && sorted_sum == baseline_sorted_sum ? "yes" : "no") << std::endl;
+  printHeader("Memory usage"); std::cout << inGigabytes(memoryUsage()) << " GB" << std::endl;
+  std::cout << std::endl;
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+size_type
+verifyMapper(const DeBruijnGraph& mapper, const BaselineMapper& baseline)
+{
+  size_type mismatches = 0;
+  for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
+  {
+    bool fast = (comp > 0 && comp <= mapper.alpha.fast_chars);
+    DeBruijnGraph::fast_bit_vector::select_1_type fast_select;
+    DeBruijnGraph::sparse_bit_vector::select_1_type sparse_select;
+    if(fast) { sdsl::util::init_support(fast_select, &(mapper.fast_bwt[comp])); }
+    else { sdsl::util::init_support(sparse_select, &(mapper.sparse_bwt[comp])); }
+
+    for(size_type node = 0, ones = 0; node <= mapper.size(); node++)
+    {
+      size_type rank = (fast ? mapper.fast_rank[comp](node) : mapper.sparse_rank[comp](node));
+      if(rank != baseline.rank(node, comp) || rank != ones) { mismatches++; }
+      if(mapper.LF(node, comp) != baseline.LF(node, comp)) { mismatches++; }
+      if(node >= mapper.size()) { break; }
+      bool bit = (fast ? mapper.fast_bwt[comp][node] : mapper.sparse_bwt[comp][node]);
+      if(bit != baseline.hasPredecessor(node, comp)) { mismatches++; }
+      if(bit)
+      {
+        ones++;
+        size_type pos = (fast ? fast_select(ones) : sparse_select(ones));
+        if(pos != node || baseline.select(ones, comp) != node) { mismatches++; }
+      }
+    }
+  }
+  return mismatches;
+}
+
+template<class Mapper>
+size_type
+runQueries(const std::string& header, const Mapper& mapper, const std::vector<range_type>& queries)
+{
+  double start = readTimer();
+  size_type sum = 0;
+  for(size_type i = 0; i < queries.size(); i++) { sum += mapper.LF(queries[i].first, queries[i].second); }
+  double seconds = readTimer() - start;
+  printTime(header, queries.size(), seconds);
+  return sum;
+}
+
+void
+printSize(const std::string& header, size_type bytes, size_type nodes)
+{
+  printHeader(header);
+  std::cout << inMegabytes(bytes) << " MB (" << (bytes * 8.0 / nodes) << " bits/node)" << std::endl;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,169 @@
+/*
+  Copyright (c) 2016 Genome Research Ltd.
+
+  Author: Jouni Siren <jouni.siren@iki.fi>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include <gcsa/gcsa.h>
+#include <gcsa/lcp.h>
+
+using namespace gcsa;
+
+/*
+  Builds the same index with an increasing number of threads, starting from a single thread
+  and doubling the number until the maximum. The path nodes of the final graph are split into
+  one range per thread, with at least 64Ki path nodes in each range. The ranges also build
+  the counting support and the LCP array, so the speedup covers the entire final phase.
+  The index and the LCP array should not depend on the number of threads.
+*/
+
+//------------------------------------------------------------------------------
+
+struct BuildResult
+{
+  size_type threads;
+  double    seconds;
+  size_type paths, order;
+  std::string index, lcp;  // Serialized structures.
+};
+
+BuildResult buildIndex(InputGraph& graph, const ConstructionParameters& parameters, size_type threads);
+void printResult(const BuildResult& result, const BuildResult& baseline);
+
+//------------------------------------------------------------------------------
+
+int
+main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    std::cerr << "usage: thread_benchmark [options] base_name" << std::endl;
+    std::cerr << "  -d N  Doubling steps (default " << ConstructionParameters::DOUBLING_STEPS << ")" << std::endl;
+    std::cerr << "  -m N  Limit the memory usage of construction to N gigabytes (default " << ConstructionParameters::MEMORY_LIMIT << ")" << std::endl;
+    std::cerr << "  -t    Read the input in text format" << std::endl;
+    std::cerr << "  -T N  Use at most N threads (default " << omp_get_max_threads() << ")" << std::endl;
+    std::cerr << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+
+  int c = 0;
+  bool binary = true;
+  size_type max_threads = omp_get_max_threads();
+  ConstructionParameters parameters;
+  while((c = getopt(argc, argv, "d:m:tT:")) != -1)
+  {
+    switch(c)
+    {
+    case 'd':
+      parameters.setSteps(std::stoul(optarg)); break;
+    case 'm':
+      parameters.setMemoryLimit(std::stoul(optarg)); break;
+    case 't':
+      binary = false; break;
+    case 'T':
+      max_threads = std::max(std::stoul(optarg), 1UL); break;
+    case '?':
+      std::exit(EXIT_FAILURE);
+    default:
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if(optind >= argc)
+  {
+    std::cerr << "thread_benchmark: Base name required" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string base_name = argv[optind];
+
+  std::cout << "GCSA thread benchmark" << std::endl;
+  std::cout << std::endl;
+  printHeader("Base name"); std::cout << base_name << std::endl;
+  printHeader("Input format"); std::cout << (binary ? "binary" : "text") << std::endl;
+  printHeader("Doubling steps"); std::cout << parameters.doubling_steps << std::endl;
+  printHeader("Memory limit"); std::cout << inGigabytes(parameters.memory_limit) << " GB" << std::endl;
+  printHeader("Threads"); std::cout << max_threads << std::endl;
+  std::cout << std::endl;
+
+  size_type old_level = Verbosity::level; Verbosity::set(Verbosity::SILENT);
+  std::vector<std::string> files(1, base_name + (binary ? InputGraph::BINARY_EXTENSION : InputGraph::TEXT_EXTENSION));
+  InputGraph graph(files, binary);
+  Verbosity::set(old_level);
+
+  BuildResult baseline = buildIndex(graph, parameters, 1);
+  printResult(baseline, baseline);
+  for(size_type threads = 2; threads < 2 * max_threads; threads *= 2)
+  {
+    BuildResult result = buildIndex(graph, parameters, std::min(threads, max_threads));
+    printResult(result, baseline);
+  }
+
+  printHeader("Memory usage"); std::cout << inGigabytes(memoryUsage()) << " GB" << std::endl;
+  std::cout << std::endl;
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+BuildResult
+buildIndex(InputGraph& graph, const ConstructionParameters& parameters, size_type threads)
+{
+  BuildResult result;
+  result.threads = threads;
+  size_type old_threads = omp_get_max_threads(); omp_set_num_threads(threads);
+  size_type old_level = Verbosity::level; Verbosity::set(Verbosity::SILENT);
+
+  double start = readTimer();
+  LCPArray lcp;
+  GCSA index(graph, parameters, &lcp);
+  result.seconds = readTimer() - start;
+
+  result.paths = index.size(); result.order = index.order();
+  std::ostringstream index_out, lcp_out;
+  index.serialize(index_out); lcp.serialize(lcp_out);
+  result.index = index_out.str(); result.lcp = lcp_out.str();
+  Verbosity::set(old_level);
+  omp_set_num_threads(old_threads);
+
+  return result;
+}
+
+void
+printResult(const BuildResult& result, const BuildResult& baseline)
+{
+  std::string header = std::to_string(result.threads) + (result.threads == 1 ? " thread" : " threads");
+  printHeader(header);
+  std::cout << result.paths << " paths of order " << result.order << " in " << result.seconds << " seconds" << std::endl;
+  if(result.threads > 1)
+  {
+    printHeader(header);
+    std::cout << "Speedup " << (baseline.seconds / result.seconds) << "x, "
+              << (result.index == baseline.index && result.lcp == baseline.lcp ? "same" : "different")
+              << " index" << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+//------------------------------------------------------------------------------
@@ -27,6 +27,7 @@
 #include <unistd.h>
 
 #include <gcsa/algorithms.h>
+#include <gcsa/internal.h>
 
 using namespace gcsa;
 
@@ -64,10 +65,15 @@ main(int argc, char** argv)
     std::cerr << "Usage: build_gcsa [options] base_name [base_name2 ..]" << std::endl;
     std::cerr << "  -b    Read the input in binary format (default)" << std::endl;
     std::cerr << "  -B N  Set LCP branching factor to N (default " << ConstructionParameters::LCP_BRANCHING << ")" << std::endl;
-    std::cerr << "  -d N  Doubling steps (default and max " << ConstructionParameters::DOUBLING_STEPS << ")" << std::endl;
+    std::cerr << "  -c X  Write checkpoints to X and resume from X if it exists" << std::endl;
+    std::cerr << "  -d N  Doubling steps (default " << ConstructionParameters::DOUBLING_STEPS << ", max " << ConstructionParameters::MAX_STEPS << ")" << std::endl;
     std::cerr << "  -D X  Use X as the directory for temporary files (default: " << TempFile::DEFAULT_TEMP_DIR << ")" << std::endl;
+    std::cerr << "        X can be a comma-separated list of directories on different devices" << std::endl;
+    std::cerr << "  -i    Bypass the page cache when accessing temporary files" << std::endl;
     std::cerr << "  -l N  Limit the size of the graph to N gigabytes (default " << ConstructionParameters::SIZE_LIMIT << ")" << std::endl;
+    std::cerr << "  -m N  Limit the memory usage of construction to N gigabytes (default " << ConstructionParameters::MEMORY_LIMIT << ")" << std::endl;
     std::cerr << "  -o X  Use X as the base name for output (default: the first input)" << std::endl;
+    std::cerr << "  -p    Write a construction profile to the base name + " << ConstructionProfile::EXTENSION << std::endl;
     std::cerr << "  -t    Read the input in text format" << std::endl;
     std::cerr << "  -T N  Set the number of threads to N (default and max " << omp_get_max_threads() << " on this system)" << std::endl;
     std::cerr << "  -v    Verify the index by querying it with the kmers" << std::endl;
@@ -77,10 +83,10 @@ main(int argc, char** argv)
   }
 
   int c = 0;
-  bool binary = true, verify = false;
-  std::string index_file, lcp_file;
+  bool binary = true, verify = false, profile = false;
+  std::string index_file, lcp_file, profile_file;
   ConstructionParameters parameters;
-  while((c = getopt(argc, argv, "bB:d:D:l:o:tT:vV:")) != -1)
+  while((c = getopt(argc, argv, "bB:c:d:D:il:m:o:ptT:vV:")) != -1)
   {
     switch(c)
     {
@@ -88,16 +94,25 @@ main(int argc, char** argv)
       binary = true; break;
     case 'B':
       parameters.setLCPBranching(std::stoul(optarg)); break;
+    case 'c':
+      parameters.setCheckpoint(optarg); break;
     case 'd':
       parameters.setSteps(std::stoul(optarg)); break;
     case 'D':
       TempFile::setDirectory(optarg); break;
+    case 'i':
+      DiskIO::direct = true; break;
     case 'l':
       parameters.setLimit(std::stoul(optarg)); break;
+    case 'm':
+      parameters.setMemoryLimit(std::stoul(optarg)); break;
     case 'o':
       index_file = std::string(optarg) + GCSA::EXTENSION;
       lcp_file = std::string(optarg) + LCPArray::EXTENSION;
+      profile_file = std::string(optarg) + ConstructionProfile::EXTENSION;
       break;
+    case 'p':
+      profile = true; break;
     case 't':
       binary = false; break;
     case 'T':
@@ -121,7 +136,9 @@ main(int argc, char** argv)
   {
     index_file = std::string(argv[optind]) + GCSA::EXTENSION;
     lcp_file = std::string(argv[optind]) + LCPArray::EXTENSION;
+    profile_file = std::string(argv[optind]) + ConstructionProfile::EXTENSION;
   }
+  if(profile) { parameters.setProfile(profile_file); }
 
   std::cout << "GCSA builder" << std::endl;
   std::cout << std::endl;
@@ -132,12 +149,21 @@ main(int argc, char** argv)
     if(binary) { std::cout << InputGraph::BINARY_EXTENSION << " (binary format)" << std::endl; }
     else { std::cout << InputGraph::TEXT_EXTENSION << " (text format)" << std::endl; }
   }
-  printHeader("Output", INDENT); std::cout << index_file << ", " << lcp_file << std::endl;
+  printHeader("Output", INDENT); std::cout << index_file << ", " << lcp_file;
+  if(profile) { std::cout << ", " << profile_file; }
+  std::cout << std::endl;
   printHeader("Doubling steps", INDENT); std::cout << parameters.doubling_steps << std::endl;
   printHeader("Size limit", INDENT); std::cout << inGigabytes(parameters.size_limit) << " GB" << std::endl;
+  printHeader("Memory limit", INDENT); std::cout << inGigabytes(parameters.memory_limit) << " GB" << std::endl;
   printHeader("Branching factor", INDENT); std::cout << parameters.lcp_branching << std::endl;
   printHeader("Threads", INDENT); std::cout << omp_get_max_threads() << std::endl;
-  printHeader("Temp directory", INDENT); std::cout << TempFile::temp_dir << std::endl;
+  printHeader("Temp directory", INDENT); std::cout << TempFile::directoryNames() << std::endl;
+  printHeader("I/O backend", INDENT);
+  std::cout << DiskIO::backendName() << (DiskIO::direct ? " (direct)" : "") << std::endl;
+  if(!(parameters.checkpoint_file.empty()))
+  {
+    printHeader("Checkpoint", INDENT); std::cout << parameters.checkpoint_file << std::endl;
+  }
   printHeader("Verbosity", INDENT); std::cout << Verbosity::levelName() << std::endl;
   std::cout << std::endl;
 
@@ -158,13 +184,14 @@ main(int argc, char** argv)
 #else
   {
     double start = readTimer();
-    index = GCSA(graph, parameters);
-    lcp = LCPArray(graph, parameters);
+    index = GCSA(graph, parameters, &lcp);
     double seconds = readTimer() - start;
     std::cout << "Index built in " << seconds << " seconds" << std::endl;
     std::cout << "Memory usage: " << inGigabytes(memoryUsage()) << " GB" << std::endl;
     std::cout << "I/O volume: " << inGigabytes(readVolume()) << " GB read, "
               << inGigabytes(writeVolume()) << " GB write" << std::endl;
+    std::cout << "Logical I/O volume: " << inGigabytes(logicalReadVolume()) << " GB read, "
+              << inGigabytes(logicalWriteVolume()) << " GB write" << std::endl;
     std::cout << std::endl;
     sdsl::store_to_file(index, index_file);
     sdsl::store_to_file(lcp, lcp_file);
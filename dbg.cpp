@@ -59,8 +59,10 @@ DeBruijnGraph::copy(const DeBruijnGraph& g)
 
   this->alpha = g.alpha;
 
-  this->bwt = g.bwt;
-  this->bwt_rank = g.bwt_rank;
+  this->fast_bwt = g.fast_bwt;
+  this->fast_rank = g.fast_rank;
+  this->sparse_bwt = g.sparse_bwt;
+  this->sparse_rank = g.sparse_rank;
 
   this->nodes = g.nodes;
   this->node_rank = g.node_rank;
@@ -78,11 +80,15 @@ DeBruijnGraph::swap(DeBruijnGraph& g)
 
     this->alpha.swap(g.alpha);
 
-    this->bwt.swap(g.bwt);
-    sdsl::util::swap_support(this->bwt_rank, g.bwt_rank, &(this->bwt), &(g.bwt));
+    this->fast_bwt.swap(g.fast_bwt);
+    this->fast_rank.swap(g.fast_rank);
+    this->sparse_bwt.swap(g.sparse_bwt);
+    this->sparse_rank.swap(g.sparse_rank);
 
     this->nodes.swap(g.nodes);
     sdsl::util::swap_support(this->node_rank, g.node_rank, &(this->nodes), &(g.nodes));
+
+    this->setVectors();
   }
 }
 
@@ -103,8 +109,10 @@ DeBruijnGraph::operator=(DeBruijnGraph&& g)
 
     this->alpha = std::move(g.alpha);
 
-    this->bwt = std::move(g.bwt);
-    this->bwt_rank = std::move(g.bwt_rank);
+    this->fast_bwt = std::move(g.fast_bwt);
+    this->fast_rank = std::move(g.fast_rank);
+    this->sparse_bwt = std::move(g.sparse_bwt);
+    this->sparse_rank = std::move(g.sparse_rank);
 
     this->nodes = std::move(g.nodes);
     this->node_rank = std::move(g.node_rank);
@@ -117,7 +125,11 @@ DeBruijnGraph::operator=(DeBruijnGraph&& g)
 void
 DeBruijnGraph::setVectors()
 {
-  this->bwt_rank.set_vector(&(this->bwt));
+  for(size_type comp = 0; comp < this->fast_bwt.size(); comp++)
+  {
+    this->fast_rank[comp].set_vector(&(this->fast_bwt[comp]));
+    this->sparse_rank[comp].set_vector(&(this->sparse_bwt[comp]));
+  }
   this->node_rank.set_vector(&(this->nodes));
 }
 
@@ -132,8 +144,23 @@ DeBruijnGraph::serialize(std::ostream& out, sdsl::structure_tree_node* v, std::s
 
   written_bytes += this->alpha.serialize(out, child, "alpha");
 
-  written_bytes += this->bwt.serialize(out, child, "bwt");
-  written_bytes += this->bwt_rank.serialize(out, child, "bwt_rank");
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    written_bytes += this->fast_bwt[comp].serialize(out, child, "fast_bwt");
+  }
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    written_bytes += this->fast_rank[comp].serialize(out, child, "fast_rank");
+  }
+
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    written_bytes += this->sparse_bwt[comp].serialize(out, child, "sparse_bwt");
+  }
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    written_bytes += this->sparse_rank[comp].serialize(out, child, "sparse_rank");
+  }
 
   written_bytes += this->nodes.serialize(out, child, "nodes");
   written_bytes += this->node_rank.serialize(out, child, "node_rank");
@@ -150,8 +177,13 @@ DeBruijnGraph::load(std::istream& in)
 
   this->alpha.load(in);
 
-  this->bwt.load(in);
-  this->bwt_rank.load(in, &(this->bwt));
+  this->fast_bwt.resize(this->alpha.sigma); this->fast_rank.resize(this->alpha.sigma);
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++) { this->fast_bwt[comp].load(in); }
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++) { this->fast_rank[comp].load(in, &(this->fast_bwt[comp])); }
+
+  this->sparse_bwt.resize(this->alpha.sigma); this->sparse_rank.resize(this->alpha.sigma);
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++) { this->sparse_bwt[comp].load(in); }
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++) { this->sparse_rank[comp].load(in, &(this->sparse_bwt[comp])); }
 
   this->nodes.load(in);
   this->node_rank.load(in, &(this->nodes));
@@ -164,28 +196,52 @@ DeBruijnGraph::DeBruijnGraph(const std::vector<key_type>& keys, size_type kmer_l
   this->node_count = keys.size();
   this->graph_order = kmer_length;
 
+  sdsl::int_vector<64> counts(alphabet.sigma, 0);
   size_type total_edges = 0;
-  for(size_type i = 0; i < keys.size(); i++) { total_edges += sdsl::bits::lt_cnt[Key::predecessors(keys[i])]; }
+  for(size_type i = 0; i < keys.size(); i++)
+  {
+    size_type pred = Key::predecessors(keys[i]);
+    for(size_type comp = 0; comp < alphabet.sigma; comp++)
+    {
+      if(pred & (((size_type)1) << comp)) { counts[comp]++; }
+    }
+    total_edges += sdsl::bits::lt_cnt[pred];
+  }
+  this->alpha = Alphabet(counts, alphabet.char2comp, alphabet.comp2char);
 
-  sdsl::int_vector<64> counts(alphabet.sigma, 0);
-  bit_vector bwt_buffer(alphabet.sigma * total_edges, 0);
+  // Fast comp values are encoded directly, while the others use a separate pass.
+  this->fast_bwt.resize(this->alpha.sigma); this->fast_rank.resize(this->alpha.sigma);
+  this->sparse_bwt.resize(this->alpha.sigma); this->sparse_rank.resize(this->alpha.sigma);
+  std::vector<bit_vector> bwt_buffer(this->alpha.sigma);
+  for(size_type comp = 1; comp <= this->alpha.fast_chars && comp < this->alpha.sigma; comp++)
+  {
+    bwt_buffer[comp] = bit_vector(this->size(), 0);
+  }
   bit_vector node_buffer(total_edges, 0);
   for(size_type i = 0, edge_pos = 0; i < keys.size(); i++)
   {
     size_type pred = Key::predecessors(keys[i]);
-    for(size_type j = 0; j < alphabet.sigma; j++)
+    for(size_type comp = 1; comp <= this->alpha.fast_chars && comp < this->alpha.sigma; comp++)
     {
-      if(pred & (((size_type)1) << j))
-      {
-        bwt_buffer[j * this->size() + i] = 1;
-        counts[j]++;
-      }
+      if(pred & (((size_type)1) << comp)) { bwt_buffer[comp][i] = 1; }
     }
     edge_pos += sdsl::bits::lt_cnt[Key::successors(keys[i])];
     node_buffer[edge_pos - 1] = 1;
   }
-  this->alpha = Alphabet(counts, alphabet.char2comp, alphabet.comp2char);
-  this->bwt = bwt_buffer; sdsl::util::clear(bwt_buffer);
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    if(comp > 0 && comp <= this->alpha.fast_chars)
+    {
+      this->fast_bwt[comp] = bwt_buffer[comp]; sdsl::util::clear(bwt_buffer[comp]);
+      continue;
+    }
+    sdsl::sd_vector_builder builder(this->size(), counts[comp]);
+    for(size_type i = 0; i < keys.size(); i++)
+    {
+      if(Key::predecessors(keys[i]) & (((size_type)1) << comp)) { builder.set(i); }
+    }
+    this->sparse_bwt[comp] = sparse_bit_vector(builder);
+  }
   this->nodes = node_buffer; sdsl::util::clear(node_buffer);
 
   this->initSupport();
@@ -196,7 +252,11 @@ DeBruijnGraph::DeBruijnGraph(const std::vector<key_type>& keys, size_type kmer_l
 void
 DeBruijnGraph::initSupport()
 {
-  sdsl::util::init_support(this->bwt_rank, &(this->bwt));
+  for(size_type comp = 0; comp < this->alpha.sigma; comp++)
+  {
+    sdsl::util::init_support(this->fast_rank[comp], &(this->fast_bwt[comp]));
+    sdsl::util::init_support(this->sparse_rank[comp], &(this->sparse_bwt[comp]));
+  }
   sdsl::util::init_support(this->node_rank, &(this->nodes));
 }
 
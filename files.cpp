@@ -22,6 +22,13 @@
   SOFTWARE.
 */
 
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <gcsa/files.h>
 #include <gcsa/internal.h>
 
@@ -101,6 +108,318 @@ readText(std::istream& in, std::vector<KMer>& kmers, const Alphabet& alpha, bool
 
 //------------------------------------------------------------------------------
 
+MappedFile::MappedFile() :
+  data(0), bytes(0)
+{
+}
+
+MappedFile::MappedFile(const std::string& filename) :
+  data(0), bytes(0)
+{
+  this->open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+  this->close();
+}
+
+void
+MappedFile::open(const std::string& filename)
+{
+  this->close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd < 0 || ::fstat(fd, &st) != 0)
+  {
+    std::cerr << "MappedFile::open(): Cannot open file " << filename << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  this->bytes = st.st_size;
+  if(this->bytes > 0)
+  {
+    void* temp = ::mmap(0, this->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(temp == MAP_FAILED)
+    {
+      std::cerr << "MappedFile::open(): Cannot map file " << filename << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    this->data = static_cast<const char*>(temp);
+  }
+  ::close(fd);
+}
+
+void
+MappedFile::close()
+{
+  if(this->data != 0)
+  {
+    ::munmap(const_cast<char*>(this->data), this->bytes);
+  }
+  this->data = 0; this->bytes = 0;
+}
+
+void
+MappedFile::sequential() const
+{
+  if(this->data != 0) { ::madvise(const_cast<char*>(this->data), this->bytes, MADV_SEQUENTIAL); }
+}
+
+void
+MappedFile::release() const
+{
+  if(this->data != 0) { ::madvise(const_cast<char*>(this->data), this->bytes, MADV_DONTNEED); }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  A memory-mapped text graph file split into chunks at line boundaries. Each chunk can
+  be scanned by a separate thread without allocating memory for lines or tokens. The
+  fields of a line are split in the same way as in tokenize(), but a line without a
+  line end at the end of the file is also parsed.
+*/
+
+struct TextGraphFile
+{
+  MappedFile             mapping;
+  const char*            data;
+  size_type              bytes;
+  std::vector<size_type> bounds;  // Chunk i is [bounds[i], bounds[i + 1]).
+
+  const static size_type FIELDS = 5;
+  const static size_type MIN_CHUNK_SIZE = MEGABYTE;
+
+  explicit TextGraphFile(const std::string& filename);
+
+  inline size_type chunks() const { return this->bounds.size() - 1; }
+
+  // Returns the end of the line starting at pos.
+  inline const char* lineEnd(const char* pos, const char* limit) const
+  {
+    const char* found = static_cast<const char*>(std::memchr(pos, '\n', limit - pos));
+    return (found == 0 ? limit : found);
+  }
+
+  /*
+    Splits line [begin, end) into tab-separated fields. Returns false if the line does
+    not contain exactly FIELDS fields.
+  */
+  static bool fields(const char* begin, const char* end, const char** field_begin, const char** field_end);
+
+  // Calls fields() and prints an error message if the line is invalid.
+  static bool validFields(const char* begin, const char* end, const char** field_begin, const char** field_end);
+
+  // Returns the number of comma-separated tokens in [begin, end).
+  static size_type tokens(const char* begin, const char* end);
+
+  /*
+    Counts the kmers in the chunk. Sets kmer_length to the length of the first kmer and
+    bad_length to the first length differing from it.
+  */
+  size_type count(size_type chunk, size_type& kmer_length, size_type& bad_length) const;
+
+  // Parses the chunk into the array, which must have space for all kmers in it.
+  void parse(size_type chunk, const Alphabet& alpha, KMer* kmers) const;
+
+  TextGraphFile(const TextGraphFile&) = delete;
+  TextGraphFile& operator= (const TextGraphFile&) = delete;
+};
+
+TextGraphFile::TextGraphFile(const std::string& filename) :
+  mapping(filename)
+{
+  this->data = this->mapping.data; this->bytes = this->mapping.bytes;
+  this->mapping.sequential();
+
+  // Split the file into chunks at line boundaries.
+  size_type min_chunk = MIN_CHUNK_SIZE;  // avoid direct use of static const
+  size_type threads = omp_get_max_threads();
+  size_type chunk_size = std::max(min_chunk, this->bytes / (4 * threads) + 1);
+  this->bounds.push_back(0);
+  while(this->bounds.back() < this->bytes)
+  {
+    size_type start = this->bounds.back();
+    if(this->bytes - start <= chunk_size) { this->bounds.push_back(this->bytes); break; }
+    const char* end = this->lineEnd(this->data + start + chunk_size, this->data + this->bytes);
+    this->bounds.push_back(std::min(static_cast<size_type>(end + 1 - this->data), this->bytes));
+  }
+  if(this->bounds.size() == 1) { this->bounds.push_back(0); }
+}
+
+bool
+TextGraphFile::fields(const char* begin, const char* end, const char** field_begin, const char** field_end)
+{
+  size_type found = 0;
+  const char* pos = begin;
+  while(pos < end)
+  {
+    if(found >= FIELDS) { return false; }
+    const char* next = static_cast<const char*>(std::memchr(pos, '\t', end - pos));
+    if(next == 0) { next = end; }
+    field_begin[found] = pos; field_end[found] = next; found++;
+    pos = next + 1;
+  }
+  return (found == FIELDS);
+}
+
+bool
+TextGraphFile::validFields(const char* begin, const char* end, const char** field_begin, const char** field_end)
+{
+  if(fields(begin, end, field_begin, field_end)) { return true; }
+  #pragma omp critical (stderr)
+  {
+    std::cerr << "TextGraphFile::parse(): The kmer line must contain 5 tokens" << std::endl;
+    std::cerr << "TextGraphFile::parse(): The line was: " << std::string(begin, end) << std::endl;
+  }
+  return false;
+}
+
+size_type
+TextGraphFile::tokens(const char* begin, const char* end)
+{
+  size_type result = 0;
+  const char* pos = begin;
+  while(pos < end)
+  {
+    const char* next = static_cast<const char*>(std::memchr(pos, ',', end - pos));
+    result++;
+    if(next == 0) { break; }
+    pos = next + 1;
+  }
+  return result;
+}
+
+size_type
+TextGraphFile::count(size_type chunk, size_type& kmer_length, size_type& bad_length) const
+{
+  const char* field_begin[FIELDS];
+  const char* field_end[FIELDS];
+  const char* pos = this->data + this->bounds[chunk];
+  const char* limit = this->data + this->bounds[chunk + 1];
+  size_type unknown = InputGraph::UNKNOWN;  // avoid direct use of static const
+  kmer_length = unknown; bad_length = unknown;
+
+  size_type result = 0;
+  while(pos < limit)
+  {
+    const char* end = this->lineEnd(pos, limit);
+    if(fields(pos, end, field_begin, field_end))
+    {
+      size_type length = field_end[0] - field_begin[0];
+      if(kmer_length == unknown) { kmer_length = length; }
+      else if(length != kmer_length && bad_length == unknown) { bad_length = length; }
+      result += tokens(field_begin[4], field_end[4]);
+    }
+    pos = end + 1;
+  }
+
+  return result;
+}
+
+void
+TextGraphFile::parse(size_type chunk, const Alphabet& alpha, KMer* kmers) const
+{
+  const char* field_begin[FIELDS];
+  const char* field_end[FIELDS];
+  const char* pos = this->data + this->bounds[chunk];
+  const char* limit = this->data + this->bounds[chunk + 1];
+
+  while(pos < limit)
+  {
+    const char* end = this->lineEnd(pos, limit);
+    if(validFields(pos, end, field_begin, field_end))
+    {
+      byte_type predecessors = KMer::chars(field_begin[2], field_end[2], alpha);
+      byte_type successors = KMer::chars(field_begin[3], field_end[3], alpha);
+      key_type key = Key::encode(alpha, field_begin[0], field_end[0] - field_begin[0], predecessors, successors);
+      node_type from = Node::encode(field_begin[1], field_end[1]);
+      const char* to = field_begin[4];
+      while(to < field_end[4])
+      {
+        const char* next = static_cast<const char*>(std::memchr(to, ',', field_end[4] - to));
+        if(next == 0) { next = field_end[4]; }
+        *kmers = KMer(key, from, Node::encode(to, next)); kmers++;
+        to = next + 1;
+      }
+    }
+    pos = end + 1;
+  }
+}
+
+/*
+  Counts the kmers in each chunk and checks that the kmer lengths are consistent. Stores
+  the starting offset of each chunk in offsets. Returns (kmer length, kmer count).
+*/
+range_type
+countText(const TextGraphFile& file, const std::string& filename, std::vector<size_type>& offsets)
+{
+  std::vector<size_type> lengths(file.chunks()), bad_lengths(file.chunks());
+  offsets = std::vector<size_type>(file.chunks() + 1, 0);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type chunk = 0; chunk < file.chunks(); chunk++)
+  {
+    offsets[chunk + 1] = file.count(chunk, lengths[chunk], bad_lengths[chunk]);
+  }
+
+  size_type unknown = InputGraph::UNKNOWN;  // avoid direct use of static const
+  size_type kmer_length = unknown;
+  for(size_type chunk = 0; chunk < file.chunks(); chunk++)
+  {
+    offsets[chunk + 1] += offsets[chunk];
+    if(lengths[chunk] == unknown) { continue; }
+    if(kmer_length == unknown)
+    {
+      kmer_length = lengths[chunk];
+      if(kmer_length == 0 || kmer_length > Key::MAX_LENGTH)
+      {
+        std::cerr << "readText(): Invalid kmer length in " << filename << ": " << kmer_length << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    size_type bad_length = (lengths[chunk] != kmer_length ? lengths[chunk] : bad_lengths[chunk]);
+    if(bad_length != unknown)
+    {
+      std::cerr << "readText(): Invalid kmer length in " << filename << ": " << bad_length
+                << " (expected " << kmer_length << ")" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  return range_type(kmer_length, offsets.back());
+}
+
+size_type
+readText(const std::string& filename, std::vector<KMer>& kmers, const Alphabet& alpha, bool append)
+{
+  if(!append) { sdsl::util::clear(kmers); }
+
+  TextGraphFile file(filename);
+  std::vector<size_type> offsets;
+  range_type result = countText(file, filename, offsets);
+
+  size_type old_size = kmers.size();
+  kmers.resize(old_size + result.second);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type chunk = 0; chunk < file.chunks(); chunk++)
+  {
+    file.parse(chunk, alpha, kmers.data() + old_size + offsets[chunk]);
+  }
+
+  return result.first;
+}
+
+range_type
+countText(const std::string& filename)
+{
+  TextGraphFile file(filename);
+  std::vector<size_type> offsets;
+  return countText(file, filename, offsets);
+}
+
+//------------------------------------------------------------------------------
+
 size_type
 readBinary(std::istream& in, std::vector<KMer>& kmers, bool append)
 {
@@ -112,7 +431,7 @@ readBinary(std::istream& in, std::vector<KMer>& kmers, bool append)
   {
     GraphFileHeader header(in);
     if(in.eof()) { break; }
-    if(header.flags != 0)
+    if(header.flags != GraphFileHeader::DEFAULT_FLAGS)
     {
       std::cerr << "readBinary(): Invalid flags in section " << section << ": " << header.flags << std::endl;
       std::exit(EXIT_FAILURE);
@@ -181,7 +500,7 @@ GraphFileHeader::GraphFileHeader() :
 }
 
 GraphFileHeader::GraphFileHeader(size_type kmers, size_type length) :
-  flags(0), kmer_count(kmers), kmer_length(length)
+  flags(DEFAULT_FLAGS), kmer_count(kmers), kmer_length(length)
 {
 }
 
@@ -203,33 +522,6 @@ GraphFileHeader::serialize(std::ostream& out)
 
 //------------------------------------------------------------------------------
 
-range_type
-parseKMer(const std::string& kmer_line)
-{
-  std::string extensions;
-  size_type unknown = InputGraph::UNKNOWN;  // avoid direct use of static const
-  range_type result(unknown, 0);
-  {
-    std::string token;
-    std::istringstream ss(kmer_line);
-    if(!std::getline(ss, token, '\t')) { return result; }
-    result.first = token.length();  // kmer length
-    for(size_type i = 0; i < 3; i++)
-    {
-      if(!std::getline(ss, token, '\t')) { return result; }
-    }
-    if(!std::getline(ss, extensions, '\t')) { return result; }
-  }
-
-  {
-    std::string token;
-    std::istringstream ss(extensions);
-    while(std::getline(ss, token, ',')) { result.second++; }
-  }
-
-  return result;
-}
-
 /*
   If the kmer ends with an endmarker, it cannot be extended, and we mark it
   sorted. If its label is not unique, it will be treated as a nondeterministic
@@ -272,6 +564,10 @@ InputGraph::InputGraph(size_type file_count, char** base_names, bool binary_form
 InputGraph::~InputGraph()
 {
   TempFile::remove(this->lcp_name);
+  for(size_type file = 0; file < this->mapped.size(); file++)
+  {
+    delete this->mapped[file]; this->mapped[file] = 0;
+  }
 }
 
 void
@@ -279,37 +575,57 @@ InputGraph::build()
 {
   this->kmer_count = 0; this->kmer_length = UNKNOWN;
   this->sizes = std::vector<size_type>(this->files(), 0);
+  if(this->binary)
+  {
+    this->mapped = std::vector<MappedFile*>(this->files(), 0);
+    this->sections = std::vector<std::vector<KMerSpan>>(this->files());
+  }
 
   // Read the files and determine kmer_count, kmer_length.
   for(size_type file = 0; file < this->files(); file++)
   {
-    std::ifstream input; this->open(input, file);
     if(this->binary)
     {
-      while(true)
+      // Index the sections of the memory-mapped file.
+      this->mapped[file] = new MappedFile(this->filenames[file]);
+      const MappedFile& mapping = *(this->mapped[file]);
+      size_type offset = 0;
+      while(offset + sizeof(GraphFileHeader) <= mapping.bytes)
       {
-        GraphFileHeader header(input);
-        if(input.eof()) { break; }
+        GraphFileHeader header;
+        std::memcpy(static_cast<void*>(&header), mapping.data + offset, sizeof(header));
+        offset += sizeof(header);
+        if(header.flags != GraphFileHeader::DEFAULT_FLAGS)
+        {
+          std::cerr << "InputGraph::build(): Invalid flags in graph file " << this->filenames[file]
+                    << ": " << header.flags << std::endl;
+          std::exit(EXIT_FAILURE);
+        }
+        if(header.kmer_length == 0 || header.kmer_length > Key::MAX_LENGTH)
+        {
+          std::cerr << "InputGraph::build(): Invalid kmer length in graph file " << this->filenames[file]
+                    << ": " << header.kmer_length << std::endl;
+          std::exit(EXIT_FAILURE);
+        }
+        if(header.kmer_count > (mapping.bytes - offset) / sizeof(KMer))
+        {
+          std::cerr << "InputGraph::build(): Truncated graph file " << this->filenames[file] << std::endl;
+          std::exit(EXIT_FAILURE);
+        }
+        KMerSpan span = { reinterpret_cast<const KMer*>(mapping.data + offset), header.kmer_count };
+        this->sections[file].push_back(span);
+        offset += header.kmer_count * sizeof(KMer);
         this->kmer_count += header.kmer_count;
         this->setK(header.kmer_length, file);
         this->sizes[file] += header.kmer_count;
-        input.seekg(header.kmer_count * sizeof(KMer), std::ios_base::cur);
       }
     }
     else
     {
-      while(true)
-      {
-        std::string line;
-        std::getline(input, line);
-        if(input.eof()) { break; }
-        range_type temp = parseKMer(line);
-        this->setK(temp.first, file);
-        this->kmer_count += temp.second; this->sizes[file] += temp.second;
-      }
-
+      range_type temp = countText(this->filenames[file]);
+      if(temp.first != UNKNOWN) { this->setK(temp.first, file); }
+      this->kmer_count += temp.second; this->sizes[file] += temp.second;
     }
-    input.close();
   }
 
   if(Verbosity::level >= Verbosity::BASIC)
@@ -380,11 +696,22 @@ InputGraph::read(std::vector<KMer>& kmers, size_type file, bool append) const
 {
   if(!append) { sdsl::util::clear(kmers); }
 
-  std::ifstream input; this->open(input, file);
   if(!append) { kmers.reserve(this->sizes[file]); }
-  size_type new_k = (this->binary ? readBinary(input, kmers, append) : readText(input, kmers, this->alpha, append));
-  this->checkK(new_k, file);
-  input.close();
+  if(this->binary)
+  {
+    for(size_type i = 0; i < this->sections[file].size(); i++)
+    {
+      const KMerSpan& span = this->sections[file][i];
+      kmers.insert(kmers.end(), span.begin(), span.end());
+      DiskIO::readMapped(span.size() * sizeof(KMer));
+    }
+    this->release(file);
+  }
+  else
+  {
+    size_type new_k = readText(this->filenames[file], kmers, this->alpha, append);
+    this->checkK(new_k, file);
+  }
 
   if(!append && Verbosity::level >= Verbosity::FULL)
   {
@@ -404,6 +731,17 @@ InputGraph::readKeys(std::vector<key_type>& keys) const
   // Read the keys.
   for(size_type file = 0; file < this->files(); file++)
   {
+    if(this->binary)
+    {
+      for(size_type i = 0; i < this->sections[file].size(); i++)
+      {
+        const KMerSpan& span = this->sections[file][i];
+        for(size_type j = 0; j < span.size(); j++) { keys.push_back(span[j].key); }
+        DiskIO::readMapped(span.size() * sizeof(KMer));
+      }
+      this->release(file);
+      continue;
+    }
     std::vector<KMer> kmers;
     this->read(kmers, file, false);
     for(size_type i = 0; i < this->sizes[file]; i++)
@@ -437,6 +775,17 @@ InputGraph::readFrom(std::vector<node_type>& from_nodes) const
   // Read the from nodes.
   for(size_type file = 0; file < this->files(); file++)
   {
+    if(this->binary)
+    {
+      for(size_type i = 0; i < this->sections[file].size(); i++)
+      {
+        const KMerSpan& span = this->sections[file][i];
+        for(size_type j = 0; j < span.size(); j++) { from_nodes.push_back(span[j].from); }
+        DiskIO::readMapped(span.size() * sizeof(KMer));
+      }
+      this->release(file);
+      continue;
+    }
     std::vector<KMer> kmers;
     this->read(kmers, file, false);
     for(size_type i = 0; i < this->sizes[file]; i++)
@@ -452,6 +801,12 @@ InputGraph::readFrom(std::vector<node_type>& from_nodes) const
   }
 }
 
+void
+InputGraph::release(size_type file) const
+{
+  if(this->binary && this->mapped[file] != 0) { this->mapped[file]->release(); }
+}
+
 //------------------------------------------------------------------------------
 
 GCSAHeader::GCSAHeader() :
@@ -22,6 +22,10 @@
   SOFTWARE.
 */
 
+#include <cstdio>
+
+#include <unistd.h>
+
 #include <gcsa/algorithms.h>
 #include <gcsa/internal.h>
 #include <gcsa/path_graph.h>
@@ -243,104 +247,182 @@ GCSA::setVectors()
 
 //------------------------------------------------------------------------------
 
+/*
+  A read-only array of elements in a file. Files on disk are memory-mapped, while SDSL ram
+  files are read into memory. The array can be shared between threads.
+*/
+template<class Element>
+struct MappedArray
+{
+  MappedFile           mapping;
+  std::vector<Element> buffer;
+  const Element*       data;
+  size_type            elements;
+
+  explicit MappedArray(const std::string& filename);
+
+  inline size_type size() const { return this->elements; }
+  inline const Element& operator[] (size_type i) const { return this->data[i]; }
+
+  MappedArray(const MappedArray&) = delete;
+  MappedArray& operator= (const MappedArray&) = delete;
+};
+
+template<class Element>
+MappedArray<Element>::MappedArray(const std::string& filename) :
+  data(0), elements(0)
+{
+  if(sdsl::is_ram_file(filename))
+  {
+    sdsl::isfstream in(filename, std::ios_base::in | std::ios_base::binary);
+    if(!in)
+    {
+      std::cerr << "MappedArray::MappedArray(): Cannot open file " << filename << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    this->buffer.resize(fileSize(in) / sizeof(Element));
+    DiskIO::read(in, this->buffer.data(), this->buffer.size());
+    in.close();
+    this->data = this->buffer.data(); this->elements = this->buffer.size();
+  }
+  else
+  {
+    this->mapping.open(filename);
+    this->data = reinterpret_cast<const Element*>(this->mapping.data);
+    this->elements = this->mapping.bytes / sizeof(Element);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  A shared read-only view of the MergedGraph files. All readers in all construction ranges
+  use the same view, so each file is read and cached only once.
+*/
+struct MergedGraphFiles
+{
+  MappedArray<PathNode>            paths;
+  MappedArray<PathNode::rank_type> labels;
+  MappedArray<range_type>          from_nodes;
+  MappedArray<uint8_t>             lcp;
+
+  explicit MergedGraphFiles(const MergedGraph& graph) :
+    paths(graph.path_name), labels(graph.rank_name), from_nodes(graph.from_name), lcp(graph.lcp_name)
+  {
+    if(this->paths.size() != graph.size() || this->labels.size() != graph.ranks() ||
+      this->from_nodes.size() != graph.extra() || this->lcp.size() != graph.size())
+    {
+      std::cerr << "MergedGraphFiles::MergedGraphFiles(): Invalid MergedGraph files" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  // The first path at or after 'low' with lastLabel >= first.
+  template<size_type LABEL_LENGTH>
+  size_type findPath(const PathLabel<LABEL_LENGTH>& first, size_type low) const;
+
+  // The first additional from node for path i or a later path.
+  size_type findFrom(size_type i) const
+  {
+    size_type low = 0, high = this->from_nodes.size();
+    while(low < high)
+    {
+      size_type mid = low + (high - low) / 2;
+      if(this->from_nodes[mid].first < i) { low = mid + 1; }
+      else { high = mid; }
+    }
+    return low;
+  }
+
+  MergedGraphFiles(const MergedGraphFiles&) = delete;
+  MergedGraphFiles& operator= (const MergedGraphFiles&) = delete;
+};
+
+//------------------------------------------------------------------------------
+
+/*
+  A cursor over the shared MergedGraph files.
+*/
 struct MergedGraphReader
 {
-  ReadBuffer<PathNode>            paths;
-  ReadBuffer<PathNode::rank_type> labels;
-  ReadBuffer<range_type>          from_nodes;
+  const MergedGraphFiles*    files;
+  size_type                  path, from;
 
-  size_type path, rank, from;
+  const DeBruijnGraph*       mapper;
+  const sdsl::int_vector<0>* last_char;
 
-  const DeBruijnGraph*            mapper;
-  const sdsl::int_vector<0>*      last_char;
+  MergedGraphReader();
 
-  void init(const MergedGraph& graph, const DeBruijnGraph* _mapper, const sdsl::int_vector<0>* _last_char);
-  void init(const MergedGraph& graph, size_type comp);
-  void close();
+  /*
+    Start reading at the given path and from node entry. The mapper and the last char array
+    are only needed for predecessor().
+  */
+  void init(const MergedGraphFiles& _files, size_type _path, size_type _from,
+    const DeBruijnGraph* _mapper = 0, const sdsl::int_vector<0>* _last_char = 0);
 
   void seek();
 
+  inline const PathNode& current() const { return this->files->paths[this->path]; }
+
   inline void advance()
   {
-    if(this->path + 1 >= this->paths.size()) { return; }
+    if(this->path + 1 >= this->files->paths.size()) { return; }
     this->path++;
     this->seek();
   }
 
-  void predecessor(comp_type comp, PathLabel& first, PathLabel& last);
+  template<size_type LABEL_LENGTH>
+  void predecessor(comp_type comp, PathLabel<LABEL_LENGTH>& first, PathLabel<LABEL_LENGTH>& last) const;
 
   /*
     Does paths[path + offset] intersect with the given range of labels?
   */
-  bool intersect(const PathLabel& first, const PathLabel& last, size_type offset);
+  template<size_type LABEL_LENGTH>
+  bool intersect(const PathLabel<LABEL_LENGTH>& first, const PathLabel<LABEL_LENGTH>& last, size_type offset) const;
 
-  void fromNodes(std::vector<node_type>& results);
+  void fromNodes(std::vector<node_type>& results) const;
 };
 
-void
-MergedGraphReader::init(const MergedGraph& graph,
-  const DeBruijnGraph* _mapper, const sdsl::int_vector<0>* _last_char)
+MergedGraphReader::MergedGraphReader() :
+  files(0), path(0), from(0), mapper(0), last_char(0)
 {
-  this->paths.open(graph.path_name);
-  this->labels.open(graph.rank_name);
-  this->from_nodes.open(graph.from_name);
-
-  this->path = this->rank = this->from = 0;
-  this->seek();
-
-  this->mapper = _mapper;
-  this->last_char = _last_char;
 }
 
 void
-MergedGraphReader::init(const MergedGraph& graph, size_type comp)
+MergedGraphReader::init(const MergedGraphFiles& _files, size_type _path, size_type _from,
+  const DeBruijnGraph* _mapper, const sdsl::int_vector<0>* _last_char)
 {
-  this->paths.open(graph.path_name);
-  this->labels.open(graph.rank_name);
-  this->from_nodes.open(graph.from_name);
-
-  this->path = graph.next[comp];
-  this->from = graph.next_from[comp];
+  this->files = &_files;
+  this->path = _path; this->from = _from;
   this->seek();
 
-  this->mapper = 0;
-  this->last_char = 0;
-}
-
-void
-MergedGraphReader::close()
-{
-  this->paths.close(),
-  this->labels.close();
-  this->from_nodes.close();
-
-  this->path = this->rank = this->from = 0;
+  this->mapper = _mapper;
+  this->last_char = _last_char;
 }
 
 void
 MergedGraphReader::seek()
 {
-  this->paths.seek(this->path);
-  this->rank = this->paths[this->path].pointer();
-  this->labels.seek(this->rank);
-  while(this->from < this->from_nodes.size() && this->from_nodes[this->from].first < this->path)
+  const MappedArray<range_type>& from_nodes = this->files->from_nodes;
+  while(this->from < from_nodes.size() && from_nodes[this->from].first < this->path)
   {
     this->from++;
   }
-  this->from_nodes.seek(this->from);
 }
 
+template<size_type LABEL_LENGTH>
 void
-MergedGraphReader::predecessor(comp_type comp, PathLabel& first, PathLabel& last)
+MergedGraphReader::predecessor(comp_type comp, PathLabel<LABEL_LENGTH>& first, PathLabel<LABEL_LENGTH>& last) const
 {
-  const PathNode& curr = this->paths[this->path];
+  const PathNode& curr = this->current();
+  const MappedArray<PathNode::rank_type>& labels = this->files->labels;
   size_type i = 0, j = curr.pointer();
   first.first = true; last.first = false;
 
   // Handle the common prefix of the labels.
   while(i < curr.lcp())
   {
-    first.label[i] = last.label[i] = this->mapper->LF(this->labels[j], comp);
+    first.label[i] = last.label[i] = this->mapper->LF(labels[j], comp);
     comp = (*(this->last_char))[labels[j]];
     i++; j++;
   }
@@ -349,13 +431,13 @@ MergedGraphReader::predecessor(comp_type comp, PathLabel& first, PathLabel& last
   comp_type first_comp = comp, last_comp = comp;
   if(i < curr.order())
   {
-    first.label[i] = this->mapper->LF(this->labels[j], first_comp);
-    first_comp = (*(this->last_char))[this->labels[j]];
-    last.label[i] = this->mapper->LF(this->labels[j + 1], last_comp);
-    last_comp = (*(this->last_char))[this->labels[j + 1]];
+    first.label[i] = this->mapper->LF(labels[j], first_comp);
+    first_comp = (*(this->last_char))[labels[j]];
+    last.label[i] = this->mapper->LF(labels[j + 1], last_comp);
+    last_comp = (*(this->last_char))[labels[j + 1]];
     i++;
   }
-  if(i < PathLabel::LABEL_LENGTH)
+  if(i < LABEL_LENGTH)
   {
     first.label[i] = this->mapper->node_rank(this->mapper->alpha.C[first_comp]);
     last.label[i] = this->mapper->node_rank(this->mapper->alpha.C[last_comp + 1]) - 1;
@@ -363,44 +445,63 @@ MergedGraphReader::predecessor(comp_type comp, PathLabel& first, PathLabel& last
   }
 
   // Pad the labels.
-  while(i < PathLabel::LABEL_LENGTH)
+  while(i < LABEL_LENGTH)
   {
-    first.label[i] = 0; last.label[i] = PathLabel::NO_RANK; i++;
+    first.label[i] = 0; last.label[i] = PathNode::NO_RANK; i++;
   }
 }
 
-inline PathLabel
-firstLabel(const PathNode& path, ReadBuffer<PathNode::rank_type>& labels)
+template<size_type LABEL_LENGTH>
+inline PathLabel<LABEL_LENGTH>
+firstLabel(const PathNode& path, const MappedArray<PathNode::rank_type>& labels)
 {
-  PathLabel res; res.first = true;
-  size_type label_length = PathLabel::LABEL_LENGTH;  // avoid direct use of static const
+  PathLabel<LABEL_LENGTH> res; res.first = true;
+  size_type label_length = LABEL_LENGTH;
   size_type limit = std::min(path.order(), label_length);
   for(size_type i = 0; i < limit; i++) { res.label[i] = path.firstLabel(i, labels); }
   for(size_type i = limit; i < label_length; i++) { res.label[i] = 0; }
   return res;
 }
 
-inline PathLabel
-lastLabel(const PathNode& path, ReadBuffer<PathNode::rank_type>& labels)
+template<size_type LABEL_LENGTH>
+inline PathLabel<LABEL_LENGTH>
+lastLabel(const PathNode& path, const MappedArray<PathNode::rank_type>& labels)
 {
-  PathLabel res; res.first = false;
-  size_type label_length = PathLabel::LABEL_LENGTH;  // avoid direct use of static const
+  PathLabel<LABEL_LENGTH> res; res.first = false;
+  size_type label_length = LABEL_LENGTH;
   size_type limit = std::min(path.order(), label_length);
   for(size_type i = 0; i < limit; i++) { res.label[i] = path.lastLabel(i, labels); }
-  for(size_type i = limit; i < label_length; i++) { res.label[i] = PathLabel::NO_RANK; }
+  for(size_type i = limit; i < label_length; i++) { res.label[i] = PathNode::NO_RANK; }
   return res;
 }
 
+template<size_type LABEL_LENGTH>
+size_type
+MergedGraphFiles::findPath(const PathLabel<LABEL_LENGTH>& first, size_type low) const
+{
+  size_type high = this->paths.size();
+  while(low < high)
+  {
+    size_type mid = low + (high - low) / 2;
+    if(lastLabel<LABEL_LENGTH>(this->paths[mid], this->labels) < first) { low = mid + 1; }
+    else { high = mid; }
+  }
+  return std::min(low, this->paths.size() - 1);
+}
+
 /*
   Does the path node intersect with the given range of labels?
 */
+template<size_type LABEL_LENGTH>
 bool
-MergedGraphReader::intersect(const PathLabel& first, const PathLabel& last, size_type offset)
+MergedGraphReader::intersect(const PathLabel<LABEL_LENGTH>& first, const PathLabel<LABEL_LENGTH>& last,
+  size_type offset) const
 {
-  PathLabel my_first = firstLabel(this->paths[this->path + offset], this->labels);
+  const PathNode& curr = this->files->paths[this->path + offset];
+  PathLabel<LABEL_LENGTH> my_first = firstLabel<LABEL_LENGTH>(curr, this->files->labels);
   if(my_first <= first)
   {
-    PathLabel my_last = lastLabel(this->paths[this->path + offset], this->labels);
+    PathLabel<LABEL_LENGTH> my_last = lastLabel<LABEL_LENGTH>(curr, this->files->labels);
     return (first <= my_last);
   }
   else
@@ -410,203 +511,244 @@ MergedGraphReader::intersect(const PathLabel& first, const PathLabel& last, size
 }
 
 void
-MergedGraphReader::fromNodes(std::vector<node_type>& results)
+MergedGraphReader::fromNodes(std::vector<node_type>& results) const
 {
   results.clear();
-  results.push_back(this->paths[this->path].from);
+  results.push_back(this->current().from);
 
-  size_type old_pointer = this->from;
-  while(this->from < this->from_nodes.size() && this->from_nodes[this->from].first == this->path)
+  const MappedArray<range_type>& from_nodes = this->files->from_nodes;
+  for(size_type i = this->from; i < from_nodes.size() && from_nodes[i].first == this->path; i++)
   {
-    results.push_back(this->from_nodes[this->from].second); this->from++;
+    results.push_back(from_nodes[i].second);
   }
-  this->from = old_pointer;
 
   removeDuplicates(results, false);
 }
 
 //------------------------------------------------------------------------------
 
-GCSA::GCSA(InputGraph& graph, const ConstructionParameters& parameters)
+/*
+  The counting support is built by traversing the ST in inorder using the LCP array. For
+  each internal node on the path to the current leaf, we store the LCP value and the first
+  and the last times (positions) we have encountered that value within the subtree. If we
+  have encountered the current from node before, the LCA of the previous and current
+  occurrences is the highest ST node we have encountered after the previous occurrence.
+  We then increment the redundant array at the first encounter with that node.
+*/
+struct OccurrenceStack
 {
-  double start = readTimer();
+  std::vector<size_type> node_lcp, first_time, last_time;
 
-  if(graph.size() == 0) { return; }
-  size_type bytes_required = graph.size() * (sizeof(PathNode) + 2 * sizeof(PathNode::rank_type));
-  if(bytes_required > parameters.size_limit)
+  inline size_type size() const { return this->node_lcp.size(); }
+
+  inline void update(size_type i, size_type lcp_value)
   {
-    std::cerr << "GCSA::GCSA(): The input is too large: " << (bytes_required / GIGABYTE_DOUBLE) << " GB" << std::endl;
-    std::cerr << "GCSA::GCSA(): Construction aborted" << std::endl;
-    std::exit(EXIT_FAILURE);
+    size_type curr_lcp = lcp_value + (i > 0 ? 1 : 0); // Handle LCP[0] as -1.
+    while(!(this->node_lcp.empty()) && this->node_lcp.back() > curr_lcp)
+    {
+      this->node_lcp.pop_back(); this->first_time.pop_back(); this->last_time.pop_back();
+    }
+    if(!(this->node_lcp.empty()) && this->node_lcp.back() == curr_lcp) { this->last_time.back() = i; }
+    else { this->node_lcp.push_back(curr_lcp); this->first_time.push_back(i); this->last_time.push_back(i); }
   }
 
-  // Extract the keys and build the necessary support structures.
-  // FIXME Later: Write the structures to disk until needed?
-  std::vector<key_type> keys;
-  graph.readKeys(keys);
-  DeBruijnGraph mapper(keys, graph.k(), graph.alpha);
-  LCP lcp(keys, graph.k());
-  sdsl::int_vector<0> last_char;
-  Key::lastChars(keys, last_char);
-  sdsl::sd_vector_builder builder(Key::label(keys[keys.size() - 1]) + 1, keys.size());
-  for(size_type i = 0; i < keys.size(); i++) { builder.set(Key::label(keys[i])); }
-  sdsl::sd_vector<> key_exists(builder);
-  sdsl::util::clear(keys);
-
-  // Determine the existing from nodes.
-  std::vector<node_type> from_node_buffer;;
-  graph.readFrom(from_node_buffer);
-  sdsl::sd_vector<> from_nodes(from_node_buffer.begin(), from_node_buffer.end());
-  sdsl::sd_vector<>::rank_1_type from_rank;
-  sdsl::util::init_support(from_rank, &(from_nodes));
-  size_type unique_from_nodes = from_node_buffer.size();
-  sdsl::util::clear(from_node_buffer);
-
-  // Create the initial PathGraph.
-  PathGraph path_graph(graph, key_exists);
-  sdsl::util::clear(key_exists);
-  if(Verbosity::level >= Verbosity::EXTENDED)
+  // The first node in the stack we have encountered at or after time 'prev'.
+  inline size_type find(size_type prev) const
   {
-    double stop = readTimer();
-    std::cerr << "GCSA::GCSA(): Preprocessing: " << (stop - start) << " seconds, "
-              << inGigabytes(memoryUsage()) << " GB" << std::endl;
-    start = stop;
+    return std::lower_bound(this->last_time.begin(), this->last_time.end(), prev) - this->last_time.begin();
   }
 
-  // Prefix-doubling.
-  if(Verbosity::level >= Verbosity::BASIC)
+  // Where to increment the redundant array, if the previous occurrence was at time 'prev' - 1.
+  inline size_type redundant(size_type prev) const
   {
-    std::cerr << "GCSA::GCSA(): Prefix-doubling from path length " << path_graph.k() << std::endl;
+    return this->first_time[this->find(prev)] - 1;
   }
-  for(size_type step = 1; step <= parameters.doubling_steps; step++)
+
+  /*
+    Continues the traversal with the stack 'next' built from an empty stack over the
+    following range of the LCP array. The bottom of 'next' has the minimal LCP value in
+    that range, so it pops all deeper nodes from this stack.
+  */
+  void append(const OccurrenceStack& next)
   {
-    if(Verbosity::level >= Verbosity::BASIC)
+    if(next.size() == 0) { return; }
+    size_type start = 0, min_lcp = next.node_lcp.front();
+    while(this->size() > 0 && this->node_lcp.back() > min_lcp)
     {
-      std::cerr << "GCSA::GCSA(): Step " << step << " (path length " << path_graph.k() << " -> "
-                << (2 * path_graph.k()) << ")" << std::endl;
+      this->node_lcp.pop_back(); this->first_time.pop_back(); this->last_time.pop_back();
     }
-    path_graph.prune(lcp, parameters.size_limit);
-    path_graph.extend(parameters.size_limit);
-  }
-  if(Verbosity::level >= Verbosity::EXTENDED)
-  {
-    double stop = readTimer();
-    std::cerr << "GCSA::GCSA(): Prefix-doubling: " << (stop - start) << " seconds, "
-              << inGigabytes(memoryUsage()) << " GB" << std::endl;
-    start = stop;
+    if(this->size() > 0 && this->node_lcp.back() == min_lcp)
+    {
+      this->last_time.back() = next.last_time.front(); start = 1;
+    }
+    this->node_lcp.insert(this->node_lcp.end(), next.node_lcp.begin() + start, next.node_lcp.end());
+    this->first_time.insert(this->first_time.end(), next.first_time.begin() + start, next.first_time.end());
+    this->last_time.insert(this->last_time.end(), next.last_time.begin() + start, next.last_time.end());
   }
+};
 
-  // Merge the paths into the nodes of a maximally pruned de Bruijn graph.
-  if(Verbosity::level >= Verbosity::BASIC)
+//------------------------------------------------------------------------------
+
+/*
+  The main construction loop is partitioned into ranges of path nodes. The ranges start
+  at multiples of 64, so that threads working on different ranges never write to the same
+  word in the shared bitvectors. Each range stores the edges as the first target path
+  and a bitvector marking where the target changes, as well as its own samples. The
+  ranges are merged after the parallel pass.
+
+  Only the dense comps use shared plain bitvectors. For the sparse comps, each range
+  stores the positions of the edges, and the final sd_vectors are built directly from
+  them. The samples are written to a temporary file, and the per-range bitvectors grow
+  as needed.
+
+  The counting support is built over the same ranges in three passes:
+  1. scanOccurrences() builds the occurrence stack over the LCP values of the range from
+     an empty stack and collects the ranks of the from nodes in the range. The stacks are
+     then combined sequentially to determine the stack at the start of each range.
+  2. countOccurrences() continues the traversal from the stack at the start of the range.
+     If the previous occurrence of a from node is within the range, it updates the
+     redundant array directly. Otherwise it records the stack depth before the first
+     node we have encountered within the range, as well as the first time for that node.
+  3. mergeOccurrences() finds the previous occurrences in the earlier ranges and updates
+     the redundant array for the first occurrences within the range. The nodes below the
+     recorded depth are in the stack at the start of the range.
+*/
+struct ConstructionRange
+{
+  range_type               paths;  // [first, last]
+  size_type                from_offset, from_limit;
+
+  std::vector<size_type>   counts, first_target;
+  std::vector<sdsl::bit_vector> steps;
+  std::vector<std::vector<size_type>> sources;  // Sparse comps.
+
+  std::string              sample_name;
+  sdsl::bit_vector         sample_ends;
+  size_type                sample_count, sample_bits;
+
+  // Counting support. The vectors are indexed by the position of the from node in from_ranks.
+  OccurrenceStack          stack;
+  std::vector<size_type>   from_ranks, last_occ, first_depth, first_time;
+
+  // Minimum length of a range.
+  const static size_type MINIMUM_SIZE = 64 * KILOBYTE;
+
+  // Memory usage of parallel counting per occurrence of a from node.
+  const static size_type COUNTING_BYTES = 4 * sizeof(size_type);
+
+  ConstructionRange(range_type path_range, size_type first_from, size_type from_end, size_type sigma) :
+    paths(path_range), from_offset(first_from), from_limit(from_end),
+    counts(sigma, 0), first_target(sigma, 0), steps(sigma), sources(sigma),
+    sample_count(0), sample_bits(0)
   {
-    std::cerr << "GCSA::GCSA(): Merging the paths" << std::endl;
   }
-  MergedGraph merged_graph(path_graph, mapper, lcp, parameters.size_limit);
-  this->header.path_nodes = merged_graph.size();
-  this->header.order = merged_graph.k();
-  path_graph.clear();
-  sdsl::util::clear(lcp);
-  if(Verbosity::level >= Verbosity::EXTENDED)
+
+  inline size_type length() const { return Range::length(this->paths); }
+
+  // Comp 0 and the comps after the fast chars are sparse.
+  inline static bool sparse(const Alphabet& alpha, size_type comp)
   {
-    double stop = readTimer();
-    std::cerr << "GCSA::GCSA(): Merging: " << (stop - start) << " seconds, "
-              << inGigabytes(memoryUsage()) << " GB" << std::endl;
-    start = stop;
+    return (comp == 0 || comp > alpha.fast_chars);
   }
 
-  // Structures used for building GCSA.
-  if(Verbosity::level >= Verbosity::BASIC)
+  // Sets bits[i] = value, doubling the size of the bitvector if necessary.
+  inline static void set(sdsl::bit_vector& bits, size_type i, bool value)
   {
-    std::cerr << "GCSA::GCSA(): Building the index" << std::endl;
+    if(i >= bits.size()) { bits.resize(std::max(2 * bits.size(), i + 1)); }
+    bits[i] = value;
   }
-  sdsl::int_vector<64> counts(graph.alpha.sigma, 0); // alpha
-  std::vector<bit_vector> bwt(graph.alpha.sigma); // fast_bwt, sparse_bwt
-  for(size_type comp = 0; comp < bwt.size(); comp++) { bwt[comp] = bit_vector(merged_graph.size(), 0); }
-  CounterArray outdegrees(merged_graph.size(), 4); // edges
-  bit_vector sampled_positions(merged_graph.size(), 0); // sampled_paths
-  std::vector<node_type> sample_buffer; // stored_samples
-  this->samples = bit_vector(merged_graph.size() + merged_graph.extra(), 0);
 
-  // Structures used for building counting support.
-  // Invariant: The previous occurrence of from node x was at path prev_occ[from_rank(x)] - 1.
-  CounterArray occurrences(merged_graph.size(), 4), redundant(merged_graph.size() - 1, 4);
-  sdsl::int_vector<0> prev_occ(unique_from_nodes, 0, bit_length(merged_graph.size()));
-  std::vector<size_type> node_lcp, first_time, last_time;
+  // Uses labels of length 1 << doubling_steps.
+  void build(const MergedGraph& merged_graph, const MergedGraphFiles& files, const DeBruijnGraph& mapper,
+    const sdsl::int_vector<0>& last_char, std::vector<sdsl::bit_vector>& bwt, sdsl::bit_vector& sampled_positions,
+    size_type doubling_steps);
 
-  // Read pointers to the MergedGraph files.
-  std::vector<MergedGraphReader> reader(graph.alpha.sigma + 1);
-  reader[0].init(merged_graph, &mapper, &last_char);
-  for(size_type comp = 0; comp < graph.alpha.sigma; comp++)
+  template<size_type LABEL_LENGTH>
+  void build(const MergedGraph& merged_graph, const MergedGraphFiles& files, const DeBruijnGraph& mapper,
+    const sdsl::int_vector<0>& last_char, std::vector<sdsl::bit_vector>& bwt, sdsl::bit_vector& sampled_positions);
+
+  void scanOccurrences(const MergedGraphFiles& files, const sdsl::sd_vector<>::rank_1_type& from_rank);
+  void countOccurrences(const MergedGraphFiles& files, const sdsl::sd_vector<>::rank_1_type& from_rank,
+    CounterArray& occurrences, CounterArray& redundant, LCPArray* lcp_output);
+  void mergeOccurrences(sdsl::int_vector<0>& prev_occ, CounterArray& redundant);
+};
+
+void
+ConstructionRange::build(const MergedGraph& merged_graph, const MergedGraphFiles& files, const DeBruijnGraph& mapper,
+  const sdsl::int_vector<0>& last_char, std::vector<sdsl::bit_vector>& bwt, sdsl::bit_vector& sampled_positions,
+  size_type doubling_steps)
+{
+  switch(doubling_steps)
   {
-    reader[comp + 1].init(merged_graph, comp);
+    case 1:
+      this->build<2>(merged_graph, files, mapper, last_char, bwt, sampled_positions); break;
+    case 2:
+      this->build<4>(merged_graph, files, mapper, last_char, bwt, sampled_positions); break;
+    case 3:
+      this->build<8>(merged_graph, files, mapper, last_char, bwt, sampled_positions); break;
+    case 4:
+      this->build<16>(merged_graph, files, mapper, last_char, bwt, sampled_positions); break;
+    default:
+      std::cerr << "ConstructionRange::build(): Invalid number of doubling steps: " << doubling_steps << std::endl;
+      std::exit(EXIT_FAILURE);
   }
-  ReadBuffer<uint8_t> lcp_array; lcp_array.open(merged_graph.lcp_name);
+}
+
+template<size_type LABEL_LENGTH>
+void
+ConstructionRange::build(const MergedGraph& merged_graph, const MergedGraphFiles& files, const DeBruijnGraph& mapper,
+  const sdsl::int_vector<0>& last_char, std::vector<sdsl::bit_vector>& bwt, sdsl::bit_vector& sampled_positions)
+{
+  // The comp readers are positioned when they are needed for the first time.
+  std::vector<MergedGraphReader> reader(mapper.alpha.sigma + 1);
+  reader[0].init(files, this->paths.first, this->from_offset, &mapper, &last_char);
+  WriteBuffer<node_type> sample_file(this->sample_name);
 
-  // The actual construction.
-  PathLabel first, last;
-  size_type total_edges = 0, sample_bits = 0;
+  PathLabel<LABEL_LENGTH> first, last;
   std::vector<node_type> pred_from, curr_from;
-  for(size_type i = 0; i < merged_graph.size(); i++, reader[0].advance())
+  for(size_type i = this->paths.first; i <= this->paths.second; i++, reader[0].advance())
   {
     // Find the predecessors.
     size_type indegree = 0, pred_comp = 0;
     bool sample_this = false;
-    for(size_type comp = 0; comp < graph.alpha.sigma; comp++)
+    for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
     {
-      if(!(reader[0].paths[reader[0].path].hasPredecessor(comp))) { continue; }
+      if(!(reader[0].current().hasPredecessor(comp))) { continue; }
 
       // Find the predecessor of paths[i] with comp and the path intersecting it.
       reader[0].predecessor(comp, first, last);
-      if(!(reader[comp + 1].intersect(first, last, 0)))
+      bool new_target = false;
+      if(this->counts[comp] == 0)
+      {
+        size_type target = files.findPath(first, merged_graph.next[comp]);
+        reader[comp + 1].init(files, target, files.findFrom(target));
+        this->first_target[comp] = target;
+      }
+      else if(!(reader[comp + 1].intersect(first, last, 0)))
       {
+        size_type old_target = reader[comp + 1].path;
         reader[comp + 1].advance();
+        new_target = (reader[comp + 1].path != old_target);
       }
 
       // Add the edge.
-      bwt[comp][i] = 1; counts[comp]++;
-      indegree++; outdegrees.increment(reader[comp + 1].path); total_edges++;
+      set(this->steps[comp], this->counts[comp], new_target);
+      if(sparse(mapper.alpha, comp)) { this->sources[comp].push_back(i); }
+      else { bwt[comp][i] = 1; }
+      this->counts[comp]++;
+      indegree++;
       pred_comp = comp; // For sampling.
     }
 
-    /*
-      Get the from nodes and update the occurrences/redundant arrays.
-
-      We traverse the ST in inorder using the LCP array. For each internal node, we
-      record the LCP value and the first and the last times (positions) we have
-      encountered that value within the subtree. If we have encountered the current
-      from node before, the LCA of the previous and current occurrences is the
-      highest ST node we have encountered after the previous occurrence. We then
-      increment the redundant array at the first encounter with that node.
-    */
-    reader[0].fromNodes(curr_from);
-    occurrences.increment(i, curr_from.size() - 1);
-    lcp_array.seek(i);
-    size_type curr_lcp = lcp_array[i] + (i > 0 ? 1 : 0); // Handle LCP[0] as -1.
-    while(!(node_lcp.empty()) && node_lcp.back() > curr_lcp)
-    {
-      node_lcp.pop_back(); first_time.pop_back(); last_time.pop_back();
-    }
-    if(!(node_lcp.empty()) && node_lcp.back() == curr_lcp) { last_time.back() = i; }
-    else { node_lcp.push_back(curr_lcp); first_time.push_back(i); last_time.push_back(i); }
-    for(size_type j = 0; j < curr_from.size(); j++)
-    {
-      size_type temp = from_rank(curr_from[j]);
-      if(prev_occ[temp] > 0)
-      {
-        size_type pos = std::lower_bound(last_time.begin(), last_time.end(), prev_occ[temp]) - last_time.begin();
-        redundant.increment(first_time[pos] - 1);
-      }
-      prev_occ[temp] = i + 1;
-    }
-
     /*
       Simple cases for sampling the node:
       - multiple predecessors
       - at the beginning of the source node with no real predecessors
       - at the beginning of a node in the original graph (makes the previous case redundant)
     */
+    reader[0].fromNodes(curr_from);
     if(indegree > 1) { sample_this = true; }
-    if(reader[0].paths[reader[0].path].hasPredecessor(Alphabet::SINK_COMP)) { sample_this = true; }
+    if(reader[0].current().hasPredecessor(Alphabet::SINK_COMP)) { sample_this = true; }
     for(size_type k = 0; k < curr_from.size(); k++)
     {
       if(Node::offset(curr_from[k]) == 0) { sample_this = true; break; }
@@ -632,78 +774,1524 @@ GCSA::GCSA(InputGraph& graph, const ConstructionParameters& parameters)
       sampled_positions[i] = 1;
       for(size_type k = 0; k < curr_from.size(); k++)
       {
-        sample_bits = std::max(sample_bits, bit_length(curr_from[k]));
-        sample_buffer.push_back(curr_from[k]);
+        this->sample_bits = std::max(this->sample_bits, bit_length(curr_from[k]));
+        sample_file.push_back(curr_from[k]);
+        set(this->sample_ends, this->sample_count, k + 1 == curr_from.size());
+        this->sample_count++;
       }
-      this->samples[sample_buffer.size() - 1] = 1;
     }
   }
-  for(size_type i = 0; i < reader.size(); i++) { reader[i].close(); }
-  lcp_array.close();
-  sdsl::util::clear(last_char); sdsl::util::clear(from_nodes); sdsl::util::clear(prev_occ);
-  this->header.edges = total_edges;
-
-  // Initialize alpha.
-  this->alpha = Alphabet(counts, graph.alpha.char2comp, graph.alpha.comp2char);
-  sdsl::util::clear(mapper);
-
-  // Initialize extra_pointers and redundant_pointers.
-  size_type occ_count = occurrences.sum() + occurrences.size(), red_count = redundant.sum();
-  this->extra_pointers = SadaSparse(occurrences);
-  this->redundant_pointers = SadaCount(redundant);
-  sdsl::util::clear(occurrences); sdsl::util::clear(redundant);
+  sample_file.close();
+}
 
-  // Initialize bwt.
-  this->fast_bwt.resize(this->alpha.sigma); this->fast_rank.resize(this->alpha.sigma);
-  this->sparse_bwt.resize(this->alpha.sigma); this->sparse_rank.resize(this->alpha.sigma);
-  this->sparse_bwt[0] = bwt[0]; sdsl::util::clear(bwt[0]);
-  for(size_type comp = 1; comp <= graph.alpha.fast_chars; comp++)
+void
+ConstructionRange::scanOccurrences(const MergedGraphFiles& files, const sdsl::sd_vector<>::rank_1_type& from_rank)
+{
+  MergedGraphReader reader; reader.init(files, this->paths.first, this->from_offset);
+  std::vector<node_type> curr_from;
+  for(size_type i = this->paths.first; i <= this->paths.second; i++, reader.advance())
   {
-    this->fast_bwt[comp] = bwt[comp]; sdsl::util::clear(bwt[comp]);
+    this->stack.update(i, files.lcp[i]);
+    reader.fromNodes(curr_from);
+    for(node_type node : curr_from) { this->from_ranks.push_back(from_rank(node)); }
   }
-  for(size_type comp = graph.alpha.fast_chars + 1; comp < graph.alpha.sigma; comp++)
+  removeDuplicates(this->from_ranks, false);
+}
+
+void
+ConstructionRange::countOccurrences(const MergedGraphFiles& files, const sdsl::sd_vector<>::rank_1_type& from_rank,
+  CounterArray& occurrences, CounterArray& redundant, LCPArray* lcp_output)
+{
+  // Invariant: The previous occurrence of from node x in this range was at path
+  // last_occ[k] - 1, where from_ranks[k] == from_rank(x).
+  this->last_occ = std::vector<size_type>(this->from_ranks.size(), 0);
+  this->first_depth = std::vector<size_type>(this->from_ranks.size(), 0);
+  this->first_time = std::vector<size_type>(this->from_ranks.size(), 0);
+  OccurrenceStack curr_stack = this->stack;
+
+  MergedGraphReader reader; reader.init(files, this->paths.first, this->from_offset);
+  std::vector<node_type> curr_from;
+  for(size_type i = this->paths.first; i <= this->paths.second; i++, reader.advance())
   {
-    this->sparse_bwt[comp] = bwt[comp]; sdsl::util::clear(bwt[comp]);
+    reader.fromNodes(curr_from);
+    occurrences.atomicIncrement(i, curr_from.size() - 1);
+
+    if(lcp_output != nullptr) { lcp_output->setLeaf(i, files.lcp[i]); }
+    curr_stack.update(i, files.lcp[i]);
+    for(node_type node : curr_from)
+    {
+      size_type temp = from_rank(node);
+      size_type k = std::lower_bound(this->from_ranks.begin(), this->from_ranks.end(), temp) - this->from_ranks.begin();
+      if(this->last_occ[k] > 0) { redundant.atomicIncrement(curr_stack.redundant(this->last_occ[k])); }
+      else
+      {
+        size_type depth = curr_stack.find(this->paths.first);
+        this->first_depth[k] = depth; this->first_time[k] = curr_stack.first_time[depth];
+      }
+      this->last_occ[k] = i + 1;
+    }
   }
+}
 
-  // Initialize bitvectors (edges, sampled_positions, samples).
-  bit_vector edge_buffer(total_edges, 0); total_edges = 0;
-  for(size_type i = 0; i < merged_graph.size(); i++)
+void
+ConstructionRange::mergeOccurrences(sdsl::int_vector<0>& prev_occ, CounterArray& redundant)
+{
+  for(size_type k = 0; k < this->from_ranks.size(); k++)
   {
-    total_edges += outdegrees[i];
-    edge_buffer[total_edges - 1] = 1;
+    size_type temp = this->from_ranks[k];
+    if(prev_occ[temp] > 0)
+    {
+      size_type depth = this->first_depth[k];
+      size_type pos = std::lower_bound(this->stack.last_time.begin(), this->stack.last_time.begin() + depth,
+        prev_occ[temp]) - this->stack.last_time.begin();
+      redundant.increment((pos < depth ? this->stack.first_time[pos] : this->first_time[k]) - 1);
+    }
+    prev_occ[temp] = this->last_occ[k];
   }
-  outdegrees.clear();
-  this->edges = edge_buffer; sdsl::util::clear(edge_buffer);
-  this->sampled_paths = sampled_positions; sdsl::util::clear(sampled_positions);
-  this->samples.resize(sample_buffer.size());
-  this->initSupport();
-
-  // Initialize stored_samples.
-  this->stored_samples = sdsl::int_vector<0>(sample_buffer.size(), 0, sample_bits);
-  for(size_type i = 0; i < sample_buffer.size(); i++) { this->stored_samples[i] = sample_buffer[i]; }
-  sdsl::util::clear(sample_buffer);
+  sdsl::util::clear(this->from_ranks); sdsl::util::clear(this->last_occ);
+  sdsl::util::clear(this->first_depth); sdsl::util::clear(this->first_time);
+}
 
-  // Transfer the LCP array from MergedGraph to InputGraph.
-  TempFile::remove(graph.lcp_name);
-  graph.lcp_name = merged_graph.lcp_name;
-  merged_graph.lcp_name.clear();
+/*
+  Sequential counting over all path nodes. This is used instead of the per-range passes
+  when they would not fit in the memory limit. The pass runs alongside the parallel
+  ranges. It also builds the LCP array if requested.
+*/
+void
+countOccurrences(const MergedGraphFiles& files,
+  const sdsl::sd_vector<>::rank_1_type& from_rank, size_type unique_from_nodes,
+  CounterArray& occurrences, CounterArray& redundant, LCPArray* lcp_output)
+{
+  // Invariant: The previous occurrence of from node x was at path prev_occ[from_rank(x)] - 1.
+  sdsl::int_vector<0> prev_occ(unique_from_nodes, 0, bit_length(files.paths.size()));
+  OccurrenceStack stack;
 
-  if(Verbosity::level >= Verbosity::EXTENDED)
+  MergedGraphReader reader; reader.init(files, 0, 0);
+  std::vector<node_type> curr_from;
+  for(size_type i = 0; i < files.paths.size(); i++, reader.advance())
   {
-    double stop = readTimer();
-    std::cerr << "GCSA::GCSA(): Construction: " << (stop - start) << " seconds, "
-              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+    reader.fromNodes(curr_from);
+    occurrences.increment(i, curr_from.size() - 1);
+
+    if(lcp_output != nullptr) { lcp_output->setValue(i, files.lcp[i]); }
+    stack.update(i, files.lcp[i]);
+    for(node_type node : curr_from)
+    {
+      size_type temp = from_rank(node);
+      if(prev_occ[temp] > 0) { redundant.increment(stack.redundant(prev_occ[temp])); }
+      prev_occ[temp] = i + 1;
+    }
   }
-  if(Verbosity::level >= Verbosity::BASIC)
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  Construction checkpoints. The support structures built during preprocessing are stored
+  in a data file, while the manifest stores the phase and the serialized PathGraph or
+  MergedGraph. Phases 0 to doubling_steps correspond to a PathGraph after that many
+  doubling steps, and phase doubling_steps + 1 corresponds to the MergedGraph.
+
+  Construction deletes the files of the previous phase before the next phase is complete.
+  The checkpoint keeps hard links to the files of the last completed phase, and the manifest
+  refers to the links. The manifest is written to a temporary file that is then renamed over
+  the old one, and the links of the earlier phase are removed only after that.
+*/
+
+struct ConstructionCheckpoint
+{
+  std::string manifest_name, data_name;
+  size_type   input_size, input_order, doubling_steps;
+  size_type   phase;
+
+  std::vector<std::string> links;
+
+  const static std::uint32_t TAG = 0x43504B54;
+  const static std::uint32_t VERSION = 3;
+  const static size_type NO_PHASE = ~(size_type)0;
+  const static std::string DATA_EXTENSION;  // .data
+  const static std::string TEMP_EXTENSION;  // .tmp
+  const static std::string PREFIX;          // .checkpoint
+
+  ConstructionCheckpoint(const InputGraph& graph, const ConstructionParameters& parameters);
+
+  inline bool enabled() const { return !(this->manifest_name.empty()); }
+  inline bool resumable() const { return (this->phase != NO_PHASE); }
+  inline size_type mergedPhase() const { return this->doubling_steps + 1; }
+
+  void saveStructures(const DeBruijnGraph& mapper, const LCP& lcp, const sdsl::int_vector<0>& last_char,
+    const sdsl::sd_vector<>& from_nodes, size_type unique_from_nodes) const;
+  void loadStructures(DeBruijnGraph& mapper, LCP& lcp, sdsl::int_vector<0>& last_char,
+    sdsl::sd_vector<>& from_nodes, size_type& unique_from_nodes) const;
+
+  // The file names in the graph are temporarily replaced with the names of the links.
+  template<class GraphType>
+  void save(GraphType& graph, size_type completed_phase);
+
+  // The graph will own new links to the files referred to by the checkpoint.
+  template<class GraphType>
+  void load(GraphType& graph);
+
+  void remove();
+
+  void readHeader(std::istream& in);
+  void writeHeader(std::ostream& out) const;
+  static void link(const std::string& source, const std::string& target);
+};
+
+const std::string ConstructionCheckpoint::DATA_EXTENSION = ".data";
+const std::string ConstructionCheckpoint::TEMP_EXTENSION = ".tmp";
+const std::string ConstructionCheckpoint::PREFIX = ".checkpoint";
+
+void
+fileNames(PathGraph& graph, std::vector<std::string*>& names)
+{
+  for(size_type file = 0; file < graph.files(); file++)
   {
-    std::cerr << "GCSA::GCSA(): " << this->size() << " paths, " << this->edgeCount() << " edges" << std::endl;
-    std::cerr << "GCSA::GCSA(): " << occ_count << " pointers (" << red_count << " redundant)" << std::endl;
-    std::cerr << "GCSA::GCSA(): " << this->sampleCount() << " samples at "
-              << this->sampledPositions() << " positions" << std::endl;
+    names.push_back(&(graph.path_names[file])); names.push_back(&(graph.rank_names[file]));
   }
 }
 
+void
+fileNames(MergedGraph& graph, std::vector<std::string*>& names)
+{
+  names.push_back(&(graph.path_name)); names.push_back(&(graph.rank_name));
+  names.push_back(&(graph.from_name)); names.push_back(&(graph.lcp_name));
+}
+
+ConstructionCheckpoint::ConstructionCheckpoint(const InputGraph& graph, const ConstructionParameters& parameters) :
+  manifest_name(parameters.checkpoint_file),
+  input_size(graph.size()), input_order(graph.k()), doubling_steps(parameters.doubling_steps),
+  phase(NO_PHASE)
+{
+  if(!(this->enabled())) { return; }
+  this->data_name = this->manifest_name + DATA_EXTENSION;
+
+  std::ifstream in(this->manifest_name.c_str(), std::ios_base::binary);
+  if(!in) { return; }
+  this->readHeader(in);
+  in.close();
+}
+
+void
+ConstructionCheckpoint::saveStructures(const DeBruijnGraph& mapper, const LCP& lcp, const sdsl::int_vector<0>& last_char,
+  const sdsl::sd_vector<>& from_nodes, size_type unique_from_nodes) const
+{
+  if(!(this->enabled())) { return; }
+
+  std::ofstream out(this->data_name.c_str(), std::ios_base::binary);
+  if(!out)
+  {
+    std::cerr << "ConstructionCheckpoint::saveStructures(): Cannot open output file " << this->data_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  mapper.serialize(out); lcp.serialize(out); last_char.serialize(out); from_nodes.serialize(out);
+  sdsl::write_member(unique_from_nodes, out);
+  out.close();
+}
+
+void
+ConstructionCheckpoint::loadStructures(DeBruijnGraph& mapper, LCP& lcp, sdsl::int_vector<0>& last_char,
+  sdsl::sd_vector<>& from_nodes, size_type& unique_from_nodes) const
+{
+  std::ifstream in(this->data_name.c_str(), std::ios_base::binary);
+  if(!in)
+  {
+    std::cerr << "ConstructionCheckpoint::loadStructures(): Cannot open input file " << this->data_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  mapper.load(in); lcp.load(in); last_char.load(in); from_nodes.load(in);
+  sdsl::read_member(unique_from_nodes, in);
+  in.close();
+}
+
+template<class GraphType>
+void
+ConstructionCheckpoint::save(GraphType& graph, size_type completed_phase)
+{
+  if(!(this->enabled())) { return; }
+
+  // Link the files and temporarily use the links in the graph.
+  std::vector<std::string*> names; fileNames(graph, names);
+  std::vector<std::string> new_links(names.size());
+  for(size_type i = 0; i < names.size(); i++)
+  {
+    new_links[i] = TempFile::getName(PREFIX, *(names[i]));
+    link(*(names[i]), new_links[i]);
+    names[i]->swap(new_links[i]);
+  }
+
+  std::string temp_name = this->manifest_name + TEMP_EXTENSION;
+  std::ofstream out(temp_name.c_str(), std::ios_base::binary);
+  if(!out)
+  {
+    std::cerr << "ConstructionCheckpoint::save(): Cannot open output file " << temp_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  this->writeHeader(out);
+  sdsl::write_member(completed_phase, out);
+  graph.serialize(out);
+  out.close();
+  for(size_type i = 0; i < names.size(); i++) { names[i]->swap(new_links[i]); }
+  if(!out || std::rename(temp_name.c_str(), this->manifest_name.c_str()) != 0)
+  {
+    std::cerr << "ConstructionCheckpoint::save(): Cannot write checkpoint " << this->manifest_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  for(size_type i = 0; i < this->links.size(); i++) { TempFile::remove(this->links[i]); }
+  this->links.swap(new_links);
+  this->phase = completed_phase;
+}
+
+template<class GraphType>
+void
+ConstructionCheckpoint::load(GraphType& graph)
+{
+  std::ifstream in(this->manifest_name.c_str(), std::ios_base::binary);
+  if(!in)
+  {
+    std::cerr << "ConstructionCheckpoint::load(): Cannot open input file " << this->manifest_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  this->readHeader(in);
+  graph.load(in);
+  in.close();
+
+  std::vector<std::string*> names; fileNames(graph, names);
+  this->links.resize(names.size());
+  for(size_type i = 0; i < names.size(); i++)
+  {
+    this->links[i] = TempFile::getName(PathGraph::PREFIX, *(names[i]));
+    link(*(names[i]), this->links[i]);
+    names[i]->swap(this->links[i]);
+  }
+}
+
+void
+ConstructionCheckpoint::remove()
+{
+  if(!(this->enabled())) { return; }
+  for(size_type i = 0; i < this->links.size(); i++) { TempFile::remove(this->links[i]); }
+  sdsl::util::clear(this->links);
+  std::remove(this->manifest_name.c_str());
+  std::remove(this->data_name.c_str());
+  this->phase = NO_PHASE;
+}
+
+void
+ConstructionCheckpoint::readHeader(std::istream& in)
+{
+  std::uint32_t tag = 0, version = 0;
+  size_type size = 0, order = 0, steps = 0;
+  sdsl::read_member(tag, in); sdsl::read_member(version, in);
+  sdsl::read_member(size, in); sdsl::read_member(order, in); sdsl::read_member(steps, in);
+  sdsl::read_member(this->phase, in);
+  if(!in || tag != TAG || version != VERSION || this->phase > this->mergedPhase())
+  {
+    std::cerr << "ConstructionCheckpoint: Invalid checkpoint file " << this->manifest_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if(size != this->input_size || order != this->input_order || steps != this->doubling_steps)
+  {
+    std::cerr << "ConstructionCheckpoint: Checkpoint " << this->manifest_name
+              << " does not match the input or the parameters" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+void
+ConstructionCheckpoint::writeHeader(std::ostream& out) const
+{
+  std::uint32_t tag = TAG, version = VERSION;
+  sdsl::write_member(tag, out); sdsl::write_member(version, out);
+  sdsl::write_member(this->input_size, out); sdsl::write_member(this->input_order, out);
+  sdsl::write_member(this->doubling_steps, out);
+}
+
+void
+ConstructionCheckpoint::link(const std::string& source, const std::string& target)
+{
+  if(::link(source.c_str(), target.c_str()) != 0)
+  {
+    std::cerr << "ConstructionCheckpoint::link(): Cannot link " << source << " to " << target << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+GCSA::GCSA(InputGraph& graph, const ConstructionParameters& parameters, LCPArray* lcp_output)
+{
+  double start = readTimer();
+  ConstructionProfile profile;
+
+  if(graph.size() == 0) { return; }
+  size_type bytes_required = graph.size() * (sizeof(PathNode) + 2 * sizeof(PathNode::rank_type));
+  if(bytes_required > parameters.size_limit)
+  {
+    std::cerr << "GCSA::GCSA(): The input is too large: " << (bytes_required / GIGABYTE_DOUBLE) << " GB" << std::endl;
+    std::cerr << "GCSA::GCSA(): Construction aborted" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  /*
+    Use in-memory temporary files if the PathGraph is expected to fit in half of the memory
+    limit. The estimate allows the size to double in each step, with a factor 4 of slack.
+    If the estimate is too low, new temporary files go to disk once the ram files use half
+    of the memory limit. Checkpoints require files on disk.
+  */
+  bool old_in_memory = TempFile::in_memory;
+  size_type old_ram_limit = TempFile::ram_limit;
+  size_type estimated_bytes = bytes_required << (parameters.doubling_steps + 2);
+  TempFile::in_memory = parameters.checkpoint_file.empty()
+    && (old_in_memory || estimated_bytes <= parameters.memory_limit / 2);
+  TempFile::ram_limit = std::min(old_ram_limit, parameters.memory_limit / 2);
+  if(TempFile::in_memory && Verbosity::level >= Verbosity::EXTENDED)
+  {
+    std::cerr << "GCSA::GCSA(): Using in-memory temporary files" << std::endl;
+  }
+
+  // Extract the keys and build the necessary support structures, or resume from a checkpoint.
+  // FIXME Later: Write the structures to disk until needed?
+  ConstructionCheckpoint checkpoint(graph, parameters);
+  DeBruijnGraph mapper;
+  LCP lcp;
+  sdsl::int_vector<0> last_char;
+  sdsl::sd_vector<> from_nodes;
+  size_type unique_from_nodes = 0;
+  PathGraph path_graph(0, 0, 0);
+  MergedGraph merged_graph;
+  size_type first_step = 1;
+  if(checkpoint.resumable())
+  {
+    if(Verbosity::level >= Verbosity::BASIC)
+    {
+      std::cerr << "GCSA::GCSA(): Resuming from checkpoint " << checkpoint.manifest_name
+                << " (phase " << checkpoint.phase << ")" << std::endl;
+    }
+    checkpoint.loadStructures(mapper, lcp, last_char, from_nodes, unique_from_nodes);
+    if(checkpoint.phase < checkpoint.mergedPhase()) { checkpoint.load(path_graph); }
+    else { checkpoint.load(merged_graph); }
+    first_step = checkpoint.phase + 1;
+  }
+  else
+  {
+    // Read the input once, creating the initial PathGraph and extracting the keys and the from nodes.
+    std::vector<key_type> keys;
+    std::vector<node_type> from_node_buffer;
+    PathGraph temp_graph(graph, keys, from_node_buffer, parameters.memory_limit); path_graph.swap(temp_graph);
+
+    // Build the necessary support structures.
+    DeBruijnGraph temp_mapper(keys, graph.k(), graph.alpha); mapper.swap(temp_mapper);
+    LCP temp_lcp(keys, graph.k()); lcp.swap(temp_lcp);
+    Key::lastChars(keys, last_char);
+    sdsl::util::clear(keys);
+    sdsl::sd_vector<> temp_from(from_node_buffer.begin(), from_node_buffer.end()); from_nodes.swap(temp_from);
+    unique_from_nodes = from_node_buffer.size();
+    sdsl::util::clear(from_node_buffer);
+    checkpoint.saveStructures(mapper, lcp, last_char, from_nodes, unique_from_nodes);
+    checkpoint.save(path_graph, 0);
+  }
+  sdsl::sd_vector<>::rank_1_type from_rank;
+  sdsl::util::init_support(from_rank, &(from_nodes));
+  {
+    ConstructionProfile::Phase& phase = profile.record("preprocessing");
+    phase.add("kmers", graph.size()); phase.add("paths", path_graph.size());
+    phase.add("from_nodes", unique_from_nodes);
+  }
+  if(Verbosity::level >= Verbosity::EXTENDED)
+  {
+    double stop = readTimer();
+    std::cerr << "GCSA::GCSA(): Preprocessing: " << (stop - start) << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+    start = stop;
+  }
+
+  /*
+    The mapper is not needed during prefix-doubling. If the support structures use a large
+    fraction of the memory limit, write the mapper to disk until the merging phase.
+  */
+  std::string mapper_name;
+  if(!(TempFile::in_memory) && first_step <= parameters.doubling_steps
+    && 4 * (sdsl::size_in_bytes(mapper) + sdsl::size_in_bytes(lcp)) > parameters.memory_limit)
+  {
+    mapper_name = TempFile::getName(PathGraph::PREFIX);
+    sdsl::store_to_file(mapper, mapper_name);
+    TempFile::setSize(mapper_name, sdsl::size_in_bytes(mapper));
+    sdsl::util::clear(mapper);
+    if(Verbosity::level >= Verbosity::EXTENDED)
+    {
+      std::cerr << "GCSA::GCSA(): Wrote the mapper to disk during prefix-doubling" << std::endl;
+    }
+  }
+
+  // Prefix-doubling.
+  if(first_step <= parameters.doubling_steps && Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "GCSA::GCSA(): Prefix-doubling from path length " << path_graph.k() << std::endl;
+  }
+  for(size_type step = first_step; step <= parameters.doubling_steps; step++)
+  {
+    if(Verbosity::level >= Verbosity::BASIC)
+    {
+      std::cerr << "GCSA::GCSA(): Step " << step << " (path length " << path_graph.k() << " -> "
+                << (2 * path_graph.k()) << ")" << std::endl;
+    }
+    path_graph.prune(lcp, parameters.size_limit, parameters.memory_limit);
+    {
+      ConstructionProfile::Phase& phase = profile.record("prune", step);
+      phase.add("paths", path_graph.size()); phase.add("unique", path_graph.unique);
+      phase.add("redundant", path_graph.redundant); phase.add("unsorted", path_graph.unsorted);
+      phase.add("nondeterministic", path_graph.nondeterministic);
+    }
+    path_graph.extend(parameters.size_limit, parameters.memory_limit);
+    checkpoint.save(path_graph, step);
+    {
+      ConstructionProfile::Phase& phase = profile.record("extend", step);
+      phase.add("paths", path_graph.size()); phase.add("order", path_graph.k());
+    }
+  }
+  if(Verbosity::level >= Verbosity::EXTENDED)
+  {
+    double stop = readTimer();
+    std::cerr << "GCSA::GCSA(): Prefix-doubling: " << (stop - start) << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+    start = stop;
+  }
+  if(!(mapper_name.empty()))
+  {
+    sdsl::load_from_file(mapper, mapper_name);
+    TempFile::remove(mapper_name);
+  }
+
+  // Merge the paths into the nodes of a maximally pruned de Bruijn graph.
+  if(first_step <= checkpoint.mergedPhase())
+  {
+    if(Verbosity::level >= Verbosity::BASIC)
+    {
+      std::cerr << "GCSA::GCSA(): Merging the paths" << std::endl;
+    }
+    MergedGraph temp_graph(path_graph, mapper, lcp, parameters.size_limit, parameters.memory_limit);
+    merged_graph.swap(temp_graph);
+    checkpoint.save(merged_graph, checkpoint.mergedPhase());
+  }
+  this->header.path_nodes = merged_graph.size();
+  this->header.order = merged_graph.k();
+  path_graph.clear();
+  sdsl::util::clear(lcp);
+  {
+    ConstructionProfile::Phase& phase = profile.record("merging");
+    phase.add("paths", merged_graph.size()); phase.add("order", merged_graph.k());
+    phase.add("from_nodes", merged_graph.extra());
+  }
+  if(Verbosity::level >= Verbosity::EXTENDED)
+  {
+    double stop = readTimer();
+    std::cerr << "GCSA::GCSA(): Merging: " << (stop - start) << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+    start = stop;
+  }
+
+  // Structures used for building GCSA.
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "GCSA::GCSA(): Building the index" << std::endl;
+  }
+  sdsl::int_vector<64> counts(graph.alpha.sigma, 0); // alpha
+  std::vector<bit_vector> bwt(graph.alpha.sigma); // fast_bwt
+  for(size_type comp = 0; comp < bwt.size(); comp++)
+  {
+    if(!(ConstructionRange::sparse(graph.alpha, comp))) { bwt[comp] = bit_vector(merged_graph.size(), 0); }
+  }
+  CounterArray outdegrees(merged_graph.size(), 4); // edges
+  bit_vector sampled_positions(merged_graph.size(), 0); // sampled_paths
+
+  // Structures used for building counting support.
+  CounterArray occurrences(merged_graph.size(), 4), redundant(merged_graph.size() - 1, 4);
+  if(lcp_output != nullptr) { *lcp_output = LCPArray(merged_graph.size(), parameters.lcp_branching); }
+
+  // Partition the path nodes into ranges and build them. All ranges share the same
+  // read-only view of the MergedGraph files.
+  std::vector<ConstructionRange> ranges;
+  {
+    MergedGraphFiles files(merged_graph);
+    size_type threads = omp_get_max_threads();
+    size_type range_size = (merged_graph.size() + threads - 1) / threads;
+    range_size = std::max(range_size, ConstructionRange::MINIMUM_SIZE);
+    range_size = ((range_size + WORD_BITS - 1) / WORD_BITS) * WORD_BITS;
+    size_type from_offset = 0;
+    for(size_type start = 0; start < merged_graph.size(); start += range_size)
+    {
+      size_type limit = std::min(start + range_size, merged_graph.size());
+      size_type from_limit = files.findFrom(limit);
+      ranges.push_back(ConstructionRange(range_type(start, limit - 1), from_offset, from_limit, graph.alpha.sigma));
+      ranges.back().sample_name = TempFile::getName(MergedGraph::PREFIX);
+      from_offset = from_limit;
+    }
+
+    // Counting uses the same ranges, if the per-range structures fit in the memory limit.
+    // Otherwise task 0 is the sequential counting pass.
+    size_type occurrence_count = merged_graph.size() + merged_graph.extra();
+    bool parallel_counting = (ranges.size() > 1 &&
+      occurrence_count * ConstructionRange::COUNTING_BYTES <= parameters.memory_limit / 2);
+    if(Verbosity::level >= Verbosity::EXTENDED)
+    {
+      std::cerr << "GCSA::GCSA(): " << ranges.size() << " ranges of path nodes ("
+                << (parallel_counting ? "parallel" : "sequential") << " counting)" << std::endl;
+    }
+    if(parallel_counting)
+    {
+      #pragma omp parallel for schedule(dynamic, 1)
+      for(size_type r = 0; r < ranges.size(); r++) { ranges[r].scanOccurrences(files, from_rank); }
+      OccurrenceStack stack;
+      for(size_type r = 0; r < ranges.size(); r++)
+      {
+        OccurrenceStack next = stack; next.append(ranges[r].stack);
+        ranges[r].stack = stack; stack = next;
+      }
+    }
+
+    // The actual construction.
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(size_type task = (parallel_counting ? 1 : 0); task <= ranges.size(); task++)
+    {
+      if(task == 0)
+      {
+        countOccurrences(files, from_rank, unique_from_nodes, occurrences, redundant, lcp_output);
+      }
+      else
+      {
+        ranges[task - 1].build(merged_graph, files, mapper, last_char, bwt, sampled_positions,
+          parameters.doubling_steps);
+        if(parallel_counting)
+        {
+          ranges[task - 1].countOccurrences(files, from_rank, occurrences, redundant, lcp_output);
+        }
+      }
+    }
+
+    // Handle the from nodes with the previous occurrence in an earlier range.
+    if(parallel_counting)
+    {
+      sdsl::int_vector<0> prev_occ(unique_from_nodes, 0, bit_length(merged_graph.size()));
+      for(size_type r = 0; r < ranges.size(); r++) { ranges[r].mergeOccurrences(prev_occ, redundant); }
+      if(lcp_output != nullptr) { lcp_output->buildInternal(); }
+    }
+  }
+  if(lcp_output != nullptr) { lcp_output->finish(); }
+  sdsl::util::clear(last_char); sdsl::util::clear(from_nodes);
+
+  // Merge the ranges.
+  size_type total_edges = 0, total_samples = 0, sample_bits = 0;
+  for(size_type r = 0; r < ranges.size(); r++)
+  {
+    ConstructionRange& range = ranges[r];
+    for(size_type comp = 0; comp < graph.alpha.sigma; comp++)
+    {
+      size_type target = range.first_target[comp];
+      for(size_type k = 0; k < range.counts[comp]; k++)
+      {
+        target += range.steps[comp][k];
+        outdegrees.increment(target);
+      }
+      counts[comp] += range.counts[comp]; total_edges += range.counts[comp];
+      sdsl::util::clear(range.steps[comp]);
+    }
+    total_samples += range.sample_count;
+    sample_bits = std::max(sample_bits, range.sample_bits);
+  }
+  this->header.edges = total_edges;
+
+  // Initialize alpha.
+  this->alpha = Alphabet(counts, graph.alpha.char2comp, graph.alpha.comp2char);
+  sdsl::util::clear(mapper);
+
+  // Initialize extra_pointers and redundant_pointers.
+  size_type occ_count = occurrences.sum() + occurrences.size(), red_count = redundant.sum();
+  this->extra_pointers = SadaSparse(occurrences);
+  this->redundant_pointers = SadaCount(redundant);
+  sdsl::util::clear(occurrences); sdsl::util::clear(redundant);
+
+  // Initialize bwt. The sparse comps are built directly from the edge positions.
+  this->fast_bwt.resize(this->alpha.sigma); this->fast_rank.resize(this->alpha.sigma);
+  this->sparse_bwt.resize(this->alpha.sigma); this->sparse_rank.resize(this->alpha.sigma);
+  for(size_type comp = 0; comp < graph.alpha.sigma; comp++)
+  {
+    if(!(ConstructionRange::sparse(graph.alpha, comp)))
+    {
+      this->fast_bwt[comp] = bwt[comp]; sdsl::util::clear(bwt[comp]);
+      continue;
+    }
+    sdsl::sd_vector_builder builder(merged_graph.size(), counts[comp]);
+    for(size_type r = 0; r < ranges.size(); r++)
+    {
+      for(size_type i : ranges[r].sources[comp]) { builder.set(i); }
+      sdsl::util::clear(ranges[r].sources[comp]);
+    }
+    this->sparse_bwt[comp] = sparse_vector(builder);
+  }
+
+  // Initialize bitvectors (edges, sampled_positions).
+  bit_vector edge_buffer(total_edges, 0); total_edges = 0;
+  for(size_type i = 0; i < merged_graph.size(); i++)
+  {
+    total_edges += outdegrees[i];
+    edge_buffer[total_edges - 1] = 1;
+  }
+  outdegrees.clear();
+  this->edges = edge_buffer; sdsl::util::clear(edge_buffer);
+  this->sampled_paths = sampled_positions; sdsl::util::clear(sampled_positions);
+
+  // Initialize samples and stored_samples from the sample files.
+  this->samples = bit_vector(total_samples, 0);
+  this->stored_samples = sdsl::int_vector<0>(total_samples, 0, sample_bits);
+  std::vector<node_type> sample_buffer;
+  for(size_type r = 0, offset = 0; r < ranges.size(); r++)
+  {
+    ConstructionRange& range = ranges[r];
+    ElementFile<node_type> sample_file;
+    sample_file.open(range.sample_name, false);
+    for(size_type k = 0; k < range.sample_count; k += sample_buffer.size())
+    {
+      sample_buffer.resize(std::min(MEGABYTE, range.sample_count - k));
+      sample_file.read(k, sample_buffer.data(), sample_buffer.size());
+      for(size_type j = 0; j < sample_buffer.size(); j++)
+      {
+        this->stored_samples[offset + k + j] = sample_buffer[j];
+        if(range.sample_ends[k + j]) { this->samples[offset + k + j] = 1; }
+      }
+    }
+    sample_file.close(); TempFile::remove(range.sample_name);
+    offset += range.sample_count;
+  }
+  sdsl::util::clear(sample_buffer);
+  sdsl::util::clear(ranges);
+  this->initSupport();
+
+  // Transfer the LCP array from MergedGraph to InputGraph, unless it has already been built.
+  TempFile::remove(graph.lcp_name);
+  if(lcp_output != nullptr) { TempFile::remove(merged_graph.lcp_name); }
+  else
+  {
+    graph.lcp_name = merged_graph.lcp_name;
+    merged_graph.lcp_name.clear();
+  }
+  checkpoint.remove();
+  TempFile::in_memory = old_in_memory; TempFile::ram_limit = old_ram_limit;
+
+  {
+    ConstructionProfile::Phase& phase = profile.record("construction");
+    phase.add("paths", this->size()); phase.add("edges", this->edgeCount());
+    phase.add("pointers", occ_count); phase.add("redundant_pointers", red_count);
+    phase.add("samples", this->sampleCount()); phase.add("sampled_positions", this->sampledPositions());
+  }
+  if(!(parameters.profile_file.empty()) && !(profile.write(parameters.profile_file, parameters)))
+  {
+    std::cerr << "GCSA::GCSA(): Cannot write profile " << parameters.profile_file << std::endl;
+  }
+
+  if(Verbosity::level >= Verbosity::EXTENDED)
+  {
+    double stop = readTimer();
+    std::cerr << "GCSA::GCSA(): Construction: " << (stop - start) << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+  }
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "GCSA::GCSA(): " << this->size() << " paths, " << this->edgeCount() << " edges" << std::endl;
+    std::cerr << "GCSA::GCSA(): " << occ_count << " pointers (" << red_count << " redundant)" << std::endl;
+    std::cerr << "GCSA::GCSA(): " << this->sampleCount() << " samples at "
+              << this->sampledPositions() << " positions" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  Merging two indexes. The label of a path node of one index may be a prefix of the label
+  of a path node in the other index. Such path nodes must be split before the indexes can
+  be merged. We represent each input as a refinement, where the path nodes are obtained by
+  splitting the original path nodes between incoming edges. The refinement is a valid GCSA
+  without the samples, and each refined path node has the same from nodes as the original.
+*/
+
+inline bool
+hasPredecessor(const GCSA& index, size_type path_node, comp_type comp)
+{
+  if(comp > 0 && comp <= index.alpha.fast_chars) { return index.fast_bwt[comp][path_node]; }
+  return index.sparse_bwt[comp][path_node];
+}
+
+struct RefinedIndex
+{
+  const GCSA*                            index;
+  sdsl::int_vector<0>                    original;
+  std::vector<GCSA::bit_vector>          bwt;
+  std::vector<GCSA::bit_vector::rank_1_type>   bwt_rank;
+  std::vector<GCSA::bit_vector::select_1_type> bwt_select;
+  sdsl::int_vector<64>                   C;
+  GCSA::bit_vector                       edges;
+  GCSA::bit_vector::rank_1_type          edge_rank;
+  GCSA::bit_vector::select_1_type        edge_select;
+
+  // Give up if the refinement grows beyond this many times the original path nodes.
+  const static size_type MAX_REFINEMENT = 4;
+
+  RefinedIndex() : index(nullptr) {}
+
+  // Initializes the refinement with the path nodes of the index.
+  void init(const GCSA& source, size_type sigma);
+
+  // Splits each path node after the incoming edges marked in split_after.
+  void split(const GCSA::bit_vector& split_after);
+
+  void initSupport();
+
+  inline size_type size() const { return this->original.size(); }
+  inline size_type edgeCount() const { return this->edges.size(); }
+  inline size_type sigma() const { return this->bwt.size(); }
+
+  // Approximate memory usage of the refinement, excluding the support structures.
+  size_type bytes() const;
+
+  inline bool hasPredecessor(size_type path_node, comp_type comp) const { return this->bwt[comp][path_node]; }
+
+  inline size_type edge(size_type path_node, comp_type comp) const
+  {
+    return this->C[comp] + this->bwt_rank[comp](path_node);
+  }
+
+  inline size_type LF(size_type path_node, comp_type comp) const
+  {
+    return this->edge_rank(this->edge(path_node, comp));
+  }
+
+  // Follow the first edge backwards in the same order as GCSA::LF().
+  inline size_type LF(size_type path_node) const
+  {
+    for(size_type comp = 1; comp < this->sigma(); comp++)
+    {
+      if(this->hasPredecessor(path_node, comp)) { return this->LF(path_node, comp); }
+    }
+    return this->LF(path_node, 0);
+  }
+
+  inline range_type incoming(size_type path_node) const
+  {
+    return range_type((path_node > 0 ? this->edge_select(path_node) + 1 : 0), this->edge_select(path_node + 1));
+  }
+
+  inline comp_type edgeChar(size_type edge) const
+  {
+    comp_type comp = 0;
+    while(this->C[comp + 1] <= edge) { comp++; }
+    return comp;
+  }
+
+  // The path node the incoming edge with the given character comes from.
+  inline size_type source(size_type edge, comp_type comp) const
+  {
+    return this->bwt_select[comp](edge - this->C[comp] + 1);
+  }
+
+  RefinedIndex(const RefinedIndex&) = delete;
+  RefinedIndex& operator= (const RefinedIndex&) = delete;
+};
+
+void
+RefinedIndex::init(const GCSA& source, size_type sigma)
+{
+  this->index = &source;
+  this->original = sdsl::int_vector<0>(source.size(), 0, bit_length(std::max(source.size(), (size_type)1)));
+  for(size_type i = 0; i < source.size(); i++) { this->original[i] = i; }
+
+  this->bwt = std::vector<GCSA::bit_vector>(sigma, GCSA::bit_vector(source.size(), 0));
+  for(size_type i = 0; i < source.size(); i++)
+  {
+    for(size_type comp = 0; comp < sigma; comp++)
+    {
+      if(gcsa::hasPredecessor(source, i, comp)) { this->bwt[comp][i] = 1; }
+    }
+  }
+
+  this->C = sdsl::int_vector<64>(sigma + 1, 0);
+  if(source.size() > 0) { this->C = source.alpha.C; }
+  this->edges = GCSA::bit_vector(source.edgeCount(), 0);
+  for(size_type i = 0; i < source.edgeCount(); i++) { this->edges[i] = source.edges[i]; }
+  this->initSupport();
+}
+
+void
+RefinedIndex::split(const GCSA::bit_vector& split_after)
+{
+  // The refined path nodes of path node i are first[i] to first[i + 1] - 1.
+  sdsl::int_vector<0> first(this->size() + 1, 0, bit_length(this->size() + this->edgeCount()));
+  for(size_type i = 0; i < this->size(); i++)
+  {
+    range_type range = this->incoming(i);
+    size_type pieces = 1;
+    for(size_type edge = range.first; edge < range.second; edge++) { pieces += split_after[edge]; }
+    first[i + 1] = first[i] + pieces;
+  }
+  size_type new_size = first[this->size()];
+
+  sdsl::int_vector<0> new_original(new_size, 0, this->original.width());
+  std::vector<GCSA::bit_vector> new_bwt(this->sigma(), GCSA::bit_vector(new_size, 0));
+  sdsl::int_vector<64> counts(this->sigma(), 0);
+  for(size_type i = 0; i < this->size(); i++)
+  {
+    for(size_type j = first[i]; j < first[i + 1]; j++)
+    {
+      new_original[j] = this->original[i];
+      for(size_type comp = 0; comp < this->sigma(); comp++)
+      {
+        if(this->hasPredecessor(i, comp)) { new_bwt[comp][j] = 1; counts[comp]++; }
+      }
+    }
+  }
+
+  // Each refined path node of a source has an edge to the refined path node of the target.
+  size_type total_edges = 0;
+  for(size_type comp = 0; comp < this->sigma(); comp++) { total_edges += counts[comp]; }
+  GCSA::bit_vector new_edges(total_edges, 0); total_edges = 0;
+  for(size_type i = 0; i < this->size(); i++)
+  {
+    range_type range = this->incoming(i);
+    comp_type comp = this->edgeChar(range.first);
+    for(size_type edge = range.first; edge <= range.second; edge++)
+    {
+      size_type source = this->source(edge, comp);
+      total_edges += first[source + 1] - first[source];
+      if(edge == range.second || split_after[edge]) { new_edges[total_edges - 1] = 1; }
+    }
+  }
+
+  this->original.swap(new_original);
+  this->bwt.swap(new_bwt);
+  for(size_type comp = 0, sum = 0; comp < this->sigma(); comp++)
+  {
+    this->C[comp] = sum; sum += counts[comp];
+  }
+  this->C[this->sigma()] = total_edges;
+  this->edges.swap(new_edges);
+  this->initSupport();
+}
+
+size_type
+RefinedIndex::bytes() const
+{
+  size_type result = sdsl::size_in_bytes(this->original) + sdsl::size_in_bytes(this->edges);
+  for(size_type comp = 0; comp < this->sigma(); comp++) { result += sdsl::size_in_bytes(this->bwt[comp]); }
+  return result;
+}
+
+void
+RefinedIndex::initSupport()
+{
+  this->bwt_rank.resize(this->sigma()); this->bwt_select.resize(this->sigma());
+  for(size_type comp = 0; comp < this->sigma(); comp++)
+  {
+    sdsl::util::init_support(this->bwt_rank[comp], &(this->bwt[comp]));
+    sdsl::util::init_support(this->bwt_select[comp], &(this->bwt[comp]));
+  }
+  sdsl::util::init_support(this->edge_rank, &(this->edges));
+  sdsl::util::init_support(this->edge_select, &(this->edges));
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  Each path node is represented by two boundary items: its lexicographically first and
+  last strings. Item 2i of an index is the first string of path node i and item 2i + 1 is
+  the last string. The first string of a path node with first character c is c followed by
+  the first string of the path node using the first incoming edge, and similarly for the
+  last string.
+
+  We refine the interleaving of the items one character at a time, as in the Holt-McMillan
+  BWT merging algorithm, until the items are sorted by their first order() characters or
+  the interleaving no longer changes. The items of each index remain in the same order, so
+  the interleaving is a bitvector with 1-bits marking the items of the second index.
+  item_lcp[i] is the depth at which the items at positions i - 1 and i were separated, and
+  items with item_lcp >= order() are considered equal. As in construction, the strings end
+  at the first endmarker, so all items starting with it are equal.
+*/
+struct ItemOrder
+{
+  GCSA::bit_vector              interleaving;
+  GCSA::bit_vector::rank_1_type interleaving_rank;
+  sdsl::int_vector<0>           item_lcp;
+  sdsl::int_vector<0>           positions[2];
+  std::vector<size_type>        block_min;
+  size_type                     order;
+
+  const static size_type BLOCK_SIZE = 256;
+
+  ItemOrder() : order(0) {}
+
+  void build(const RefinedIndex* refined[2], size_type max_order);
+
+  inline size_type size() const { return this->interleaving.size(); }
+
+  inline size_type position(size_type origin, size_type path_node, bool last) const
+  {
+    return this->positions[origin][2 * path_node + last];
+  }
+
+  // The length of the common prefix of the strings of the path node.
+  size_type label(size_type origin, size_type path_node) const;
+
+  // The first position after pos with item_lcp < depth, or size() if there is none.
+  size_type blockEnd(size_type pos, size_type depth) const;
+
+  ItemOrder(const ItemOrder&) = delete;
+  ItemOrder& operator= (const ItemOrder&) = delete;
+};
+
+void
+ItemOrder::build(const RefinedIndex* refined[2], size_type max_order)
+{
+  this->order = max_order;
+  size_type sigma = refined[0]->sigma();
+
+  // Bucket boundaries by the first character.
+  std::vector<size_type> bucket_start(sigma + 1, 0);
+  std::vector<size_type> bucket_items[2];
+  for(size_type origin = 0; origin < 2; origin++)
+  {
+    const RefinedIndex& index = *(refined[origin]);
+    bucket_items[origin] = std::vector<size_type>(sigma, 0);
+    if(index.size() == 0) { continue; }
+    for(size_type comp = 0; comp < sigma; comp++)
+    {
+      bucket_items[origin][comp] = 2 * (index.edge_rank(index.C[comp + 1]) - index.edge_rank(index.C[comp]));
+    }
+  }
+  for(size_type comp = 0; comp < sigma; comp++)
+  {
+    bucket_start[comp + 1] = bucket_start[comp] + bucket_items[0][comp] + bucket_items[1][comp];
+  }
+
+  // The items sorted by their first characters.
+  size_type total_items = bucket_start[sigma];
+  this->interleaving = GCSA::bit_vector(total_items, 0);
+  this->item_lcp = sdsl::int_vector<0>(total_items, this->order, bit_length(this->order));
+  for(size_type comp = 0; comp < sigma; comp++)
+  {
+    for(size_type i = 0; i < bucket_items[1][comp]; i++)
+    {
+      this->interleaving[bucket_start[comp] + bucket_items[0][comp] + i] = 1;
+    }
+    if(bucket_start[comp] < total_items) { this->item_lcp[bucket_start[comp]] = 0; }
+  }
+
+  // Add one character at a time.
+  const size_type NO_BLOCK = ~(size_type)0;
+  GCSA::bit_vector next(total_items, 0);
+  std::vector<size_type> tail(sigma), last_block(sigma);
+  size_type depth = 1;
+  for(; depth < this->order; depth++)
+  {
+    for(size_type comp = 0; comp < sigma; comp++) { tail[comp] = bucket_start[comp]; last_block[comp] = NO_BLOCK; }
+    size_type items[2] = { 0, 0 }, block = 0;
+    bool changed = false;
+    for(size_type i = 0; i < total_items; i++)
+    {
+      if(this->item_lcp[i] < depth) { block++; }
+      size_type origin = this->interleaving[i];
+      const RefinedIndex& index = *(refined[origin]);
+      size_type path_node = items[origin] / 2;
+      bool last = items[origin] & 1;
+      items[origin]++;
+      for(size_type comp = 0; comp < sigma; comp++)
+      {
+        if(!(index.hasPredecessor(path_node, comp))) { continue; }
+        size_type edge = index.edge(path_node, comp);
+        if(last ? !(index.edges[edge]) : (edge > 0 && !(index.edges[edge - 1]))) { continue; }
+        size_type pos = tail[comp]; tail[comp]++;
+        next[pos] = origin;
+        if(comp > 0 && pos > bucket_start[comp] && last_block[comp] != block && this->item_lcp[pos] >= depth)
+        {
+          this->item_lcp[pos] = depth; changed = true;
+        }
+        last_block[comp] = block;
+      }
+    }
+    if(!changed && next == this->interleaving) { break; }
+    this->interleaving.swap(next);
+  }
+  sdsl::util::clear(next);
+  sdsl::util::init_support(this->interleaving_rank, &(this->interleaving));
+
+  // Item positions and the minimal LCP values in each block.
+  for(size_type origin = 0; origin < 2; origin++)
+  {
+    this->positions[origin] = sdsl::int_vector<0>(2 * refined[origin]->size(), 0, bit_length(std::max(total_items, (size_type)1)));
+  }
+  this->block_min = std::vector<size_type>((total_items + BLOCK_SIZE - 1) / BLOCK_SIZE, this->order);
+  for(size_type i = 0, items[2] = { 0, 0 }; i < total_items; i++)
+  {
+    size_type origin = this->interleaving[i];
+    this->positions[origin][items[origin]] = i; items[origin]++;
+    this->block_min[i / BLOCK_SIZE] = std::min(this->block_min[i / BLOCK_SIZE], (size_type)(this->item_lcp[i]));
+  }
+
+  if(Verbosity::level >= Verbosity::FULL)
+  {
+    std::cerr << "GCSA::GCSA(): Interleaved " << total_items << " items in " << depth << " steps" << std::endl;
+  }
+}
+
+size_type
+ItemOrder::label(size_type origin, size_type path_node) const
+{
+  size_type result = this->order;
+  for(size_type i = this->position(origin, path_node, false) + 1; i <= this->position(origin, path_node, true); i++)
+  {
+    result = std::min(result, (size_type)(this->item_lcp[i]));
+  }
+  return result;
+}
+
+size_type
+ItemOrder::blockEnd(size_type pos, size_type depth) const
+{
+  size_type i = pos + 1;
+  while(i < this->size() && i % BLOCK_SIZE != 0)
+  {
+    if(this->item_lcp[i] < depth) { return i; }
+    i++;
+  }
+  while(i < this->size() && this->block_min[i / BLOCK_SIZE] >= depth) { i += BLOCK_SIZE; }
+  while(i < this->size())
+  {
+    if(this->item_lcp[i] < depth) { return i; }
+    i++;
+  }
+  return this->size();
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  A path node is closed if its strings are exactly the strings starting with its label.
+*/
+bool
+closedPathNode(const ItemOrder& items, size_type origin, size_type path_node)
+{
+  size_type first = items.position(origin, path_node, false), last = items.position(origin, path_node, true);
+  size_type label = items.label(origin, path_node);
+  if(last > first + 1 && label < items.order) { return false; }
+  if(first > 0 && items.item_lcp[first] >= label) { return false; }
+  if(last + 1 < items.size() && items.item_lcp[last + 1] >= label) { return false; }
+  return true;
+}
+
+/*
+  Groups the items into the path nodes of the merged index. A group is a maximal run of
+  items, where the path nodes overlap or the items are equal. A group is valid if it
+  contains a single path node or a path node from each index with all items equal, and
+  if the strings of the group are exactly the strings starting with its label. For each
+  merged path node, origins stores a bitmask of the inputs it contains, and path_lcp
+  stores the LCP with the previous path node.
+
+  Returns false and stores the path nodes that are not closed in conflicts if some groups
+  are invalid.
+*/
+bool
+groupItems(const ItemOrder& items, size_type max_size,
+  sdsl::int_vector<2>& origins, sdsl::int_vector<8>& path_lcp, std::vector<range_type>& conflicts)
+{
+  // avoid direct use of static const
+  size_type max_lcp = std::numeric_limits<std::uint8_t>::max();
+
+  origins = sdsl::int_vector<2>(max_size, 0);
+  path_lcp = sdsl::int_vector<8>(max_size, 0);
+  conflicts.clear();
+  std::vector<range_type> group;
+  size_type merged_size = 0, item_count[2] = { 0, 0 }, item_class = 0;
+  size_type present = 0, open = 0, first_class = 0, group_class = 0, group_lcp = 0, group_label = 0;
+  for(size_type i = 0; i <= items.size(); i++)
+  {
+    if(i < items.size() && items.item_lcp[i] < items.order) { item_class++; }
+    if(!(group.empty()) && open == 0 && (i == items.size() || item_class != group_class))
+    {
+      bool valid = (group.size() == 1 || (group.size() == 2 && present == 3 && first_class == group_class));
+      if(valid && group_lcp < group_label && (i == items.size() || items.item_lcp[i] < group_label))
+      {
+        origins[merged_size] = present; path_lcp[merged_size] = std::min(group_lcp, max_lcp); merged_size++;
+      }
+      else
+      {
+        for(range_type node : group)
+        {
+          if(!closedPathNode(items, node.first, node.second)) { conflicts.push_back(node); }
+        }
+      }
+      group.clear(); present = 0;
+    }
+    if(i >= items.size()) { break; }
+
+    size_type origin = items.interleaving[i], mask = (size_type)1 << origin;
+    bool last = item_count[origin] & 1;
+    if(group.empty())
+    {
+      first_class = item_class; group_label = items.order;
+      group_lcp = (i > 0 ? (size_type)(items.item_lcp[i]) : 0);
+    }
+    else { group_label = std::min(group_label, (size_type)(items.item_lcp[i])); }
+    if(last) { open &= ~mask; }
+    else
+    {
+      group.push_back(range_type(origin, item_count[origin] / 2));
+      present |= mask; open |= mask;
+    }
+    item_count[origin]++;
+    group_class = item_class;
+  }
+
+  origins.resize(merged_size); path_lcp.resize(merged_size);
+  return conflicts.empty();
+}
+
+/*
+  Splits a refined path node by the first depth characters of its strings. The strings of
+  the path node are c followed by the strings of its sources, so we split the incoming
+  edges between sources in different blocks at depth - 1 and mark the splits in
+  split_after. If a source straddles a boundary, its incoming edge is split from the rest,
+  and we continue by splitting the source. The path node will be split further in the
+  next round.
+*/
+void
+splitPathNode(const RefinedIndex* refined[2], const ItemOrder& items, GCSA::bit_vector split_after[2],
+  size_type origin, size_type path_node, size_type depth)
+{
+  if(depth <= 1) { return; }
+  const RefinedIndex& index = *(refined[origin]);
+  range_type range = index.incoming(path_node);
+  comp_type comp = index.edgeChar(range.first);
+  for(size_type edge = range.first; edge <= range.second; edge++)
+  {
+    size_type source = index.source(edge, comp);
+    size_type first = items.position(origin, source, false), last = items.position(origin, source, true);
+    if(items.blockEnd(first, depth - 1) <= last)
+    {
+      if(edge > range.first) { split_after[origin][edge - 1] = 1; }
+      if(edge < range.second) { split_after[origin][edge] = 1; }
+      splitPathNode(refined, items, split_after, origin, source, depth - 1);
+    }
+    else if(edge < range.second &&
+            items.blockEnd(last, depth - 1) <= items.position(origin, index.source(edge + 1, comp), false))
+    {
+      split_after[origin][edge] = 1;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+GCSA::GCSA(const GCSA& first, const GCSA& second, const ConstructionParameters& parameters, LCPArray* lcp_output)
+{
+  double start = readTimer();
+
+  const GCSA* indexes[2] = { &first, &second };
+  const GCSA& base = (first.size() > 0 ? first : second);
+  if(base.size() == 0) { return; }
+  if(first.size() > 0 && second.size() > 0)
+  {
+    if(first.order() != second.order())
+    {
+      std::cerr << "GCSA::GCSA(): Cannot merge indexes of order " << first.order() << " and "
+                << second.order() << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if(first.alpha.sigma != second.alpha.sigma || first.alpha.fast_chars != second.alpha.fast_chars ||
+       first.alpha.char2comp != second.alpha.char2comp || first.alpha.comp2char != second.alpha.comp2char)
+    {
+      std::cerr << "GCSA::GCSA(): Cannot merge indexes with different alphabets" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "GCSA::GCSA(): Merging indexes with " << first.size() << " and " << second.size()
+              << " paths" << std::endl;
+  }
+  size_type sigma = base.alpha.sigma;
+
+  // Collect the from nodes and check that the node ids are disjoint.
+  std::vector<node_type> from_buffer[2], results;
+  for(size_type origin = 0; origin < 2; origin++)
+  {
+    for(size_type i = 0; i < indexes[origin]->size(); i++)
+    {
+      indexes[origin]->locate(i, results);
+      from_buffer[origin].insert(from_buffer[origin].end(), results.begin(), results.end());
+    }
+    removeDuplicates(from_buffer[origin], false);
+  }
+  for(size_type i = 0, j = 0; i < from_buffer[0].size() && j < from_buffer[1].size(); )
+  {
+    size_type first_id = Node::id(from_buffer[0][i]), second_id = Node::id(from_buffer[1][j]);
+    if(first_id == second_id)
+    {
+      std::cerr << "GCSA::GCSA(): Node " << first_id << " is in both indexes" << std::endl;
+      std::cerr << "GCSA::GCSA(): Only indexes of graphs with disjoint node ids can be merged" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if(first_id < second_id) { i++; } else { j++; }
+  }
+  from_buffer[0].insert(from_buffer[0].end(), from_buffer[1].begin(), from_buffer[1].end());
+  sdsl::util::clear(from_buffer[1]);
+  removeDuplicates(from_buffer[0], false);
+  sdsl::sd_vector<> from_nodes(from_buffer[0].begin(), from_buffer[0].end());
+  size_type unique_from_nodes = from_buffer[0].size();
+  sdsl::util::clear(from_buffer[0]);
+  sdsl::sd_vector<>::rank_1_type from_rank;
+  sdsl::util::init_support(from_rank, &(from_nodes));
+
+  /*
+    Refine the inputs until the path nodes can be merged. Each round extends the labels of
+    the conflicting path nodes by at least one character, so all conflicts should be
+    resolved after order() rounds. If the graphs share long paths (e.g. an index merged
+    with a copy of itself with shifted node ids), the labels may remain non-unique until
+    they reach order(), and the refinement grows by a constant factor in each round. We
+    give up if the rounds run out, if the refinement has more than MAX_REFINEMENT times the
+    path nodes of the inputs, or if it exceeds the memory limit.
+  */
+  RefinedIndex refined_storage[2];
+  const RefinedIndex* refined[2] = { &(refined_storage[0]), &(refined_storage[1]) };
+  refined_storage[0].init(first, sigma); refined_storage[1].init(second, sigma);
+  sdsl::int_vector<2> origins;
+  sdsl::int_vector<8> path_lcp;
+  size_type max_refinement = RefinedIndex::MAX_REFINEMENT; // avoid direct use of static const
+  for(size_type round = 1; ; round++)
+  {
+    ItemOrder items;
+    items.build(refined, base.order());
+    std::vector<range_type> conflicts;
+    if(groupItems(items, refined[0]->size() + refined[1]->size(), origins, path_lcp, conflicts)) { break; }
+    if(round > base.order())
+    {
+      std::cerr << "GCSA::GCSA(): The labels of " << conflicts.size() << " paths are not unique after "
+                << base.order() << " rounds of refinement" << std::endl;
+      std::cerr << "GCSA::GCSA(): The graphs share too many paths to be merged" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+
+    // Extend the labels of the conflicting path nodes by one character.
+    bit_vector split_after[2];
+    for(size_type origin = 0; origin < 2; origin++) { split_after[origin] = bit_vector(refined[origin]->edgeCount(), 0); }
+    for(range_type node : conflicts)
+    {
+      size_type label = items.label(node.first, node.second);
+      if(label < items.order) { splitPathNode(refined, items, split_after, node.first, node.second, label + 1); }
+    }
+    size_type splits[2] = { 0, 0 };
+    for(size_type origin = 0; origin < 2; origin++)
+    {
+      for(size_type i = 0; i < split_after[origin].size(); i++) { splits[origin] += split_after[origin][i]; }
+      if(splits[origin] > 0) { refined_storage[origin].split(split_after[origin]); }
+    }
+    if(Verbosity::level >= Verbosity::EXTENDED)
+    {
+      std::cerr << "GCSA::GCSA(): Round " << round << ": " << conflicts.size() << " conflicting paths, "
+                << refined[0]->size() << " + " << refined[1]->size() << " paths after refinement" << std::endl;
+    }
+    if(splits[0] + splits[1] == 0)
+    {
+      std::cerr << "GCSA::GCSA(): Cannot refine the indexes for merging" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if(refined[0]->size() + refined[1]->size() > max_refinement * (first.size() + second.size()))
+    {
+      std::cerr << "GCSA::GCSA(): Refinement round " << round << " has " << refined[0]->size() << " + "
+                << refined[1]->size() << " paths, more than " << max_refinement
+                << " times the paths in the inputs" << std::endl;
+      std::cerr << "GCSA::GCSA(): The graphs share too many paths to be merged" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    size_type refined_bytes = refined[0]->bytes() + refined[1]->bytes();
+    if(refined_bytes > parameters.memory_limit)
+    {
+      std::cerr << "GCSA::GCSA(): Refinement round " << round << " requires " << inGigabytes(refined_bytes)
+                << " GB, exceeding the memory limit of " << inGigabytes(parameters.memory_limit) << " GB" << std::endl;
+      std::cerr << "GCSA::GCSA(): The graphs share too many paths to be merged" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  size_type merged_size = origins.size();
+  this->header.path_nodes = merged_size;
+  this->header.order = base.order();
+  sdsl::int_vector<0> mapping[2];
+  for(size_type origin = 0; origin < 2; origin++)
+  {
+    mapping[origin] = sdsl::int_vector<0>(refined[origin]->size(), 0, bit_length(merged_size));
+  }
+  for(size_type i = 0, path_node[2] = { 0, 0 }; i < merged_size; i++)
+  {
+    for(size_type origin = 0; origin < 2; origin++)
+    {
+      if(origins[i] & (1 << origin)) { mapping[origin][path_node[origin]] = i; path_node[origin]++; }
+    }
+  }
+
+  // Predecessors, fast bwt, and edges.
+  sdsl::int_vector<64> counts(sigma, 0);
+  std::vector<bit_vector> bwt(sigma);
+  for(size_type comp = 0; comp < sigma; comp++)
+  {
+    if(!(ConstructionRange::sparse(base.alpha, comp))) { bwt[comp] = bit_vector(merged_size, 0); }
+  }
+  CounterArray outdegrees(merged_size, 4);
+  for(size_type i = 0, path_node[2] = { 0, 0 }; i < merged_size; i++)
+  {
+    for(size_type comp = 0; comp < sigma; comp++)
+    {
+      size_type target = 0; bool found = false;
+      for(size_type origin = 0; origin < 2; origin++)
+      {
+        if(!(origins[i] & (1 << origin)) || !(refined[origin]->hasPredecessor(path_node[origin], comp))) { continue; }
+        size_type temp = mapping[origin][refined[origin]->LF(path_node[origin], comp)];
+        if(found && temp != target)
+        {
+          std::cerr << "GCSA::GCSA(): Merged path node " << i << " has inconsistent predecessors" << std::endl;
+          std::exit(EXIT_FAILURE);
+        }
+        target = temp; found = true;
+      }
+      if(!found) { continue; }
+      outdegrees.increment(target); counts[comp]++;
+      if(!(ConstructionRange::sparse(base.alpha, comp))) { bwt[comp][i] = 1; }
+    }
+    for(size_type origin = 0; origin < 2; origin++)
+    {
+      if(origins[i] & (1 << origin)) { path_node[origin]++; }
+    }
+  }
+  this->alpha = Alphabet(counts, base.alpha.char2comp, base.alpha.comp2char);
+  this->alpha.fast_chars = base.alpha.fast_chars;
+
+  // Initialize bwt. Each sparse comp is built in a separate pass.
+  this->fast_bwt.resize(sigma); this->fast_rank.resize(sigma);
+  this->sparse_bwt.resize(sigma); this->sparse_rank.resize(sigma);
+  for(size_type comp = 0; comp < sigma; comp++)
+  {
+    if(!(ConstructionRange::sparse(base.alpha, comp)))
+    {
+      this->fast_bwt[comp] = bwt[comp]; sdsl::util::clear(bwt[comp]);
+      continue;
+    }
+    sdsl::sd_vector_builder builder(merged_size, counts[comp]);
+    for(size_type i = 0, path_node[2] = { 0, 0 }; i < merged_size; i++)
+    {
+      bool found = false;
+      for(size_type origin = 0; origin < 2; origin++)
+      {
+        if(!(origins[i] & (1 << origin))) { continue; }
+        found |= refined[origin]->hasPredecessor(path_node[origin], comp);
+        path_node[origin]++;
+      }
+      if(found) { builder.set(i); }
+    }
+    this->sparse_bwt[comp] = sparse_vector(builder);
+  }
+
+  // Initialize edges.
+  size_type total_edges = outdegrees.sum();
+  bit_vector edge_buffer(total_edges, 0); total_edges = 0;
+  for(size_type i = 0; i < merged_size; i++)
+  {
+    total_edges += outdegrees[i];
+    edge_buffer[total_edges - 1] = 1;
+  }
+  outdegrees.clear();
+  this->header.edges = total_edges;
+  this->edges = edge_buffer; sdsl::util::clear(edge_buffer);
+
+  /*
+    Samples, counting support, and the LCP array. Merged path nodes are always sampled.
+    Other path nodes keep the samples of the original path node, and they must also be
+    sampled if the path node reached by following the first edge backwards has been merged.
+  */
+  if(lcp_output != nullptr) { *lcp_output = LCPArray(merged_size, parameters.lcp_branching); }
+  bit_vector sampled_positions(merged_size, 0);
+  std::vector<node_type> sample_buffer;
+  std::vector<size_type> sample_ends;
+  CounterArray occurrences(merged_size, 4), redundant((merged_size > 0 ? merged_size - 1 : 0), 4);
+  sdsl::int_vector<0> prev_occ(unique_from_nodes, 0, bit_length(merged_size));
+  OccurrenceStack stack;
+  size_type sample_bits = 1;
+  for(size_type i = 0, path_node[2] = { 0, 0 }; i < merged_size; i++)
+  {
+    bool sample = (origins[i] == 3);
+    results.clear();
+    for(size_type origin = 0; origin < 2; origin++)
+    {
+      if(!(origins[i] & (1 << origin))) { continue; }
+      const RefinedIndex& index = *(refined[origin]);
+      size_type original = index.original[path_node[origin]];
+      indexes[origin]->locate(original, results, true, false);
+      if(!sample)
+      {
+        sample = indexes[origin]->sampled(original) || origins[mapping[origin][index.LF(path_node[origin])]] == 3;
+      }
+      path_node[origin]++;
+    }
+    removeDuplicates(results, false);
+    if(sample)
+    {
+      sampled_positions[i] = 1;
+      for(node_type node : results) { sample_bits = std::max(sample_bits, bit_length(node)); }
+      sample_buffer.insert(sample_buffer.end(), results.begin(), results.end());
+      sample_ends.push_back(sample_buffer.size() - 1);
+    }
+    occurrences.increment(i, results.size() - 1);
+
+    // The counting support is built as in countOccurrences().
+    if(lcp_output != nullptr) { lcp_output->setValue(i, path_lcp[i]); }
+    stack.update(i, path_lcp[i]);
+    for(node_type node : results)
+    {
+      size_type temp = from_rank(node);
+      if(prev_occ[temp] > 0) { redundant.increment(stack.redundant(prev_occ[temp])); }
+      prev_occ[temp] = i + 1;
+    }
+  }
+  if(lcp_output != nullptr) { lcp_output->finish(); }
+  sdsl::util::clear(prev_occ); sdsl::util::clear(mapping[0]); sdsl::util::clear(mapping[1]);
+
+  size_type occ_count = occurrences.sum() + occurrences.size(), red_count = redundant.sum();
+  this->extra_pointers = SadaSparse(occurrences);
+  this->redundant_pointers = SadaCount(redundant);
+  sdsl::util::clear(occurrences); sdsl::util::clear(redundant);
+
+  this->sampled_paths = sampled_positions; sdsl::util::clear(sampled_positions);
+  this->samples = bit_vector(sample_buffer.size(), 0);
+  for(size_type pos : sample_ends) { this->samples[pos] = 1; }
+  this->stored_samples = sdsl::int_vector<0>(sample_buffer.size(), 0, sample_bits);
+  for(size_type i = 0; i < sample_buffer.size(); i++) { this->stored_samples[i] = sample_buffer[i]; }
+  sdsl::util::clear(sample_buffer); sdsl::util::clear(sample_ends);
+  this->initSupport();
+
+  if(Verbosity::level >= Verbosity::EXTENDED)
+  {
+    double stop = readTimer();
+    std::cerr << "GCSA::GCSA(): Merging: " << (stop - start) << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+  }
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "GCSA::GCSA(): " << this->size() << " paths, " << this->edgeCount() << " edges" << std::endl;
+    std::cerr << "GCSA::GCSA(): " << occ_count << " pointers (" << red_count << " redundant)" << std::endl;
+    std::cerr << "GCSA::GCSA(): " << this->sampleCount() << " samples at "
+              << this->sampledPositions() << " positions" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+
 void
 GCSA::initSupport()
 {
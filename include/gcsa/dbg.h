@@ -39,7 +39,8 @@ namespace gcsa
 /*
   This is a specialization of GCSA for de Bruijn graphs. Because the graph is
   reverse deterministic, we can use indicator bitvectors for encoding the BWT.
-  This simplifies LF() to two rank() operations.
+  This simplifies LF() to two rank() operations. As in GCSA, the fast comp values
+  use plain bitvectors, while the others use sparse bitvectors.
 */
 
 class DeBruijnGraph
@@ -48,6 +49,7 @@ public:
   typedef gcsa::size_type       size_type;
   typedef sdsl::bit_vector      bit_vector;
   typedef sdsl::bit_vector_il<> fast_bit_vector;
+  typedef sdsl::sd_vector<>     sparse_bit_vector;
 
 //------------------------------------------------------------------------------
 
@@ -81,7 +83,10 @@ public:
 
   inline size_type LF(size_type node, comp_type comp) const
   {
-    return this->node_rank(this->bwt_rank(comp * this->size() + node));
+    size_type edge = this->alpha.C[comp];
+    if(comp > 0 && comp <= this->alpha.fast_chars) { edge += this->fast_rank[comp](node); }
+    else { edge += this->sparse_rank[comp](node); }
+    return this->node_rank(edge);
   }
 
   inline range_type LF(range_type range, comp_type comp) const
@@ -134,13 +139,16 @@ public:
 
   Alphabet                     alpha;
 
-  // If node i has predecessor comp, bit comp * size + i is set.
-  fast_bit_vector              bwt;
-  fast_bit_vector::rank_1_type bwt_rank;
+  // If node i has predecessor comp, bit i of fast_bwt[comp] or sparse_bwt[comp] is set.
+  // The vectors for the other encoding are empty.
+  std::vector<fast_bit_vector>                fast_bwt;
+  std::vector<fast_bit_vector::rank_1_type>   fast_rank;
+  std::vector<sparse_bit_vector>              sparse_bwt;
+  std::vector<sparse_bit_vector::rank_1_type> sparse_rank;
 
   // The last outgoing edge from each path is marked with an 1-bit.
-  fast_bit_vector              nodes;
-  fast_bit_vector::rank_1_type node_rank;
+  fast_bit_vector                             nodes;
+  fast_bit_vector::rank_1_type                node_rank;
 
 //------------------------------------------------------------------------------
 
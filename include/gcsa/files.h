@@ -36,12 +36,24 @@ namespace gcsa
 
 //------------------------------------------------------------------------------
 
+/*
+  Binary graph files consist of sections, each of them containing a header and an array
+  of KMers. Flag WIDE_KEYS marks sections with 128-bit keys.
+*/
+
 struct GraphFileHeader
 {
   size_type flags;
   size_type kmer_count;
   size_type kmer_length;
 
+  const static size_type WIDE_KEYS = 0x1;
+#ifdef GCSA_WIDE_KEYS
+  const static size_type DEFAULT_FLAGS = WIDE_KEYS;
+#else
+  const static size_type DEFAULT_FLAGS = 0;
+#endif
+
   GraphFileHeader();
   GraphFileHeader(size_type kmers, size_type length);
   explicit GraphFileHeader(std::istream& in);
@@ -50,6 +62,48 @@ struct GraphFileHeader
   size_type serialize(std::ostream& out);
 };
 
+/*
+  A read-only memory mapping of a file. The mapping is private, and an empty file has
+  no mapping. release() drops the pages from the resident set of the process; they will
+  be read again from the page cache if needed.
+*/
+
+struct MappedFile
+{
+  const char* data;
+  size_type   bytes;
+
+  MappedFile();
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  void open(const std::string& filename);
+  void close();
+
+  void sequential() const;  // Advise the kernel to read ahead.
+  void release() const;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator= (const MappedFile&) = delete;
+};
+
+/*
+  The KMer array of a section in a memory-mapped binary graph file.
+*/
+
+struct KMerSpan
+{
+  const KMer* data;
+  size_type   length;
+
+  inline size_type size() const { return this->length; }
+  inline const KMer* begin() const { return this->data; }
+  inline const KMer* end() const { return this->data + this->length; }
+  inline const KMer& operator[] (size_type i) const { return this->data[i]; }
+};
+
+//------------------------------------------------------------------------------
+
 /*
   These functions read the input until eof. They do not close the input stream. The
   return value is kmer length.
@@ -57,6 +111,14 @@ struct GraphFileHeader
 size_type readBinary(std::istream& in, std::vector<KMer>& kmers, bool append = false);
 size_type readText(std::istream& in, std::vector<KMer>& kmers, const Alphabet& alpha, bool append = false);
 
+/*
+  Parallel parser for text graph files. The file is memory-mapped and parsed in chunks
+  using multiple threads. countText() returns (kmer length, kmer count) without parsing
+  the kmers.
+*/
+size_type readText(const std::string& filename, std::vector<KMer>& kmers, const Alphabet& alpha, bool append = false);
+range_type countText(const std::string& filename);
+
 // FIXME Later: writeText()
 void writeBinary(std::ostream& out, std::vector<KMer>& kmers, size_type kmer_length);
 void writeKMers(const std::string& base_name, std::vector<KMer>& kmers, size_type kmer_length);
@@ -64,7 +126,9 @@ void writeKMers(const std::string& base_name, std::vector<KMer>& kmers, size_typ
 //------------------------------------------------------------------------------
 
 /*
-  An input graph is just a set of input files.
+  An input graph is just a set of input files. Binary input files are memory-mapped for
+  the lifetime of the graph, and the KMer arrays of their sections are available as
+  spans without copying.
 */
 
 struct InputGraph
@@ -73,6 +137,9 @@ struct InputGraph
   std::string              lcp_name; // Used to pass the LCP array from GCSA construction.
   std::vector<size_type>   sizes;
 
+  std::vector<MappedFile*>            mapped;    // Binary format only.
+  std::vector<std::vector<KMerSpan>>  sections;  // Binary format only.
+
   Alphabet                 alpha;
 
   bool binary;
@@ -105,6 +172,13 @@ struct InputGraph
   void readKeys(std::vector<key_type>& keys) const;
   void readFrom(std::vector<node_type>& from_nodes) const;
 
+  /*
+    The sections of a binary input file. The KMers are as stored in the file, without
+    the source/sink nodes marked sorted. Call release() after using them.
+  */
+  inline const std::vector<KMerSpan>& spans(size_type file) const { return this->sections[file]; }
+  void release(size_type file) const;
+
   InputGraph(const InputGraph&) = delete;
   InputGraph& operator= (const InputGraph&) = delete;
 
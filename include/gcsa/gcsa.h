@@ -36,6 +36,8 @@ namespace gcsa
 
 //------------------------------------------------------------------------------
 
+class LCPArray;
+
 class GCSA
 {
 public:
@@ -68,8 +70,34 @@ public:
     using a given number of doubling steps. The construction is mostly disk-based. There
     are at most two graphs on disk at once, and the size of each graph is bounded by the
     size limit.
+
+    If lcp_output is not null, the LCP array is built during the final pass and stored
+    there. Otherwise the LCP file is passed to LCPArray construction through the graph.
+  */
+  GCSA(InputGraph& graph, const ConstructionParameters& parameters = ConstructionParameters(),
+       LCPArray* lcp_output = nullptr);
+
+  /*
+    Merges two indexes built from graphs with disjoint node ids, producing the index of
+    the union graph without rebuilding it from the kmers. The path nodes of the inputs are
+    interleaved by backward searching their first and last strings, and a path node is
+    merged with a path node of the other index if they have the same strings up to
+    order(). If the label of a path node is not unique in the union, the path node is
+    split by extending its label by one character, and the interleaving is repeated.
+
+    The result answers queries in the same way as an index of the union graph. The path
+    nodes, edges, and samples may still differ from an index built from both graphs, as
+    construction only merges path nodes with the same from node if they come from the same
+    input file, and it expects the graphs to share the source and sink nodes. If lcp_output
+    is not null, the LCP array of the result is computed during the merge and stored there.
+
+    Merging fails if the labels are still not unique after order() rounds of refinement or
+    if the refined inputs exceed parameters.memory_limit. This happens when the graphs share
+    long paths, e.g. when an index is merged with a copy of itself with shifted node ids.
   */
-  GCSA(InputGraph& graph, const ConstructionParameters& parameters = ConstructionParameters());
+  GCSA(const GCSA& first, const GCSA& second,
+       const ConstructionParameters& parameters = ConstructionParameters(),
+       LCPArray* lcp_output = nullptr);
 
 //------------------------------------------------------------------------------
 
@@ -25,9 +25,11 @@
 #ifndef _GCSA_INTERNAL_H
 #define _GCSA_INTERNAL_H
 
+#include <cstring>
 #include <map>
+#include <type_traits>
 
-// C++ threads for DiskIO, ReadBuffer.
+// C++ threads for DiskIO, ReadBuffer, WriteBuffer.
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
@@ -44,32 +46,350 @@ namespace gcsa
 
 //------------------------------------------------------------------------------
 
+/*
+  Positional I/O for temporary files using file descriptors. The transfers use the backend
+  selected in DiskIO. The io_uring backend splits large transfers into up to IO_DEPTH parts
+  that are in flight at the same time, while the POSIX backend uses pread() / pwrite() in
+  the calling thread. Because each ReadBuffer and WriteBuffer has its own I/O thread, the
+  POSIX backend still keeps one request in flight for each open file.
+
+  With direct I/O, the file is opened with O_DIRECT and the transfers go through an aligned
+  buffer. A file being written is padded to a multiple of ALIGNMENT and truncated to its
+  true size when closed. If O_DIRECT is not supported, the pages of the file are dropped
+  from the page cache after each transfer.
+
+  SDSL ram files are accessed using sdsl::isfstream and sdsl::osfstream.
+*/
+
+struct IORing;
+
+struct RawFile
+{
+  int             fd;
+  bool            writing, direct;
+  size_type       bytes;    // File size.
+  std::string     name;
+
+  // Direct I/O. When writing, buffer[0, buffered - 1] contains the bytes after the last
+  // aligned position that has been written to the file.
+  byte_type*      buffer;
+  size_type       buffered;
+
+  IORing*         ring;
+
+  // SDSL ram files.
+  sdsl::isfstream input;
+  sdsl::osfstream output;
+
+  const static size_type ALIGNMENT     = 4096;
+  const static size_type BUFFER_SIZE   = 4 * MEGABYTE;
+  const static size_type IO_DEPTH      = 8;
+  const static size_type MIN_PART_SIZE = 128 * KILOBYTE;
+  const static size_type MAX_PART_SIZE = 256 * MEGABYTE;
+
+  RawFile();
+  ~RawFile();
+
+  // Returns false if the file cannot be opened.
+  bool open(const std::string& filename, bool write);
+  void close();
+
+  inline bool is_open() { return (this->fd >= 0 || this->input.is_open() || this->output.is_open()); }
+  inline size_type size() const { return this->bytes; }
+
+  void read(size_type offset, byte_type* data, size_type n);
+  void write(const byte_type* data, size_type n);  // Append to the file.
+
+  // Internal functions.
+  size_type transfer(size_type offset, byte_type* data, size_type n, bool write); // Stops at EOF.
+  void dropCache(size_type offset, size_type n, bool write);
+
+  RawFile(const RawFile&) = delete;
+  RawFile& operator= (const RawFile&) = delete;
+};
+
+//------------------------------------------------------------------------------
+
 /*
   Utility methods for disk I/O and read/write volume measurement. These methods don't use
   mutexes / critical sections for performance reasons.
+
+  The physical volumes are the bytes actually transferred, while the logical volumes are
+  the uncompressed sizes of the data.
+
+  The backend and direct I/O settings apply to RawFiles opened after the change.
 */
 
 struct DiskIO
 {
   static std::atomic<size_type> read_volume, write_volume;
+  static std::atomic<size_type> logical_read_volume, logical_write_volume;
+
+  const static size_type POSIX = 0;  // pread() / pwrite()
+  const static size_type URING = 1;  // io_uring; requires GCSA_IO_URING
+
+  static size_type backend;
+  static bool      direct;  // Bypass the page cache.
+
+  // Falls back to POSIX if the backend is not available.
+  static void setBackend(size_type new_backend);
+  static std::string backendName();
 
   template<class Element>
   inline static void read(std::istream& in, Element* data, size_type n = 1)
   {
-    read_volume += n * sizeof(Element);
+    read_volume += n * sizeof(Element); logical_read_volume += n * sizeof(Element);
     in.read((char*)data, n * sizeof(Element));
   }
 
   template<class Element>
   inline static void write(std::ostream& out, const Element* data, size_type n = 1)
   {
-    write_volume += n * sizeof(Element);
+    write_volume += n * sizeof(Element); logical_write_volume += n * sizeof(Element);
     out.write((const char*)data, n * sizeof(Element));
   }
+
+  template<class Element>
+  inline static void read(RawFile& in, size_type offset, Element* data, size_type n = 1)
+  {
+    read_volume += n * sizeof(Element); logical_read_volume += n * sizeof(Element);
+    in.read(offset, (byte_type*)data, n * sizeof(Element));
+  }
+
+  template<class Element>
+  inline static void write(RawFile& out, const Element* data, size_type n = 1)
+  {
+    write_volume += n * sizeof(Element); logical_write_volume += n * sizeof(Element);
+    out.write((const byte_type*)data, n * sizeof(Element));
+  }
+
+  // Account for n bytes used directly from a memory-mapped file.
+  inline static void readMapped(size_type n)
+  {
+    read_volume += n; logical_read_volume += n;
+  }
+
+  // Read/write n bytes of compressed data corresponding to logical_bytes bytes of data.
+  inline static void readCompressed(RawFile& in, size_type offset, byte_type* data, size_type n, size_type logical_bytes)
+  {
+    read_volume += n; logical_read_volume += logical_bytes;
+    in.read(offset, data, n);
+  }
+
+  inline static void writeCompressed(RawFile& out, const byte_type* data, size_type n, size_type logical_bytes)
+  {
+    write_volume += n; logical_write_volume += logical_bytes;
+    out.write(data, n);
+  }
+};
+
+//------------------------------------------------------------------------------
+
+/*
+  Block compression for temporary files. Each block of BLOCK_SIZE elements (the last block
+  may be shorter) is encoded separately. An element is treated as an array of words, and
+  each word is stored as the zigzag-encoded difference to the same word in the previous
+  element using a variable-length byte code.
+
+  A compressed file consists of the blocks followed by the byte offsets of the blocks, the
+  total size of the blocks in bytes, the number of elements, and the number of blocks.
+*/
+
+struct BlockCodec
+{
+  const static size_type BLOCK_SIZE = 4096;  // Elements.
+
+  template<class Element>
+  struct Words
+  {
+    typedef typename std::conditional<sizeof(Element) % 8 == 0, std::uint64_t,
+            typename std::conditional<sizeof(Element) % 4 == 0, std::uint32_t,
+            typename std::conditional<sizeof(Element) % 2 == 0, std::uint16_t,
+                                      std::uint8_t>::type>::type>::type word_type;
+
+    const static size_type WORD_BITS = 8 * sizeof(word_type);
+    const static size_type WORDS = sizeof(Element) / sizeof(word_type);
+  };
+
+  // Appends the encoding of data[0, n - 1] to the code.
+  template<class Element>
+  static void encode(const Element* data, size_type n, std::vector<byte_type>& code)
+  {
+    typedef typename Words<Element>::word_type word_type;
+    const size_type words = Words<Element>::WORDS, bits = Words<Element>::WORD_BITS;
+
+    word_type prev[words], curr[words];
+    for(size_type j = 0; j < words; j++) { prev[j] = 0; }
+    for(size_type i = 0; i < n; i++)
+    {
+      std::memcpy(curr, data + i, sizeof(Element));
+      for(size_type j = 0; j < words; j++)
+      {
+        word_type diff = curr[j] - prev[j];
+        word_type value = (word_type)((diff << 1) ^ (0 - (diff >> (bits - 1))));  // Zigzag.
+        while(value >= 0x80) { code.push_back((value & 0x7F) | 0x80); value >>= 7; }
+        code.push_back(value);
+        prev[j] = curr[j];
+      }
+    }
+  }
+
+  // Decodes n elements from the code and returns a pointer to the end of the encoding.
+  template<class Element>
+  static const byte_type* decode(const byte_type* code, size_type n, Element* data)
+  {
+    typedef typename Words<Element>::word_type word_type;
+    const size_type words = Words<Element>::WORDS;
+
+    word_type curr[words];
+    for(size_type j = 0; j < words; j++) { curr[j] = 0; }
+    for(size_type i = 0; i < n; i++)
+    {
+      for(size_type j = 0; j < words; j++)
+      {
+        word_type value = 0;
+        for(size_type shift = 0; ; shift += 7, code++)
+        {
+          value |= (word_type)(*code & 0x7F) << shift;
+          if(*code < 0x80) { code++; break; }
+        }
+        curr[j] += (word_type)((value >> 1) ^ (0 - (value & 1)));  // Zigzag.
+      }
+      std::memcpy((void*)(data + i), curr, sizeof(Element));
+    }
+    return code;
+  }
 };
 
 //------------------------------------------------------------------------------
 
+/*
+  Random access to a file of Elements that may be block-compressed. Reading a range of
+  elements from a compressed file decodes the blocks overlapping the range. The most
+  recently decoded block is cached.
+*/
+
+template<class Element>
+struct ElementFile
+{
+  RawFile                file;
+  bool                   compressed;
+  size_type              elements;
+
+  // Compressed files.
+  std::vector<size_type> blocks;  // Byte offsets of the blocks and the end of the last block.
+  std::vector<byte_type> code;
+  std::vector<Element>   block;
+  size_type              cached_block;
+
+  ElementFile() : compressed(false), elements(0), cached_block(0) { }
+  ~ElementFile() { this->close(); }
+
+  void open(const std::string& filename, bool _compressed);
+  void close();
+
+  inline size_type size() const { return this->elements; }
+  inline bool is_open() { return this->file.is_open(); }
+
+  // Reads data[0, n - 1] from elements [offset, offset + n - 1]. If parallel is set, full
+  // blocks are decoded in parallel.
+  void read(size_type offset, Element* data, size_type n, bool parallel = false);
+
+  ElementFile(const ElementFile&) = delete;
+  ElementFile& operator= (const ElementFile&) = delete;
+};
+
+template<class Element>
+void
+ElementFile<Element>::open(const std::string& filename, bool _compressed)
+{
+  if(!(this->file.open(filename, false)))
+  {
+    std::cerr << "ElementFile::open(): Cannot open input file " << filename << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  this->compressed = _compressed;
+
+  if(!(this->compressed))
+  {
+    this->elements = this->file.size() / sizeof(Element);
+    return;
+  }
+
+  // Read the footer.
+  size_type bytes = this->file.size(), block_count = 0;
+  if(bytes < 2 * sizeof(size_type))
+  {
+    std::cerr << "ElementFile::open(): Invalid compressed file " << filename << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  DiskIO::read(this->file, bytes - 2 * sizeof(size_type), &(this->elements));
+  DiskIO::read(this->file, bytes - sizeof(size_type), &block_count);
+  this->blocks.resize(block_count + 1);
+  DiskIO::read(this->file, bytes - (block_count + 3) * sizeof(size_type), this->blocks.data(), this->blocks.size());
+  this->cached_block = block_count;
+}
+
+template<class Element>
+void
+ElementFile<Element>::close()
+{
+  this->file.close();
+  this->elements = 0;
+  sdsl::util::clear(this->blocks);
+  sdsl::util::clear(this->code);
+  sdsl::util::clear(this->block);
+  this->cached_block = 0;
+}
+
+template<class Element>
+void
+ElementFile<Element>::read(size_type offset, Element* data, size_type n, bool parallel)
+{
+  if(!(this->compressed))
+  {
+    DiskIO::read(this->file, offset * sizeof(Element), data, n);
+    return;
+  }
+
+  const size_type block_size = BlockCodec::BLOCK_SIZE;  // avoid direct use of static const
+  while(n > 0)
+  {
+    size_type block_id = offset / block_size, block_start = block_id * block_size;
+    if(parallel && offset == block_start && n >= 2 * block_size)
+    {
+      size_type limit = block_id + n / block_size;
+      size_type code_start = this->blocks[block_id];
+      this->code.resize(this->blocks[limit] - code_start);
+      size_type count = (limit - block_id) * block_size;
+      DiskIO::readCompressed(this->file, code_start, this->code.data(), this->code.size(), count * sizeof(Element));
+      #pragma omp parallel for schedule(dynamic, 1)
+      for(size_type i = block_id; i < limit; i++)
+      {
+        BlockCodec::decode(this->code.data() + (this->blocks[i] - code_start), block_size,
+          data + (i - block_id) * block_size);
+      }
+      offset += count; data += count; n -= count;
+      continue;
+    }
+    if(block_id != this->cached_block)
+    {
+      size_type block_bytes = this->blocks[block_id + 1] - this->blocks[block_id];
+      this->block.resize(std::min(block_size, this->size() - block_start));
+      this->code.resize(block_bytes);
+      DiskIO::readCompressed(this->file, this->blocks[block_id], this->code.data(), block_bytes,
+        this->block.size() * sizeof(Element));
+      BlockCodec::decode(this->code.data(), this->block.size(), this->block.data());
+      this->cached_block = block_id;
+    }
+    size_type count = std::min(n, block_start + this->block.size() - offset);
+    std::copy(this->block.begin() + (offset - block_start), this->block.begin() + (offset - block_start + count), data);
+    offset += count; data += count; n -= count;
+  }
+}
+
+//------------------------------------------------------------------------------
+
 /*
   Generic in-memory construction from int_vector_buffer<8> and size. Not very space-efficient, as it
   duplicates the data.
@@ -142,52 +462,73 @@ struct ValueIndex
 //------------------------------------------------------------------------------
 
 /*
-  A simple counter array that uses an int_vector<0> for most counters and stores large values
-  in an std::map.
+  A counter array that packs narrow counters into 64-bit words and stores large values in a
+  flat hash table with linear probing. A counter equal to large_value has its actual value
+  in the table. The width is rounded up to a power of two, so that no counter crosses a
+  word boundary.
+
+  Function increment() is for a single thread. Function atomicIncrement() is safe to call
+  concurrently with itself. It updates the word with compare-and-swap and only locks the
+  mutex for the large values.
 */
 struct CounterArray
 {
-  sdsl::int_vector<0>            data;
-  std::map<size_type, size_type> large_values;
-  size_type                      width, large_value;
-  size_type                      total;
+  std::vector<std::uint64_t> data;
+  size_type                  elements;
+  size_type                  width, width_bits;     // width = 2^width_bits
+  size_type                  word_bits, word_mask;  // 2^word_bits counters per word
+  size_type                  large_value;           // Also the mask for a counter.
+  size_type                  total;
+
+  // Hash table of (position, value) pairs with 2^table_bits cells.
+  std::vector<range_type>    large_values;
+  size_type                  large_count, table_bits;
+  std::mutex                 mtx;
+
+  const static size_type EMPTY_CELL = ~(size_type)0;
+  const static size_type MIN_TABLE_BITS = 4;
 
   CounterArray();
   CounterArray(size_type n, size_type data_width);
 
-  inline size_type size() const { return this->data.size(); }
+  inline size_type size() const { return this->elements; }
   inline size_type sum() const { return this->total; }
 
   inline size_type operator[] (size_type i) const
   {
-    return (this->data[i] == this->large_value ? this->large_values.at(i) : this->data[i]);
+    size_type value = (this->data[i >> this->word_bits] >> this->offset(i)) & this->large_value;
+    return (value == this->large_value ? this->findLarge(i) : value);
   }
 
-  inline void increment(size_type i)
-  {
-    if(this->data[i] == this->large_value) { this->large_values[i]++; }
-    else
-    {
-      this->data[i]++;
-      if(this->data[i] == this->large_value) { this->large_values[i] = this->large_value; }
-    }
-    this->total++;
-  }
+  inline void increment(size_type i) { this->increment(i, 1); }
 
   inline void increment(size_type i, size_type val)
   {
-    if(this->data[i] == this->large_value) { this->large_values[i] += val; }
-    else if(this->data[i] + val >= this->large_value)
-    {
-      this->large_values[i] = this->data[i] + val;
-      this->data[i] = this->large_value;
-    }
-    else { this->data[i] += val; }
+    std::uint64_t& word = this->data[i >> this->word_bits];
+    size_type shift = this->offset(i);
+    size_type value = (word >> shift) & this->large_value;
+    if(value + val < this->large_value) { word += val << shift; }
+    else { this->incrementLarge(i, value, val); }
     this->total += val;
   }
 
+  void atomicIncrement(size_type i, size_type val = 1);
+
   void clear();
   void swap(CounterArray& another);
+
+  // Internal functions.
+  inline size_type offset(size_type i) const { return (i & this->word_mask) << this->width_bits; }
+  inline size_type hash(size_type i) const
+  {
+    return (i * 0x9E3779B97F4A7C15UL) >> (WORD_BITS - this->table_bits);
+  }
+  size_type findLarge(size_type i) const;
+  size_type& largeValue(size_type i);  // Inserts a zero if not found.
+  void incrementLarge(size_type i, size_type value, size_type val);
+
+  CounterArray(const CounterArray&) = delete;
+  CounterArray& operator= (const CounterArray&) = delete;
 };
 
 //------------------------------------------------------------------------------
@@ -249,45 +590,58 @@ PriorityQueue<Element>::heapify()
 //------------------------------------------------------------------------------
 
 /*
-  A buffer that keeps Elements [offset, offset + size - 1] in memory. It supports
-  seeking to a new position and adding Elements to the end.
+  A buffer that keeps Elements [offset, limit - 1] in memory. It supports seeking to
+  a new position and adding Elements to the end. The buffer is a ring with a power of
+  two capacity, and Element i is stored at data[i & mask]. Seeking forward is O(1), and
+  the ring grows when it becomes full.
 */
 
 template<class Element>
 struct BufferWindow
 {
-  std::deque<Element> data;
-  size_type           offset;
+  std::vector<Element> data;
+  size_type            offset, limit, mask;
 
   BufferWindow();
   ~BufferWindow();
 
-  inline size_type size() const { return this->data.size(); }
+  inline size_type size() const { return this->limit - this->offset; }
+  inline size_type capacity() const { return this->data.size(); }
   inline bool buffered(size_type i) const
   {
-    return (i >= this->offset && i < this->offset + this->size());
+    return (i - this->offset < this->size());  // i < offset wraps around.
   }
 
   /*
-    Beware: Calling seek() may invalidate the reference. The same may also happen when
-    calling operator[] with a non-buffered position.
+    Beware: Calling push_back() or reserve() may invalidate the reference. The same may
+    also happen when calling ReadBuffer::operator[] with a non-buffered position.
   */
-  inline Element& operator[] (size_type i) { return this->data[i - this->offset]; }
-  inline const Element& operator[] (size_type i) const { return this->data[i - this->offset]; }
+  inline Element& operator[] (size_type i) { return this->data[i & this->mask]; }
+  inline const Element& operator[] (size_type i) const { return this->data[i & this->mask]; }
 
   void clear();
-  void seek(size_type i);
   void swap(BufferWindow<Element>& another);
 
-  inline void push_back(const Element& element) { this->data.push_back(element); }
+  // Moves the start of the buffer to i. If i is not buffered, the buffer becomes empty.
+  inline void seek(size_type i)
+  {
+    if(!(this->buffered(i))) { this->limit = i; }
+    this->offset = i;
+  }
+
+  // Ensures that the buffer can hold n Elements.
+  void reserve(size_type n);
 
-  template<class Iterator>
-  void insert(Iterator from, Iterator to) { this->data.insert(this->data.end(), from, to); }
+  inline void push_back(const Element& element)
+  {
+    if(this->size() >= this->capacity()) { this->reserve(this->size() + 1); }
+    this->data[this->limit & this->mask] = element; this->limit++;
+  }
 };
 
 template<class Element>
 BufferWindow<Element>::BufferWindow() :
-  offset(0)
+  offset(0), limit(0), mask(0)
 {
 }
 
@@ -301,30 +655,37 @@ void
 BufferWindow<Element>::clear()
 {
   sdsl::util::clear(this->data);
-  this->offset = 0;
+  this->offset = 0; this->limit = 0; this->mask = 0;
 }
 
 template<class Element>
 void
-BufferWindow<Element>::seek(size_type i)
+BufferWindow<Element>::swap(BufferWindow<Element>& another)
 {
-  if(this->buffered(i))
+  if(this != &another)
   {
-    for(size_type j = this->offset; j < i; j++) { this->data.pop_front(); }
+    this->data.swap(another.data);
+    std::swap(this->offset, another.offset);
+    std::swap(this->limit, another.limit);
+    std::swap(this->mask, another.mask);
   }
-  else { this->data.clear(); }
-  this->offset = i;
 }
 
 template<class Element>
 void
-BufferWindow<Element>::swap(BufferWindow<Element>& another)
+BufferWindow<Element>::reserve(size_type n)
 {
-  if(this != &another)
+  if(n <= this->capacity()) { return; }
+
+  size_type new_capacity = std::max(this->capacity(), (size_type)1);
+  while(new_capacity < n) { new_capacity *= 2; }
+  std::vector<Element> temp(new_capacity);
+  for(size_type i = this->offset; i < this->limit; i++)
   {
-    this->data.swap(another.data);
-    std::swap(this->offset, another.offset);
+    temp[i & (new_capacity - 1)] = std::move(this->data[i & this->mask]);
   }
+  this->data.swap(temp);
+  this->mask = new_capacity - 1;
 }
 
 //------------------------------------------------------------------------------
@@ -334,8 +695,11 @@ BufferWindow<Element>::swap(BufferWindow<Element>& another)
   of the buffer to the new position. Accesses before the current start call seek(), while
   accesses after it expand the buffer until the requested position is contained in it.
 
-  A separate thread is spawned for reading in the background. The reader thread stops
-  when it reaches the end of the file.
+  A separate thread is spawned for reading in the background. The reader thread decodes
+  the next chunk directly into the free part of the ring buffer, and the main thread
+  makes the chunk visible when the buffer falls below half of its capacity. The reader
+  thread stops when it reaches the end of the file. Block-compressed files are decoded by
+  the reader.
 */
 
 template<class Element>
@@ -345,25 +709,30 @@ struct ReadBuffer
   BufferWindow<Element>   buffer;
 
   // File
-  std::ifstream           file;
+  ElementFile<Element>    file;
   size_type               elements, file_offset;
+  size_type               buffer_size, chunk_size;
 
-  // Reader thread.
-  std::vector<Element>    read_buffer;
+  // Reader thread. Elements [buffer.limit, buffer.limit + pending - 1] have been read
+  // but are not visible yet.
+  size_type               pending;
+  bool                    reading;
+  std::atomic<size_type>  start;  // buffer.offset for the reader thread.
   std::mutex              mtx;
-  std::condition_variable empty;  // Is read_buffer empty?
+  std::condition_variable empty;  // Is there nothing pending?
+  std::condition_variable ready;  // Has the reader finished reading?
   std::thread             reader_thread;
 
-  // Read this many elements at once.
+  // Read this many elements at once by default. The ring buffer holds at most 2x
+  // elements, and the reader reads chunks of a quarter of the ring.
   const static size_type READ_BUFFER_SIZE = MEGABYTE;
 
-  // Refill the buffer if its size falls below this threshold.
-  const static size_type MINIMUM_SIZE = READ_BUFFER_SIZE / 2;
-
   ReadBuffer();
   ~ReadBuffer();
 
-  void open(const std::string& filename);
+  // Start reading from the given offset, reading buffer_size elements at once.
+  void open(const std::string& filename, size_type offset = 0, size_type _buffer_size = READ_BUFFER_SIZE,
+            bool compressed = false);
   void close();
 
   inline size_type size() const { return this->elements; }
@@ -381,20 +750,23 @@ struct ReadBuffer
   void seek(size_type i); // Set offset to i.
 
   // Internal functions.
-  bool fill();            // Fill the read buffer.
+  bool fill();            // Read the next chunk in the reader thread.
   void read(size_type i); // Read i into buffer, possibly seeking backwards.
-  void forceRead();       // Add elements into buffer, assuming that the current thread holds the mutex.
+  void forceRead(std::unique_lock<std::mutex>& lock); // Add elements into buffer; the lock must be held.
+  void readChunk(size_type from, size_type n);        // Read elements [from, from + n - 1] into the ring.
+  bool canRead() const;   // Can the reader thread read the next chunk? The lock must be held.
 
   ReadBuffer(const ReadBuffer&) = delete;
   ReadBuffer& operator= (const ReadBuffer&) = delete;
 };
 
 template<class Element>
-ReadBuffer<Element>::ReadBuffer()
+ReadBuffer<Element>::ReadBuffer() :
+  start(0)
 {
   this->elements = 0; this->file_offset = 0;
-  size_type buffer_size = READ_BUFFER_SIZE;  // avoid direct use
-  this->read_buffer.reserve(buffer_size);
+  this->buffer_size = READ_BUFFER_SIZE; this->chunk_size = READ_BUFFER_SIZE;
+  this->pending = 0; this->reading = false;
 }
 
 template<class Element>
@@ -412,7 +784,7 @@ readerThread(ReadBuffer<Element>* buffer)
 
 template<class Element>
 void
-ReadBuffer<Element>::open(const std::string& filename)
+ReadBuffer<Element>::open(const std::string& filename, size_type offset, size_type _buffer_size, bool compressed)
 {
   if(this->file.is_open())
   {
@@ -420,14 +792,24 @@ ReadBuffer<Element>::open(const std::string& filename)
     std::exit(EXIT_FAILURE);
   }
 
-  this->file.open(filename.c_str(), std::ios_base::binary);
-  if(!(this->file))
+  this->file.open(filename, compressed);
+  this->elements = this->file.size();
+  this->file_offset = 0;
+  this->buffer_size = std::max(_buffer_size, (size_type)1);
+
+  // The ring is the largest power of two <= 2 * buffer_size.
+  size_type capacity = 1;
+  while(2 * capacity <= 2 * this->buffer_size) { capacity *= 2; }
+  this->chunk_size = std::max(capacity / 4, (size_type)1);
+  this->buffer.reserve(capacity);
+
+  this->pending = 0; this->reading = false;
+  if(offset > 0 && offset < this->size())
   {
-    std::cerr << "ReadBuffer::open(): Cannot open input file " << filename << std::endl;
-    std::exit(EXIT_FAILURE);
+    this->file_offset = offset;
+    this->buffer.seek(offset);
   }
-  this->elements = fileSize(this->file) / sizeof(Element);
-  this->file_offset = 0;
+  this->start = this->buffer.offset;
 
   this->reader_thread = std::thread(readerThread<Element>, this);
 }
@@ -437,17 +819,20 @@ void
 ReadBuffer<Element>::close()
 {
   // We need to stop the reader thread.
-  this->mtx.lock();
-  this->file_offset = this->size();
-  this->read_buffer.clear();
-  this->empty.notify_one();
-  this->mtx.unlock();
+  {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    this->ready.wait(lock, [this]() { return !(this->reading); });
+    this->file_offset = this->size();
+    this->pending = 0;
+    this->empty.notify_one();
+  }
   if(this->reader_thread.joinable()) { this->reader_thread.join(); }
 
   this->file.close();
-  this->elements = 0;
+  this->elements = 0; this->file_offset = 0;
 
   sdsl::util::clear(this->buffer);
+  this->start = 0;
 }
 
 template<class Element>
@@ -457,39 +842,63 @@ ReadBuffer<Element>::seek(size_type i)
   if(i >= this->size()) { return; }
 
   // Move the buffer to the new position.
-  // Clear the buffer and seek in the file if file offset is wrong.
-  this->buffer.seek(i);
-  if(!(this->buffer.buffered(i)))
+  // Clear the buffer and seek in the file if the pending elements do not start at i.
+  if(this->buffer.buffered(i))
+  {
+    this->buffer.seek(i);
+    this->start.store(i, std::memory_order_release);
+  }
+  else
   {
     std::unique_lock<std::mutex> lock(this->mtx);
-    if(this->file_offset != i + this->read_buffer.size())
+    this->ready.wait(lock, [this]() { return !(this->reading); });
+    if(i != this->buffer.limit)
     {
-      this->read_buffer.clear();
-      this->file.seekg(i * sizeof(Element), std::ios_base::beg);
+      this->pending = 0;
       this->file_offset = i;
     }
+    this->buffer.seek(i);
+    this->start.store(i, std::memory_order_release);
   }
 
   // Force read but only if there is still something to read.
-  if(this->buffer.size() < MINIMUM_SIZE && i + this->buffer.size() < this->size())
+  if(this->buffer.size() < this->buffer.capacity() / 2 && this->buffer.limit < this->size())
   {
     std::unique_lock<std::mutex> lock(this->mtx);
-    this->forceRead();
+    this->forceRead(lock);
     this->empty.notify_one();
   }
 }
 
+template<class Element>
+bool
+ReadBuffer<Element>::canRead() const
+{
+  size_type n = std::min(this->chunk_size, this->size() - this->file_offset);
+  return (this->file_offset + n - this->start.load(std::memory_order_acquire) <= this->buffer.capacity());
+}
+
 template<class Element>
 bool
 ReadBuffer<Element>::fill()
 {
   std::unique_lock<std::mutex> lock(this->mtx);
-  this->empty.wait(lock, [this]() { return read_buffer.empty(); } );
-
-  size_type read_buffer_size = READ_BUFFER_SIZE;  // avoid direct use
-  this->read_buffer.resize(std::min(read_buffer_size, this->size() - this->file_offset));
-  DiskIO::read(this->file, this->read_buffer.data(), this->read_buffer.size());
-  this->file_offset += this->read_buffer.size();
+  this->empty.wait(lock, [this]()
+  {
+    return (this->file_offset >= this->size() || (this->pending == 0 && this->canRead()));
+  });
+  if(this->file_offset >= this->size()) { return true; }
+
+  // Read the chunk without holding the mutex. The main thread does not touch the ring
+  // outside the visible part until reading is over.
+  size_type from = this->file_offset, n = std::min(this->chunk_size, this->size() - from);
+  this->reading = true;
+  lock.unlock();
+  this->readChunk(from, n);
+  lock.lock();
+  this->reading = false;
+  this->pending = n; this->file_offset = from + n;
+  this->ready.notify_one();
 
   return (this->file_offset >= this->size());
 }
@@ -502,40 +911,60 @@ ReadBuffer<Element>::read(size_type i)
   if(i < this->buffer.offset) { this->seek(i); return; }
 
   std::unique_lock<std::mutex> lock(this->mtx);
-  while(!(this->buffer.buffered(i))) { this->forceRead(); }
+  while(!(this->buffer.buffered(i))) { this->forceRead(lock); }
   this->empty.notify_one();
 }
 
 template<class Element>
 void
-ReadBuffer<Element>::forceRead()
+ReadBuffer<Element>::forceRead(std::unique_lock<std::mutex>& lock)
 {
-  if(this->read_buffer.empty())
+  this->ready.wait(lock, [this]() { return !(this->reading); });
+  if(this->pending == 0)
   {
-    size_type read_buffer_size = READ_BUFFER_SIZE;  // avoid direct use
-    this->read_buffer.resize(std::min(read_buffer_size, this->size() - this->file_offset));
-    DiskIO::read(this->file, this->read_buffer.data(), this->read_buffer.size());
-    this->file_offset += this->read_buffer.size();
+    size_type n = std::min(this->chunk_size, this->size() - this->file_offset);
+    this->buffer.reserve(this->buffer.size() + n);
+    this->readChunk(this->file_offset, n);
+    this->pending = n; this->file_offset += n;
   }
 
-  this->buffer.insert(this->read_buffer.begin(), this->read_buffer.end());
-  this->read_buffer.clear();
+  this->buffer.limit += this->pending;
+  this->pending = 0;
+}
+
+template<class Element>
+void
+ReadBuffer<Element>::readChunk(size_type from, size_type n)
+{
+  size_type slot = from & this->buffer.mask;
+  size_type head = std::min(n, this->buffer.capacity() - slot);
+  this->file.read(from, this->buffer.data.data() + slot, head);
+  if(head < n) { this->file.read(from + head, this->buffer.data.data(), n - head); }
 }
 
 //------------------------------------------------------------------------------
 
 /*
-  A simple wrapper for buffered writing of elementary types.
+  A simple wrapper for buffered writing of elementary types. If the file is compressed,
+  the buffer size is rounded up to a multiple of the block size, and the blocks are
+  encoded as the buffer is flushed.
+
+  Full buffers are queued for a writer thread, while the main thread continues filling
+  another buffer. The writer thread is started when the buffer is flushed for the first
+  time, and it writes the queued buffers until the file is closed. The main thread waits
+  only if QUEUE_SIZE buffers are already waiting. Written buffers are reused, so a file
+  uses at most QUEUE_SIZE + 1 buffers. If the file is closed before the first flush, the
+  main thread writes the buffer.
 */
 
 template<class Element>
 struct WriteBuffer
 {
   WriteBuffer();
-  explicit WriteBuffer(const std::string& filename, size_type _buffer_size = MEGABYTE);
+  explicit WriteBuffer(const std::string& filename, size_type _buffer_size = MEGABYTE, bool _compressed = false);
   ~WriteBuffer();
 
-  void open(const std::string& filename, size_type _buffer_size = MEGABYTE);
+  void open(const std::string& filename, size_type _buffer_size = MEGABYTE, bool _compressed = false);
   void close();
 
   inline size_type size() const { return this->elements; }
@@ -543,16 +972,38 @@ struct WriteBuffer
   inline void push_back(Element value)
   {
     this->buffer.push_back(value); this->elements++;
-    if(buffer.size() >= this->buffer_size)
-    {
-      DiskIO::write(this->file, this->buffer.data(), this->buffer.size());
-      this->buffer.clear();
-    }
+    if(buffer.size() >= this->buffer_size) { this->flush(); }
   }
 
-  std::ofstream        file;
-  std::vector<Element> buffer;
-  size_type            buffer_size, elements;
+  // Hand the buffer to the writer thread.
+  void flush();
+
+  // Internal functions.
+  bool writeNext();                        // Write the next queued buffer in the writer thread.
+  void write(std::vector<Element>& data);  // Write the elements to the file and clear them.
+
+  // Main thread.
+  std::vector<Element>   buffer;
+  size_type              buffer_size, elements;
+
+  // Writer thread.
+  RawFile                file;
+  std::vector<std::vector<Element>> queue, spare;  // Full buffers in order; written buffers.
+  size_type              queue_head;
+  bool                   stopping;
+  std::mutex             mtx;
+  std::condition_variable full;     // Is there something to write?
+  std::condition_variable written;  // Has a buffer been written?
+  std::thread            writer_thread;
+
+  // Compressed files.
+  bool                   compressed;
+  std::vector<size_type> blocks;  // Byte offsets of the blocks.
+  std::vector<byte_type> code;
+  size_type              bytes;
+
+  // Full buffers that may wait for the writer thread.
+  const static size_type QUEUE_SIZE = 2;
 
   WriteBuffer(const WriteBuffer&) = delete;
   WriteBuffer& operator= (const WriteBuffer&) = delete;
@@ -560,14 +1011,15 @@ struct WriteBuffer
 
 template<class Element>
 WriteBuffer<Element>::WriteBuffer() :
-  buffer_size(0), elements(0)
+  buffer_size(0), elements(0), queue_head(0), stopping(false), compressed(false), bytes(0)
 {
 }
 
 template<class Element>
-WriteBuffer<Element>::WriteBuffer(const std::string& filename, size_type _buffer_size)
+WriteBuffer<Element>::WriteBuffer(const std::string& filename, size_type _buffer_size, bool _compressed) :
+  queue_head(0), stopping(false)
 {
-  this->open(filename, _buffer_size);
+  this->open(filename, _buffer_size, _compressed);
 }
 
 template<class Element>
@@ -578,31 +1030,133 @@ WriteBuffer<Element>::~WriteBuffer()
 
 template<class Element>
 void
-WriteBuffer<Element>::open(const std::string& filename, size_type _buffer_size)
+WriteBuffer<Element>::open(const std::string& filename, size_type _buffer_size, bool _compressed)
 {
-  this->file.open(filename.c_str(), std::ios_base::binary);
-  if(!(this->file))
+  if(!(this->file.open(filename, true)))
   {
     std::cerr << "WriteBuffer::open(): Cannot open output file " << filename << std::endl;
     std::exit(EXIT_FAILURE);
   }
 
-  this->buffer_size = _buffer_size; this->elements = 0;
+  this->buffer_size = std::max(_buffer_size, (size_type)1); this->elements = 0;
+  this->compressed = _compressed; this->bytes = 0;
+  this->blocks.clear();
+  if(this->compressed)
+  {
+    const size_type block_size = BlockCodec::BLOCK_SIZE;  // avoid direct use of static const
+    this->buffer_size = ((this->buffer_size + block_size - 1) / block_size) * block_size;
+  }
   this->buffer.reserve(this->buffer_size);
 }
 
+template<class Element>
+void
+writerThread(WriteBuffer<Element>* buffer)
+{
+  while(!(buffer->writeNext()));
+}
+
+template<class Element>
+void
+WriteBuffer<Element>::flush()
+{
+  if(this->buffer.empty()) { return; }
+
+  std::vector<Element> next;
+  {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    this->written.wait(lock, [this]() { return (this->queue.size() - this->queue_head < QUEUE_SIZE); });
+    if(!(this->spare.empty())) { next.swap(this->spare.back()); this->spare.pop_back(); }
+    this->queue.push_back(std::vector<Element>());
+    this->queue.back().swap(this->buffer);
+    this->full.notify_one();
+  }
+  this->buffer.swap(next);
+  this->buffer.reserve(this->buffer_size);
+  if(!(this->writer_thread.joinable())) { this->writer_thread = std::thread(writerThread<Element>, this); }
+}
+
+template<class Element>
+bool
+WriteBuffer<Element>::writeNext()
+{
+  std::unique_lock<std::mutex> lock(this->mtx);
+  this->full.wait(lock, [this]() { return (this->queue_head < this->queue.size() || this->stopping); });
+  if(this->queue_head >= this->queue.size()) { return true; }
+
+  // The buffer is moved out of the queue, so it can be written without holding the mutex.
+  std::vector<Element> data; data.swap(this->queue[this->queue_head]);
+  lock.unlock();
+  this->write(data);
+  lock.lock();
+  this->queue_head++;
+  if(this->queue_head >= this->queue.size()) { this->queue.clear(); this->queue_head = 0; }
+  this->spare.push_back(std::vector<Element>());
+  this->spare.back().swap(data);
+  this->written.notify_one();
+
+  return false;
+}
+
+template<class Element>
+void
+WriteBuffer<Element>::write(std::vector<Element>& data)
+{
+  if(!(this->compressed))
+  {
+    DiskIO::write(this->file, data.data(), data.size());
+    data.clear();
+    return;
+  }
+
+  const size_type block_size = BlockCodec::BLOCK_SIZE;  // avoid direct use of static const
+  for(size_type i = 0; i < data.size(); i += block_size)
+  {
+    size_type n = std::min(block_size, data.size() - i);
+    this->code.clear();
+    BlockCodec::encode(data.data() + i, n, this->code);
+    this->blocks.push_back(this->bytes);
+    DiskIO::writeCompressed(this->file, this->code.data(), this->code.size(), n * sizeof(Element));
+    this->bytes += this->code.size();
+  }
+  data.clear();
+}
+
 template<class Element>
 void
 WriteBuffer<Element>::close()
 {
-  if(this->buffer.size() > 0)
+  if(this->file.is_open())
   {
-    DiskIO::write(this->file, this->buffer.data(), this->buffer.size());
+    if(this->writer_thread.joinable())
+    {
+      this->flush();
+      {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->stopping = true;
+        this->full.notify_one();
+      }
+      this->writer_thread.join();
+    }
+    else { this->write(this->buffer); }
+    if(this->compressed)
+    {
+      size_type block_count = this->blocks.size();
+      this->blocks.push_back(this->bytes);
+      this->blocks.push_back(this->elements);
+      this->blocks.push_back(block_count);
+      DiskIO::write(this->file, this->blocks.data(), this->blocks.size());
+    }
   }
   this->file.close();
   sdsl::util::clear(this->buffer);
+  sdsl::util::clear(this->queue); sdsl::util::clear(this->spare);
+  this->queue_head = 0; this->stopping = false;
+  sdsl::util::clear(this->blocks);
+  sdsl::util::clear(this->code);
   this->buffer_size = 0;
   this->elements = 0;
+  this->bytes = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -118,6 +118,25 @@ public:
 
   explicit LCPArray(const InputGraph& graph, const ConstructionParameters& parameters = ConstructionParameters());
 
+  /*
+    Incremental construction. The constructor allocates the tree for array_size values.
+    The values can then be set in any order with setValue(), and the internal nodes are
+    updated as the values arrive. Call finish() after all values have been set.
+  */
+
+  LCPArray(size_type array_size, size_type branching_factor);
+  void setValue(size_type i, size_type value);
+  void finish();
+
+  /*
+    Parallel construction. setLeaf() only sets the value, so threads can set the values
+    in disjoint ranges starting at multiples of 8. Call buildInternal() after all values
+    have been set and before finish().
+  */
+
+  void setLeaf(size_type i, size_type value);
+  void buildInternal();
+
 //------------------------------------------------------------------------------
 
   inline size_type size() const { return this->header.size; }
@@ -190,6 +209,7 @@ public:
 
 private:
   void copy(const LCPArray& source);
+  void initialize(size_type array_size, size_type branching_factor);
 };  // class LCPArray
 
 //------------------------------------------------------------------------------
@@ -37,41 +37,6 @@ namespace gcsa
 
 //------------------------------------------------------------------------------
 
-struct PathLabel
-{
-  typedef std::uint32_t rank_type;
-
-  // This should be at least 1 << ConstructionParameters::DOUBLING_STEPS.
-  const static size_type LABEL_LENGTH = 8;
-
-  // Labels starting with NO_RANK will be after real labels in lexicographic order.
-  // We also use NO_RANK for padding last labels.
-  const static rank_type NO_RANK = ~(rank_type)0;
-
-  rank_type label[LABEL_LENGTH];
-  bool      first;
-
-  inline bool operator< (const PathLabel& another) const
-  {
-    for(size_type i = 0; i < LABEL_LENGTH; i++)
-    {
-      if(this->label[i] != another.label[i]) { return (this->label[i] < another.label[i]); }
-    }
-    return (this->first && !(another.first));
-  }
-
-  inline bool operator<= (const PathLabel& another) const
-  {
-    for(size_type i = 0; i < LABEL_LENGTH; i++)
-    {
-      if(this->label[i] != another.label[i]) { return (this->label[i] < another.label[i]); }
-    }
-    return (this->first || !(another.first));
-  }
-};
-
-//------------------------------------------------------------------------------
-
 /*
   The node type used during doubling. As in the original GCSA, from and to are nodes
   in the original graph, denoting a path as a semiopen range [from, to). If
@@ -90,9 +55,11 @@ struct PathLabel
 
 struct PathNode
 {
-  typedef PathLabel::rank_type rank_type;
+  typedef std::uint32_t rank_type;
 
-  const static size_type LABEL_LENGTH = PathLabel::LABEL_LENGTH;
+  // Labels starting with NO_RANK will be after real labels in lexicographic order.
+  // We also use NO_RANK for padding last labels.
+  const static rank_type NO_RANK = ~(rank_type)0;
 
   node_type from, to;
 
@@ -105,9 +72,8 @@ struct PathNode
     From low-order to high-order bits:
 
     8 bits   which predecessor comp values exist
-    4 bits   length of the kmer rank sequences representing the path label range
-    4 bits   lcp of the above sequences
-    8 bits   unused
+    8 bits   length of the kmer rank sequences representing the path label range
+    8 bits   lcp of the above sequences
     40 bits  pointer to the label data
   */
   size_type fields;
@@ -128,19 +94,19 @@ struct PathNode
   }
 
   // Order is the length of the kmer rank sequences representing the path label range.
-  inline size_type order() const { return ((this->fields >> 8) & 0xF); }
+  inline size_type order() const { return ((this->fields >> 8) & 0xFF); }
   inline void setOrder(size_type new_order)
   {
-    this->fields &= ~(size_type)0xF00;
+    this->fields &= ~(size_type)0xFF00;
     this->fields |= new_order << 8;
   }
 
   // LCP is the length of the common prefix of kmer rank sequences.
-  inline size_type lcp() const { return ((this->fields >> 12) & 0xF); }
+  inline size_type lcp() const { return ((this->fields >> 16) & 0xFF); }
   inline void setLCP(size_type new_lcp)
   {
-    this->fields &= ~(size_type)0xF000;
-    this->fields |= new_lcp << 12;
+    this->fields &= ~(size_type)0xFF0000;
+    this->fields |= new_lcp << 16;
   }
 
   inline size_type pointer() const { return (this->fields >> 24); }
@@ -243,6 +209,44 @@ struct FromGetter
 
 //------------------------------------------------------------------------------
 
+/*
+  A path label as a fixed-length sequence of kmer ranks. LABEL_LENGTH must be at least
+  the order of the paths, which is 1 << (doubling steps). The code using labels is
+  instantiated for each supported number of doubling steps, so builds with fewer steps
+  use shorter labels.
+*/
+
+template<size_type LABEL_LENGTH>
+struct PathLabel
+{
+  typedef PathNode::rank_type rank_type;
+
+  const static rank_type NO_RANK = PathNode::NO_RANK;
+
+  rank_type label[LABEL_LENGTH];
+  bool      first;
+
+  inline bool operator< (const PathLabel& another) const
+  {
+    for(size_type i = 0; i < LABEL_LENGTH; i++)
+    {
+      if(this->label[i] != another.label[i]) { return (this->label[i] < another.label[i]); }
+    }
+    return (this->first && !(another.first));
+  }
+
+  inline bool operator<= (const PathLabel& another) const
+  {
+    for(size_type i = 0; i < LABEL_LENGTH; i++)
+    {
+      if(this->label[i] != another.label[i]) { return (this->label[i] < another.label[i]); }
+    }
+    return (this->first || !(another.first));
+  }
+};
+
+//------------------------------------------------------------------------------
+
 struct LCP
 {
   typedef PathNode::rank_type rank_type;
@@ -277,6 +281,9 @@ struct LCP
   }
 
   void swap(LCP& another);
+
+  size_type serialize(std::ostream& out, sdsl::structure_tree_node* v = nullptr, std::string name = "") const;
+  void load(std::istream& in);
 };
 
 //------------------------------------------------------------------------------
@@ -302,14 +309,29 @@ struct PathGraph
   const static size_type UNKNOWN = ~(size_type)0;
   const static std::string PREFIX;  // .gcsa
 
-  PathGraph(const InputGraph& source, sdsl::sd_vector<>& key_exists);
+  // The path and rank files are block-compressed.
+  const static bool COMPRESSED = true;
+
+  /*
+    Reads the input once. Also returns the keys (merged by label) and the unique from nodes
+    in sorted order, as InputGraph::readKeys() and InputGraph::readFrom() would.
+  */
+  PathGraph(const InputGraph& source, std::vector<key_type>& keys, std::vector<node_type>& from_nodes,
+    size_type memory_limit);
   PathGraph(size_type file_count, size_type path_order, size_type steps);
   ~PathGraph();
 
   void clear();
   void swap(PathGraph& another);
 
-  void open(std::ifstream& path_file, std::ifstream& rank_file, size_type file) const;
+  /*
+    Serialization stores the file names and the statistics for construction checkpoints.
+    The files themselves are not copied. The loaded graph takes ownership of the files.
+  */
+  void serialize(std::ostream& out) const;
+  void load(std::istream& in);
+
+  void open(ElementFile<PathNode>& path_file, ElementFile<PathNode::rank_type>& rank_file, size_type file) const;
 
   inline size_type size() const { return this->path_count; }
   inline size_type ranks() const { return this->rank_count; }
@@ -324,8 +346,8 @@ struct PathGraph
   }
 
   // Size limits are in bytes.
-  void prune(const LCP& lcp, size_type size_limit);
-  void extend(size_type size_limit);
+  void prune(const LCP& lcp, size_type size_limit, size_type memory_limit);
+  void extend(size_type size_limit, size_type memory_limit);
 
   void read(std::vector<PathNode>& paths, std::vector<PathNode::rank_type>& labels, size_type file) const;
 
@@ -354,10 +376,17 @@ struct MergedGraph
   const static size_type UNKNOWN = ~(size_type)0;
   const static std::string PREFIX;  // .gcsa
 
-  MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, const LCP& kmer_lcp, size_type size_limit);
+  MergedGraph();
+  MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, const LCP& kmer_lcp,
+    size_type size_limit, size_type memory_limit);
   ~MergedGraph();
 
   void clear();
+  void swap(MergedGraph& another);
+
+  // Serialization for construction checkpoints; see PathGraph.
+  void serialize(std::ostream& out) const;
+  void load(std::istream& in);
 
   inline size_type size() const { return this->path_count; }
   inline size_type ranks() const { return this->rank_count; }
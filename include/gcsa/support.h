@@ -39,18 +39,88 @@ namespace gcsa
 struct ConstructionParameters
 {
   const static size_type DOUBLING_STEPS = 3;
+  const static size_type MAX_STEPS      = 4;
   const static size_type SIZE_LIMIT     = 500;    // Gigabytes.
   const static size_type ABSOLUTE_LIMIT = 16384;  // Gigabytes.
+  const static size_type MEMORY_LIMIT   = 64;     // Gigabytes.
   const static size_type LCP_BRANCHING  = 64;
 
   ConstructionParameters();
   void setSteps(size_type steps);
   void setLimit(size_type gigabytes);
+  void setMemoryLimit(size_type gigabytes);
   void setLCPBranching(size_type factor);
 
+  /*
+    If the checkpoint file is set, construction writes a manifest there after each
+    completed phase and resumes from the last completed phase if the manifest exists.
+  */
+  void setCheckpoint(const std::string& filename);
+
   size_type doubling_steps;
   size_type size_limit;
+
+  /*
+    The memory limit chooses buffer sizes and in-memory vs. external algorithms. Sorting
+    a file of paths in memory needs the paths and the labels, as well as two 16-byte
+    (key, index) pairs per path for the radix sort and its buffer.
+  */
+  size_type memory_limit;
   size_type lcp_branching;
+
+  std::string checkpoint_file;
+
+  // If the profile file is set, construction writes a ConstructionProfile there.
+  void setProfile(const std::string& filename);
+
+  std::string profile_file;
+};
+
+//------------------------------------------------------------------------------
+
+/*
+  A machine-readable profile of GCSA construction. Each phase records the wall time, the
+  CPU time, the I/O volume, and the peak disk usage by temporary files (as tracked by
+  TempFile) since the end of the previous phase, as well as memory usage and named counts
+  at the end of the phase.
+  The profile is written as a JSON file.
+*/
+
+struct ConstructionProfile
+{
+  struct Phase
+  {
+    std::string name;
+    size_type   step;  // Doubling step or NO_STEP.
+    double      seconds, cpu_seconds;
+    size_type   peak_memory, memory;
+    size_type   read_bytes, write_bytes;
+    size_type   logical_read_bytes, logical_write_bytes;
+    size_type   temp_disk;
+    std::vector<std::pair<std::string, size_type>> counts;
+
+    inline void add(const std::string& count_name, size_type value)
+    {
+      this->counts.push_back(std::make_pair(count_name, value));
+    }
+  };
+
+  const static size_type NO_STEP = ~(size_type)0;
+  const static std::string EXTENSION; // .profile.json
+
+  ConstructionProfile();
+
+  // Ends the current phase and starts the next one.
+  Phase& record(const std::string& name, size_type step = NO_STEP);
+
+  // Returns false if the file cannot be written.
+  bool write(const std::string& filename, const ConstructionParameters& parameters) const;
+
+  std::vector<Phase> phases;
+
+  // Start of the current phase.
+  double    start_time, start_cpu;
+  size_type start_read, start_write, start_logical_read, start_logical_write;
 };
 
 //------------------------------------------------------------------------------
@@ -286,22 +356,36 @@ SadaSparse::SadaSparse(const Container& source)
     - 16x3 bits for the label, with high-order characters 0s when necessary
     - 8 bits for marking which predecessors are present
     - 8 bits for marking which successors are present
+
+  If GCSA_WIDE_KEYS is defined, the kmer is encoded as a 128-bit integer with 37x3 bits
+  for the label (the highest bit is unused). This allows kmers of length up to 37. The
+  library and the programs using it must be compiled with the same setting.
 */
 
+#ifdef GCSA_WIDE_KEYS
+typedef unsigned __int128 key_type;
+#else
 typedef std::uint64_t key_type;
+#endif
 
 struct Key
 {
   const static size_type CHAR_WIDTH = 3;
   const static key_type  CHAR_MASK = 0x7;
-  const static size_type MAX_LENGTH = 16;
+  const static size_type MAX_LENGTH = (sizeof(key_type) * BYTE_BITS - 16) / CHAR_WIDTH;
   const static key_type  PRED_SUCC_MASK = 0xFFFF;
 
   inline static key_type encode(const Alphabet& alpha, const std::string& kmer,
     byte_type pred, byte_type succ)
+  {
+    return encode(alpha, kmer.data(), kmer.length(), pred, succ);
+  }
+
+  inline static key_type encode(const Alphabet& alpha, const char* kmer, size_type length,
+    byte_type pred, byte_type succ)
   {
     key_type value = 0;
-    for(size_type i = 0; i < kmer.length(); i++)
+    for(size_type i = 0; i < length; i++)
     {
       value = (value << CHAR_WIDTH) | alpha.char2comp[kmer[i]];
     }
@@ -312,7 +396,7 @@ struct Key
 
   static std::string decode(key_type key, size_type kmer_length, const Alphabet& alpha);
 
-  inline static size_type label(key_type key) { return (key >> 16); }
+  inline static key_type label(key_type key) { return (key >> 16); }
   inline static byte_type predecessors(key_type key) { return (key >> 8) & 0xFF; }
   inline static byte_type successors(key_type key) { return key & 0xFF; }
   inline static comp_type last(key_type key) { return (key >> 16) & CHAR_MASK; }
@@ -320,7 +404,7 @@ struct Key
   inline static key_type merge(key_type key1, key_type key2) { return (key1 | (key2 & PRED_SUCC_MASK)); }
   inline static key_type replace(key_type key, size_type kmer_val)
   {
-    return (kmer_val << 16) | (key & PRED_SUCC_MASK);
+    return (static_cast<key_type>(kmer_val) << 16) | (key & PRED_SUCC_MASK);
   }
 
   inline static size_type lcp(key_type a, key_type b, size_type kmer_length)
@@ -374,6 +458,7 @@ struct Node
   }
 
   static node_type encode(const std::string& token);
+  static node_type encode(const char* begin, const char* end);  // Token [begin, end).
   static std::string decode(node_type node);
 
   inline static size_type id(node_type node) { return node >> ID_OFFSET; }
@@ -383,7 +468,16 @@ struct Node
 
 //------------------------------------------------------------------------------
 
+/*
+  With wide keys, KMer is aligned to 8 bytes, as the KMer arrays in memory-mapped binary
+  graph files start after 24-byte section headers.
+*/
+
+#ifdef GCSA_WIDE_KEYS
+struct __attribute__((packed, aligned(8))) KMer
+#else
 struct KMer
+#endif
 {
   key_type  key;
   node_type from, to;
@@ -406,6 +500,7 @@ struct KMer
   inline void makeSorted() { this->to = ~(node_type)0; }
 
   static byte_type chars(const std::string& token, const Alphabet& alpha);
+  static byte_type chars(const char* begin, const char* end, const Alphabet& alpha);
 };
 
 std::ostream& operator<< (std::ostream& out, const KMer& kmer);
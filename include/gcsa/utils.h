@@ -208,28 +208,73 @@ void printTime(const std::string& header, size_type queries, double seconds, siz
 //------------------------------------------------------------------------------
 
 double readTimer();       // Seconds from an arbitrary time point.
+double readCPUTimer();    // User + system CPU seconds used by the process.
 size_type memoryUsage();  // Peak memory usage in bytes.
+size_type currentMemoryUsage();  // Resident set size in bytes; 0 if not available.
 
 size_type readVolume();   // Only for GCSA construction.
 size_type writeVolume();  // Only for GCSA construction.
 
+// Uncompressed sizes of the data read/written.
+size_type logicalReadVolume();   // Only for GCSA construction.
+size_type logicalWriteVolume();  // Only for GCSA construction.
+
 //------------------------------------------------------------------------------
 
+/*
+  If in_memory is set, temporary files are SDSL ram files. They must be accessed using
+  sdsl::isfstream and sdsl::osfstream. Once the live ram files contain ram_limit bytes,
+  new temporary files are created on disk until enough ram files have been removed.
+
+  Temporary files can be spread over several directories. A new file goes to the device
+  with the fewest bytes in live temporary files among the devices with enough free space,
+  breaking ties by the number of live files. As the files that exist at the same time are
+  usually read together in the same merge, they end up on different devices. temp_dir is
+  the first directory. Assigning a directory directly to it replaces the list with that
+  directory.
+*/
+
 struct TempFile
 {
   static std::string temp_dir;
+  static std::vector<std::string> temp_dirs;
+  static bool in_memory;
+  static size_type ram_limit;
   const static std::string DEFAULT_TEMP_DIR;
 
+  // The argument can be a comma-separated list of directories.
   static void setDirectory(const std::string& directory);
+  static void setDirectories(const std::vector<std::string>& directories);
+  static std::vector<std::string> directories();
+  static std::string directoryNames();  // Comma-separated list.
+
   static std::string getName(const std::string& name_part);
+  // Use the same device as the existing file, e.g. for hard links.
+  static std::string getName(const std::string& name_part, const std::string& neighbor);
   static void remove(std::string& filename);
+
+  /*
+    Total size of the live temporary files on disk, and the peak size since the last
+    reset. The sizes are reported by the writers with setSize(), so files written by
+    other means are not counted. A hard link made with the neighbor version of getName()
+    has size 0, and the data is no longer counted once the original file is removed.
+  */
+  static size_type diskUsage();
+  static size_type peakDiskUsage();
+  static void resetPeakDiskUsage();
+
+  // Total size of the live temporary ram files.
+  static size_type ramUsage();
+
+  // Called by the writer of a temporary file. Other files are ignored.
+  static void setSize(const std::string& filename, size_type bytes);
 };
 
 // Returns the total length of the rows, excluding line ends.
 size_type readRows(const std::string& filename, std::vector<std::string>& rows, bool skip_empty_rows);
 
-size_type fileSize(std::ifstream& file);
-size_type fileSize(std::ofstream& file);
+size_type fileSize(std::istream& file);
+size_type fileSize(std::ostream& file);
 
 //------------------------------------------------------------------------------
 
@@ -288,6 +333,12 @@ parallelMergeSort(Iterator first, Iterator last)
 #endif
 }
 
+/*
+  Parallel MSD radix sort for (key, value) pairs using the low key_bits bits of the key.
+  The order of pairs with equal keys is unspecified. Uses data.size() pairs of extra space.
+*/
+void parallelRadixSort(std::vector<range_type>& data, size_type key_bits);
+
 template<class Iterator, class Comparator>
 void
 sequentialSort(Iterator first, Iterator last, const Comparator& comp)
@@ -22,6 +22,20 @@
   SOFTWARE.
 */
 
+#include <cerrno>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef GCSA_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#undef BLOCK_SIZE  // Defined in linux/fs.h.
+#endif
+
 #include <gcsa/internal.h>
 
 namespace gcsa
@@ -31,20 +45,488 @@ namespace gcsa
 
 std::atomic<size_type> DiskIO::read_volume(0);
 std::atomic<size_type> DiskIO::write_volume(0);
+std::atomic<size_type> DiskIO::logical_read_volume(0);
+std::atomic<size_type> DiskIO::logical_write_volume(0);
+
+#ifdef GCSA_IO_URING
+size_type DiskIO::backend = DiskIO::URING;
+#else
+size_type DiskIO::backend = DiskIO::POSIX;
+#endif
+bool DiskIO::direct = false;
+
+void
+DiskIO::setBackend(size_type new_backend)
+{
+#ifdef GCSA_IO_URING
+  backend = (new_backend == URING ? URING : POSIX);
+#else
+  backend = POSIX;
+#endif
+}
+
+std::string
+DiskIO::backendName()
+{
+  switch(backend)
+  {
+    case POSIX:
+      return "pread/pwrite"; break;
+    case URING:
+      return "io_uring"; break;
+  }
+  return "unknown";
+}
+
+//------------------------------------------------------------------------------
+
+#ifdef GCSA_IO_URING
+
+/*
+  A minimal io_uring interface using the system calls directly. Each RawFile has its own
+  ring, as a file is only accessed by one thread at a time.
+*/
+
+struct IORing
+{
+  int           fd;
+  unsigned      entries;
+
+  void*         sq_ring;
+  size_type     sq_ring_size;
+  unsigned      *sq_head, *sq_tail, *sq_mask, *sq_array;
+  io_uring_sqe* sqes;
+  size_type     sqes_size;
+
+  void*         cq_ring;
+  size_type     cq_ring_size;
+  unsigned      *cq_head, *cq_tail, *cq_mask;
+  io_uring_cqe* cqes;
+
+  IORing() :
+    fd(-1), entries(0),
+    sq_ring(MAP_FAILED), sq_ring_size(0), sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), sqes_size(0),
+    cq_ring(MAP_FAILED), cq_ring_size(0)
+  {
+  }
+
+  ~IORing()
+  {
+    if(this->sqes != MAP_FAILED) { munmap(this->sqes, this->sqes_size); }
+    if(this->cq_ring != MAP_FAILED) { munmap(this->cq_ring, this->cq_ring_size); }
+    if(this->sq_ring != MAP_FAILED) { munmap(this->sq_ring, this->sq_ring_size); }
+    if(this->fd >= 0) { ::close(this->fd); }
+  }
+
+  // Returns false if io_uring is not available.
+  bool init(unsigned depth)
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    this->fd = syscall(__NR_io_uring_setup, depth, &params);
+    if(this->fd < 0) { return false; }
+    this->entries = params.sq_entries;
+
+    this->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    this->sq_ring = mmap(0, this->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+      this->fd, IORING_OFF_SQ_RING);
+    if(this->sq_ring == MAP_FAILED) { return false; }
+    byte_type* sq = static_cast<byte_type*>(this->sq_ring);
+    this->sq_head = (unsigned*)(sq + params.sq_off.head);
+    this->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    this->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    this->sq_array = (unsigned*)(sq + params.sq_off.array);
+
+    this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_ptr = mmap(0, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+      this->fd, IORING_OFF_SQES);
+    if(sqe_ptr == MAP_FAILED) { return false; }
+    this->sqes = static_cast<io_uring_sqe*>(sqe_ptr);
+
+    this->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    this->cq_ring = mmap(0, this->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+      this->fd, IORING_OFF_CQ_RING);
+    if(this->cq_ring == MAP_FAILED) { return false; }
+    byte_type* cq = static_cast<byte_type*>(this->cq_ring);
+    this->cq_head = (unsigned*)(cq + params.cq_off.head);
+    this->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    this->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    this->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return true;
+  }
+
+  /*
+    Splits the transfer into at most entries parts, submits them, and waits until all of
+    them have completed. Returns the length of the prefix that was transferred. Errors
+    and short transfers are left for the caller to handle.
+  */
+  size_type transfer(int file, size_type offset, byte_type* data, size_type n, bool write)
+  {
+    const size_type alignment = RawFile::ALIGNMENT;  // avoid direct use of static const
+    const size_type min_part = RawFile::MIN_PART_SIZE, max_part = RawFile::MAX_PART_SIZE;
+    size_type parts = Range::bound(n / min_part, 1, this->entries);
+    size_type part_size = std::min(((n + parts - 1) / parts + alignment - 1) / alignment * alignment, max_part);
+    parts = (n + part_size - 1) / part_size;
+
+    // Fill the submission queue.
+    unsigned tail = *(this->sq_tail);
+    for(size_type i = 0; i < parts; i++)
+    {
+      unsigned index = tail & *(this->sq_mask);
+      io_uring_sqe* sqe = this->sqes + index;
+      std::memset(sqe, 0, sizeof(io_uring_sqe));
+      sqe->opcode = (write ? IORING_OP_WRITE : IORING_OP_READ);
+      sqe->fd = file;
+      sqe->off = offset + i * part_size;
+      sqe->addr = (std::uint64_t)(data + i * part_size);
+      sqe->len = std::min(part_size, n - i * part_size);
+      sqe->user_data = i;
+      this->sq_array[index] = index;
+      tail++;
+    }
+    __atomic_store_n(this->sq_tail, tail, __ATOMIC_RELEASE);
+
+    // Submit the requests and reap the completions.
+    std::vector<std::int64_t> results(parts, 0);
+    size_type submitted = 0, completed = 0;
+    while(completed < parts)
+    {
+      int res = syscall(__NR_io_uring_enter, this->fd, (unsigned)(parts - submitted),
+        (unsigned)(parts - completed), IORING_ENTER_GETEVENTS, NULL, 0);
+      if(res < 0)
+      {
+        if(errno == EINTR) { continue; }
+        std::cerr << "IORing::transfer(): io_uring_enter() failed: " << std::strerror(errno) << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+      submitted += res;
+      unsigned head = *(this->cq_head);
+      while(head != __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE))
+      {
+        io_uring_cqe* cqe = this->cqes + (head & *(this->cq_mask));
+        results[cqe->user_data] = cqe->res;
+        head++; completed++;
+      }
+      __atomic_store_n(this->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    size_type done = 0;
+    for(size_type i = 0; i < parts; i++)
+    {
+      if(results[i] <= 0) { break; }
+      done += results[i];
+      if((size_type)(results[i]) < std::min(part_size, n - i * part_size)) { break; }
+    }
+    return done;
+  }
+
+  IORing(const IORing&) = delete;
+  IORing& operator= (const IORing&) = delete;
+};
+
+#else
+
+struct IORing
+{
+  bool init(unsigned) { return false; }
+  size_type transfer(int, size_type, byte_type*, size_type, bool) { return 0; }
+};
+
+#endif
+
+//------------------------------------------------------------------------------
+
+RawFile::RawFile() :
+  fd(-1), writing(false), direct(false), bytes(0),
+  buffer(0), buffered(0),
+  ring(0)
+{
+}
+
+RawFile::~RawFile()
+{
+  this->close();
+}
+
+bool
+RawFile::open(const std::string& filename, bool write)
+{
+  this->close();
+  this->name = filename; this->writing = write;
+  if(write) { TempFile::setSize(filename, 0); }
+
+  if(sdsl::is_ram_file(filename))
+  {
+    if(write)
+    {
+      this->output.open(filename, std::ios_base::out | std::ios_base::binary);
+      return this->output.is_open();
+    }
+    this->input.open(filename, std::ios_base::in | std::ios_base::binary);
+    if(!(this->input.is_open())) { return false; }
+    this->bytes = fileSize(this->input);
+    return true;
+  }
+
+  int flags = (write ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY);
+#ifdef O_DIRECT
+  if(DiskIO::direct)
+  {
+    this->fd = ::open(filename.c_str(), flags | O_DIRECT, 0666);
+    this->direct = (this->fd >= 0);
+  }
+#endif
+  if(this->fd < 0) { this->fd = ::open(filename.c_str(), flags, 0666); }
+  if(this->fd < 0) { return false; }
+#ifdef F_NOCACHE
+  if(DiskIO::direct) { fcntl(this->fd, F_NOCACHE, 1); }
+#endif
+
+  if(!write)
+  {
+    struct stat file_info;
+    if(fstat(this->fd, &file_info) != 0) { this->close(); return false; }
+    this->bytes = file_info.st_size;
+  }
+  if(this->direct)
+  {
+    void* ptr = 0;
+    if(posix_memalign(&ptr, ALIGNMENT, BUFFER_SIZE) != 0)
+    {
+      std::cerr << "RawFile::open(): Cannot allocate an aligned buffer for " << filename << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    this->buffer = static_cast<byte_type*>(ptr);
+  }
+  if(DiskIO::backend == DiskIO::URING)
+  {
+    this->ring = new IORing();
+    if(!(this->ring->init(IO_DEPTH))) { delete this->ring; this->ring = 0; }
+  }
+
+  return true;
+}
+
+void
+RawFile::close()
+{
+  if(this->input.is_open()) { this->input.close(); }
+  if(this->output.is_open()) { this->output.close(); }
+
+  if(this->fd >= 0)
+  {
+    // Write the last partial block and truncate the padding.
+    if(this->writing && this->direct && this->buffered > 0)
+    {
+      size_type padded = (this->buffered + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+      std::memset(this->buffer + this->buffered, 0, padded - this->buffered);
+      this->transfer(this->bytes - this->buffered, this->buffer, padded, true);
+      if(ftruncate(this->fd, this->bytes) != 0)
+      {
+        std::cerr << "RawFile::close(): Cannot truncate file " << this->name << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    ::close(this->fd);
+    this->fd = -1;
+  }
+
+  delete this->ring; this->ring = 0;
+  std::free(this->buffer); this->buffer = 0;
+  this->writing = false; this->direct = false;
+  this->bytes = 0; this->buffered = 0;
+  this->name.clear();
+}
+
+void
+RawFile::read(size_type offset, byte_type* data, size_type n)
+{
+  if(this->input.is_open())
+  {
+    this->input.seekg(offset, std::ios_base::beg);
+    this->input.read((char*)data, n);
+    return;
+  }
+  if(offset + n > this->size())
+  {
+    std::cerr << "RawFile::read(): Reading past the end of file " << this->name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  if(!(this->direct))
+  {
+    this->transfer(offset, data, n, false);
+    this->dropCache(offset, n, false);
+    return;
+  }
+
+  // Read aligned blocks covering the range and copy the relevant part.
+  while(n > 0)
+  {
+    size_type start = offset / ALIGNMENT * ALIGNMENT, skip = offset - start;
+    size_type count = std::min(n, BUFFER_SIZE - skip);
+    size_type padded = (skip + count + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    this->transfer(start, this->buffer, padded, false);
+    std::memcpy(data, this->buffer + skip, count);
+    offset += count; data += count; n -= count;
+  }
+}
+
+void
+RawFile::write(const byte_type* data, size_type n)
+{
+  if(this->output.is_open())
+  {
+    this->output.write((const char*)data, n);
+    this->bytes += n;
+    TempFile::setSize(this->name, this->bytes);
+    return;
+  }
+
+  if(!(this->direct))
+  {
+    this->transfer(this->bytes, const_cast<byte_type*>(data), n, true);
+    this->dropCache(this->bytes, n, true);
+    this->bytes += n;
+    TempFile::setSize(this->name, this->bytes);
+    return;
+  }
+
+  // Write full buffers and keep the rest in the buffer.
+  while(n > 0)
+  {
+    size_type count = std::min(n, BUFFER_SIZE - this->buffered);
+    std::memcpy(this->buffer + this->buffered, data, count);
+    this->buffered += count; this->bytes += count;
+    if(this->buffered >= BUFFER_SIZE)
+    {
+      this->transfer(this->bytes - this->buffered, this->buffer, this->buffered, true);
+      this->buffered = 0;
+    }
+    data += count; n -= count;
+  }
+  TempFile::setSize(this->name, this->bytes);
+}
+
+size_type
+RawFile::transfer(size_type offset, byte_type* data, size_type n, bool write)
+{
+  size_type done = 0;
+
+  // Use the ring while the transfers are complete.
+  if(this->ring != 0)
+  {
+    const size_type max_round = IO_DEPTH * MAX_PART_SIZE;
+    while(done < n)
+    {
+      size_type request = std::min(n - done, max_round);
+      size_type result = this->ring->transfer(this->fd, offset + done, data + done, request, write);
+      done += result;
+      if(result < request) { break; }
+    }
+  }
+
+  // Finish with pread() / pwrite(). This also reports the errors.
+  while(done < n)
+  {
+    ssize_t result = (write ?
+      ::pwrite(this->fd, data + done, n - done, offset + done) :
+      ::pread(this->fd, data + done, n - done, offset + done));
+    if(result < 0)
+    {
+      if(errno == EINTR) { continue; }
+      std::cerr << "RawFile::transfer(): Cannot " << (write ? "write to" : "read from") << " file "
+                << this->name << ": " << std::strerror(errno) << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if(result == 0)
+    {
+      if(write)
+      {
+        std::cerr << "RawFile::transfer(): Cannot write to file " << this->name << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+      break;  // End of file.
+    }
+    done += result;
+  }
+
+  return done;
+}
+
+void
+RawFile::dropCache(size_type offset, size_type n, bool write)
+{
+  if(!(DiskIO::direct) || n == 0) { return; }
+
+#ifdef SYNC_FILE_RANGE_WRITE
+  // Dirty pages must be written before they can be dropped.
+  if(write)
+  {
+    sync_file_range(this->fd, offset, n,
+      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+  }
+#endif
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(this->fd, offset, n, POSIX_FADV_DONTNEED);
+#endif
+}
 
 //------------------------------------------------------------------------------
 
 CounterArray::CounterArray() :
-  width(8), large_value(sdsl::bits::lo_set[width]),
-  total(0)
+  elements(0), width(8), width_bits(3), word_bits(3), word_mask(7), large_value(sdsl::bits::lo_set[8]),
+  total(0),
+  large_count(0), table_bits(0)
 {
 }
 
 CounterArray::CounterArray(size_type n, size_type data_width) :
-  data(n, 0, data_width),
-  width(data_width), large_value(sdsl::bits::lo_set[width]),
-  total(0)
+  elements(n), width(1), width_bits(0),
+  total(0),
+  large_count(0), table_bits(0)
 {
+  const size_type word_bits = WORD_BITS;  // avoid direct use of static const
+  while(this->width < data_width && 2 * this->width < word_bits) { this->width *= 2; this->width_bits++; }
+  this->word_bits = sdsl::bits::hi(word_bits) - this->width_bits;
+  this->word_mask = (static_cast<size_type>(1) << this->word_bits) - 1;
+  this->large_value = sdsl::bits::lo_set[this->width];
+  this->data = std::vector<std::uint64_t>((n + this->word_mask) >> this->word_bits, 0);
+}
+
+void
+CounterArray::atomicIncrement(size_type i, size_type val)
+{
+  std::uint64_t* word = this->data.data() + (i >> this->word_bits);
+  size_type shift = this->offset(i);
+  std::uint64_t old_word = __atomic_load_n(word, __ATOMIC_RELAXED);
+  while(true)
+  {
+    size_type value = (old_word >> shift) & this->large_value;
+    if(value == this->large_value)
+    {
+      std::lock_guard<std::mutex> lock(this->mtx);
+      this->largeValue(i) += val;
+      break;
+    }
+    if(value + val < this->large_value)
+    {
+      if(__atomic_compare_exchange_n(word, &old_word, old_word + (val << shift), true,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { break; }
+      continue;
+    }
+    // Claim the counter for the table. Other threads may add to the value in the table
+    // before we do, so both sides add instead of setting the value.
+    std::uint64_t new_word = old_word | (this->large_value << shift);
+    if(__atomic_compare_exchange_n(word, &old_word, new_word, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+      std::lock_guard<std::mutex> lock(this->mtx);
+      this->largeValue(i) += value + val;
+      break;
+    }
+  }
+  __atomic_fetch_add(&(this->total), val, __ATOMIC_RELAXED);
 }
 
 void
@@ -52,7 +534,8 @@ CounterArray::clear()
 {
   sdsl::util::clear(this->data);
   sdsl::util::clear(this->large_values);
-  this->total = 0;
+  this->elements = 0; this->total = 0;
+  this->large_count = 0; this->table_bits = 0;
 }
 
 void
@@ -61,11 +544,74 @@ CounterArray::swap(CounterArray& another)
   if(this != &another)
   {
     this->data.swap(another.data);
-    this->large_values.swap(another.large_values);
+    std::swap(this->elements, another.elements);
     std::swap(this->width, another.width);
+    std::swap(this->width_bits, another.width_bits);
+    std::swap(this->word_bits, another.word_bits);
+    std::swap(this->word_mask, another.word_mask);
     std::swap(this->large_value, another.large_value);
     std::swap(this->total, another.total);
+    this->large_values.swap(another.large_values);
+    std::swap(this->large_count, another.large_count);
+    std::swap(this->table_bits, another.table_bits);
+  }
+}
+
+size_type
+CounterArray::findLarge(size_type i) const
+{
+  if(this->large_count == 0) { return 0; }
+  size_type mask = this->large_values.size() - 1;
+  for(size_type cell = this->hash(i); ; cell = (cell + 1) & mask)
+  {
+    if(this->large_values[cell].first == i) { return this->large_values[cell].second; }
+    if(this->large_values[cell].first == EMPTY_CELL) { return 0; }
+  }
+}
+
+size_type&
+CounterArray::largeValue(size_type i)
+{
+  // Keep the load factor at most 1/2.
+  if(2 * (this->large_count + 1) > this->large_values.size())
+  {
+    std::vector<range_type> old_values;
+    old_values.swap(this->large_values);
+    this->table_bits = std::max(this->table_bits + 1, MIN_TABLE_BITS);
+    this->large_values = std::vector<range_type>(static_cast<size_type>(1) << this->table_bits,
+      range_type(EMPTY_CELL, 0));
+    size_type mask = this->large_values.size() - 1;
+    for(const range_type& entry : old_values)
+    {
+      if(entry.first == EMPTY_CELL) { continue; }
+      size_type cell = this->hash(entry.first);
+      while(this->large_values[cell].first != EMPTY_CELL) { cell = (cell + 1) & mask; }
+      this->large_values[cell] = entry;
+    }
+  }
+
+  size_type mask = this->large_values.size() - 1;
+  for(size_type cell = this->hash(i); ; cell = (cell + 1) & mask)
+  {
+    if(this->large_values[cell].first == i) { return this->large_values[cell].second; }
+    if(this->large_values[cell].first == EMPTY_CELL)
+    {
+      this->large_values[cell].first = i;
+      this->large_count++;
+      return this->large_values[cell].second;
+    }
+  }
+}
+
+void
+CounterArray::incrementLarge(size_type i, size_type value, size_type val)
+{
+  if(value < this->large_value)
+  {
+    this->data[i >> this->word_bits] |= this->large_value << this->offset(i);
+    val += value;
   }
+  this->largeValue(i) += val;
 }
 
 //------------------------------------------------------------------------------
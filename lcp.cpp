@@ -196,39 +196,62 @@ LCPArray::LCPArray(const InputGraph& graph, const ConstructionParameters& parame
     std::exit(EXIT_FAILURE);
   }
 
-  std::ifstream in(graph.lcp_name.c_str(), std::ios_base::binary);
+  sdsl::isfstream in(graph.lcp_name, std::ios_base::in | std::ios_base::binary);
   if(!in)
   {
     std::cerr << "LCPArray::LCPArray(): Cannot open LCP file " << graph.lcp_name << std::endl;
     std::exit(EXIT_FAILURE);
   }
 
-  this->header.branching = parameters.lcp_branching;
+  // Initialize data.
+  this->initialize(fileSize(in), parameters.lcp_branching);
+  DiskIO::read(in, (const uint8_t*)(this->data.data()), this->size());
+  in.close();
+  this->buildInternal();
+  sdsl::util::bit_compress(this->data);
 
-  // Determine the number of levels.
-  this->header.size = fileSize(in);
-  size_type level_count = 1, level_size = this->size();
-  while(level_size > 1)
+  if(Verbosity::level >= Verbosity::EXTENDED)
   {
-    level_count++; level_size = (level_size + this->branching() - 1) / this->branching();
+    double seconds = readTimer() - start;
+    std::cerr << "LCPArray::LCPArray(): Construction: " << seconds << " seconds, "
+              << inGigabytes(memoryUsage()) << " GB" << std::endl;
+  }
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "LCPArray::LCPArray(): " << this->values() << " values at " << this->levels()
+              << " levels (branching factor " << this->branching() << ")" << std::endl;
   }
+}
 
-  // Initialize offsets.
-  this->offsets = sdsl::int_vector<64>(level_count + 1, 0);
-  level_size = this->size();
-  size_type total_size = 0;
-  for(size_type level = 0; level < this->levels(); level++)
+LCPArray::LCPArray(size_type array_size, size_type branching_factor)
+{
+  if(array_size == 0) { return; }
+  this->initialize(array_size, branching_factor);
+}
+
+void
+LCPArray::setValue(size_type i, size_type value)
+{
+  // The values are bytes until finish() compresses the array.
+  this->data[i] = std::min(value, (size_type)(~(uint8_t)0));
+  for(size_type level = 0; level + 1 < this->levels(); level++)
   {
-    total_size += level_size;
-    this->offsets[level + 1] = total_size;
-    level_size = (level_size + this->branching() - 1) / this->branching();
+    size_type par = rmtParent(*this, i, level);
+    if(this->data[i] >= this->data[par]) { break; }
+    this->data[par] = this->data[i]; i = par;
   }
+}
 
-  // Initialize data.
-  this->data = sdsl::int_vector<0>(total_size, ~(uint8_t)0, 8);
-  DiskIO::read(in, (const uint8_t*)(this->data.data()), this->size());
-  in.close();
-  for(size_type level = 0; level < this->levels(); level++)
+void
+LCPArray::setLeaf(size_type i, size_type value)
+{
+  this->data[i] = std::min(value, (size_type)(~(uint8_t)0));
+}
+
+void
+LCPArray::buildInternal()
+{
+  for(size_type level = 0; level + 1 < this->levels(); level++)
   {
     for(size_type i = this->offsets[level]; i < this->offsets[level + 1]; i++)
     {
@@ -236,21 +259,48 @@ LCPArray::LCPArray(const InputGraph& graph, const ConstructionParameters& parame
       if(this->data[i] < this->data[par]) { this->data[par] = this->data[i]; }
     }
   }
+}
+
+void
+LCPArray::finish()
+{
+  if(this->size() == 0) { return; }
   sdsl::util::bit_compress(this->data);
 
-  if(Verbosity::level >= Verbosity::EXTENDED)
-  {
-    double seconds = readTimer() - start;
-    std::cerr << "LCPArray::LCPArray(): Construction: " << seconds << " seconds, "
-              << inGigabytes(memoryUsage()) << " GB" << std::endl;
-  }
   if(Verbosity::level >= Verbosity::BASIC)
   {
-    std::cerr << "LCPArray::LCPArray(): " << this->values() << " values at " << this->levels()
+    std::cerr << "LCPArray::finish(): " << this->values() << " values at " << this->levels()
               << " levels (branching factor " << this->branching() << ")" << std::endl;
   }
 }
 
+void
+LCPArray::initialize(size_type array_size, size_type branching_factor)
+{
+  this->header.branching = branching_factor;
+  this->header.size = array_size;
+
+  // Determine the number of levels.
+  size_type level_count = 1, level_size = this->size();
+  while(level_size > 1)
+  {
+    level_count++; level_size = (level_size + this->branching() - 1) / this->branching();
+  }
+
+  // Initialize offsets.
+  this->offsets = sdsl::int_vector<64>(level_count + 1, 0);
+  level_size = this->size();
+  size_type total_size = 0;
+  for(size_type level = 0; level < this->levels(); level++)
+  {
+    total_size += level_size;
+    this->offsets[level + 1] = total_size;
+    level_size = (level_size + this->branching() - 1) / this->branching();
+  }
+
+  this->data = sdsl::int_vector<0>(total_size, ~(uint8_t)0, 8);
+}
+
 //------------------------------------------------------------------------------
 
 LCPArray::node_type
@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2015 Genome Research Ltd.
+
+  Author: Jouni Siren <jouni.siren@iki.fi>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <string>
+#include <unistd.h>
+
+#include <gcsa/algorithms.h>
+
+using namespace gcsa;
+
+//------------------------------------------------------------------------------
+
+const size_type INDENT = 20;
+
+void loadIndex(const std::string& base_name, GCSA& index);
+
+//------------------------------------------------------------------------------
+
+int
+main(int argc, char** argv)
+{
+  if(argc < 4)
+  {
+    std::cerr << "Usage: merge_gcsa [options] base_name1 base_name2 output" << std::endl;
+    std::cerr << "  -b    Read the graphs for verification in binary format (default)" << std::endl;
+    std::cerr << "  -B N  Set LCP branching factor to N (default " << ConstructionParameters::LCP_BRANCHING << ")" << std::endl;
+    std::cerr << "  -m N  Limit the memory usage of refinement to N gigabytes (default " << ConstructionParameters::MEMORY_LIMIT << ")" << std::endl;
+    std::cerr << "  -t    Read the graphs for verification in text format" << std::endl;
+    std::cerr << "  -v    Verify the merged index by querying it with the kmers of both graphs" << std::endl;
+    std::cerr << "  -V N  Set verbosity level to N (default " << Verbosity::DEFAULT << ")" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "The inputs must be indexes of graphs with disjoint node ids. The path nodes of the" << std::endl;
+    std::cerr << "merged index may differ from those built from both graphs, but queries return the" << std::endl;
+    std::cerr << "same results. With -v, the graphs are read from the base names of the inputs." << std::endl;
+    std::cerr << std::endl;
+    std::exit(EXIT_SUCCESS);
+  }
+
+  int c = 0;
+  bool binary = true, verify = false;
+  ConstructionParameters parameters;
+  while((c = getopt(argc, argv, "bB:m:tvV:")) != -1)
+  {
+    switch(c)
+    {
+    case 'b':
+      binary = true; break;
+    case 'B':
+      parameters.setLCPBranching(std::stoul(optarg)); break;
+    case 'm':
+      parameters.setMemoryLimit(std::stoul(optarg)); break;
+    case 't':
+      binary = false; break;
+    case 'v':
+      verify = true; break;
+    case 'V':
+      Verbosity::set(std::stoul(optarg)); break;
+    case '?':
+      std::exit(EXIT_FAILURE);
+    default:
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if(optind + 3 != argc)
+  {
+    std::cerr << "merge_gcsa: Two inputs and an output must be specified" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string first_name = argv[optind], second_name = argv[optind + 1], output_name = argv[optind + 2];
+
+  std::cout << "GCSA merger" << std::endl;
+  std::cout << std::endl;
+  printHeader("Input", INDENT); std::cout << first_name << GCSA::EXTENSION << std::endl;
+  printHeader("Input", INDENT); std::cout << second_name << GCSA::EXTENSION << std::endl;
+  printHeader("Output", INDENT);
+  std::cout << output_name << GCSA::EXTENSION << ", " << output_name << LCPArray::EXTENSION << std::endl;
+  printHeader("Branching factor", INDENT); std::cout << parameters.lcp_branching << std::endl;
+  printHeader("Memory limit", INDENT); std::cout << inGigabytes(parameters.memory_limit) << " GB" << std::endl;
+  if(verify)
+  {
+    printHeader("Verification", INDENT);
+    if(binary) { std::cout << InputGraph::BINARY_EXTENSION << " (binary format)" << std::endl; }
+    else { std::cout << InputGraph::TEXT_EXTENSION << " (text format)" << std::endl; }
+  }
+  printHeader("Verbosity", INDENT); std::cout << Verbosity::levelName() << std::endl;
+  std::cout << std::endl;
+
+  GCSA first, second;
+  loadIndex(first_name, first);
+  loadIndex(second_name, second);
+
+  GCSA index;
+  LCPArray lcp;
+  {
+    double start = readTimer();
+    index = GCSA(first, second, parameters, &lcp);
+    double seconds = readTimer() - start;
+    std::cout << "Indexes merged in " << seconds << " seconds" << std::endl;
+    std::cout << "Memory usage: " << inGigabytes(memoryUsage()) << " GB" << std::endl;
+    std::cout << std::endl;
+    sdsl::store_to_file(index, output_name + GCSA::EXTENSION);
+    sdsl::store_to_file(lcp, output_name + LCPArray::EXTENSION);
+  }
+
+  printHeader("Paths"); std::cout << first.size() << " + " << second.size() << " -> " << index.size() << std::endl;
+  printHeader("Edges"); std::cout << index.edgeCount() << std::endl;
+  printHeader("Samples");
+  std::cout << index.sampleCount() << " (at " << index.sampledPositions() << " positions, "
+            << index.sampleBits() << " bits each)" << std::endl;
+  printHeader("Max query"); std::cout << index.order() << std::endl;
+  printHeader("Total size");
+  std::cout << inMegabytes(sdsl::size_in_bytes(index) + sdsl::size_in_bytes(lcp)) << " MB" << std::endl;
+  std::cout << std::endl;
+
+  // The merged index must answer queries like an index of the union graph.
+  if(verify)
+  {
+    InputGraph graph(2, argv + optind, binary);
+    if(!verifyIndex(index, &lcp, graph)) { std::exit(EXIT_FAILURE); }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void
+loadIndex(const std::string& base_name, GCSA& index)
+{
+  std::string index_name = base_name + GCSA::EXTENSION;
+  if(!sdsl::load_from_file(index, index_name))
+  {
+    std::cerr << "merge_gcsa: Cannot load the index from " << index_name << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -232,19 +232,39 @@ LCP::swap(LCP& another)
   this->kmer_lcp.swap(another.kmer_lcp);
 }
 
+size_type
+LCP::serialize(std::ostream& out, sdsl::structure_tree_node* v, std::string name) const
+{
+  sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+  size_type written_bytes = 0;
+  written_bytes += sdsl::write_member(this->kmer_length, out, child, "kmer_length");
+  written_bytes += sdsl::write_member(this->total_keys, out, child, "total_keys");
+  written_bytes += this->kmer_lcp.serialize(out, child, "kmer_lcp");
+  sdsl::structure_tree::add_size(child, written_bytes);
+  return written_bytes;
+}
+
+void
+LCP::load(std::istream& in)
+{
+  sdsl::read_member(this->kmer_length, in);
+  sdsl::read_member(this->total_keys, in);
+  this->kmer_lcp.load(in);
+}
+
 //------------------------------------------------------------------------------
 
 /*
   This structure combines a PathNode and its label. It also stores the identifier of
-  its source file.
+  its source file. LABEL_LENGTH must be at least the order of the paths.
 */
 
+template<size_type LABEL_LENGTH>
 struct PriorityNode
 {
-  typedef PathLabel::rank_type rank_type;
+  typedef PathNode::rank_type rank_type;
 
-  const static size_type LABEL_LENGTH = PathLabel::LABEL_LENGTH;
-  const static rank_type NO_RANK = PathLabel::NO_RANK;
+  const static rank_type NO_RANK = PathNode::NO_RANK;
 
   rank_type file;
   rank_type label[LABEL_LENGTH + 1];
@@ -268,6 +288,35 @@ struct PriorityNode
   inline size_type bytes() const { return this->node.bytes(); }
 };
 
+/*
+  Reads the path at the given offset into the PriorityNode and advances the offset. If the
+  offset has reached the limit, the PriorityNode is marked as the end of the file.
+*/
+template<class NodeType>
+inline void
+readPriorityNode(NodeType& path, ReadBuffer<PathNode>& path_file, ReadBuffer<PathNode::rank_type>& rank_file,
+  size_type& offset, size_type limit)
+{
+  if(offset >= limit)
+  {
+    path.node.setOrder(1);
+    path.node.setLCP(1);
+    path.label[0] = NodeType::NO_RANK;
+  }
+  else
+  {
+    path_file.seek(offset);
+    path.node = path_file[offset];
+    rank_file.seek(path.node.pointer());
+    for(size_type i = 0; i < path.node.ranks(); i++)
+    {
+      path.label[i] = rank_file[path.node.pointer() + i];
+    }
+    path.node.setPointer(0);  // Label is now stored in the PriorityNode.
+    offset++;
+  }
+}
+
 //------------------------------------------------------------------------------
 
 /*
@@ -281,32 +330,53 @@ struct PathGraphBuilder
   std::vector<WriteBuffer<PathNode>> path_files;
   std::vector<WriteBuffer<PathNode::rank_type>> rank_files;
   size_type limit;  // Bytes of disk space.
+  size_type memory_limit;  // Bytes of memory for buffers and sorting.
 
   const static size_type WRITE_BUFFER_SIZE = MEGABYTE;  // PathNodes per thread.
+  const static size_type MIN_BUFFER_SIZE = 1024;        // PathNodes per thread.
+  const static size_type MAX_RUNS = 64;                 // Merge at most this many runs at once.
 
-  PathGraphBuilder(size_type file_count, size_type path_order, size_type step, size_type size_limit);
+  PathGraphBuilder(size_type file_count, size_type path_order, size_type step, size_type size_limit,
+    size_type _memory_limit = ~(size_type)0);
+  void open(size_type file);
   void close();
 
   /*
     The file number is assumed to be valid.
     The first call is not thread safe, while the bulk write() is.
   */
-  void write(PriorityNode& path);
+  template<class NodeType> void write(NodeType& path);
   void write(std::vector<PathNode>& paths, std::vector<PathNode::rank_type>& labels, size_type file);
 
-  void sort(size_type file);
+  /*
+    Sorts the file in memory if it fits in the memory budget. Otherwise the file is sorted
+    with an external merge sort. The budget is further bounded by the memory limit of the
+    builder, as several files may be sorted at the same time.
+  */
+  void sort(size_type file, size_type budget);
+  void externalSort(size_type file, size_type budget);
+
+  // Memory required for sorting the given number of paths and ranks in memory.
+  inline static size_type sortBytes(size_type paths, size_type ranks)
+  {
+    return paths * (sizeof(PathNode) + 2 * sizeof(range_type)) + ranks * sizeof(PathNode::rank_type);
+  }
 };
 
-PathGraphBuilder::PathGraphBuilder(size_type file_count, size_type path_order, size_type step, size_type size_limit) :
+PathGraphBuilder::PathGraphBuilder(size_type file_count, size_type path_order, size_type step, size_type size_limit,
+  size_type _memory_limit) :
   graph(file_count, path_order, step),
   path_files(file_count), rank_files(file_count),
-  limit(size_limit)
+  limit(size_limit), memory_limit(_memory_limit)
 {
-  for(size_type file = 0; file < file_count; file++)
-  {
-    this->path_files[file].open(this->graph.path_names[file]);
-    this->rank_files[file].open(this->graph.rank_names[file]);
-  }
+  for(size_type file = 0; file < file_count; file++) { this->open(file); }
+}
+
+void
+PathGraphBuilder::open(size_type file)
+{
+  this->path_files[file].open(this->graph.path_names[file], MEGABYTE, PathGraph::COMPRESSED);
+  this->rank_files[file].open(this->graph.rank_names[file], MEGABYTE, PathGraph::COMPRESSED);
 }
 
 void
@@ -332,8 +402,9 @@ writePath(PathNode& path, const PathNode::rank_type* labels,
   for(size_type i = old_ptr; i < limit; i++) { rank_file.push_back(labels[i]); }
 }
 
+template<class NodeType>
 void
-PathGraphBuilder::write(PriorityNode& path)
+PathGraphBuilder::write(NodeType& path)
 {
   if(this->graph.bytes() + path.bytes() > this->limit)
   {
@@ -368,24 +439,182 @@ PathGraphBuilder::write(std::vector<PathNode>& paths, std::vector<PathNode::rank
   paths.clear(); labels.clear();
 }
 
+// Compares (key, index) pairs by the first labels of paths[index].
+struct PathIndexComparator
+{
+  const std::vector<PathNode>& paths;
+  PathFirstComparator          first_c;
+
+  PathIndexComparator(const std::vector<PathNode>& _paths, const std::vector<PathNode::rank_type>& labels) :
+    paths(_paths), first_c(labels)
+  {
+  }
+
+  inline bool operator() (const range_type& a, const range_type& b) const
+  {
+    return this->first_c(this->paths[a.second], this->paths[b.second]);
+  }
+};
+
+/*
+  Pack as many first ranks of each label as fit into a 64-bit key. Rank r is stored as
+  r + 1, leaving 0 for missing ranks, so that the keys sort like the labels. Then sort
+  the (key, index) pairs and use the full labels only for the paths with equal keys.
+*/
 void
-PathGraphBuilder::sort(size_type file)
+sortPaths(const std::vector<PathNode>& paths, const std::vector<PathNode::rank_type>& labels,
+  std::vector<range_type>& keys)
 {
-  this->path_files[file].close();
-  this->rank_files[file].close();
+  keys.resize(paths.size());
+  {
+    PathNode::rank_type max_rank = 0;
+    #pragma omp parallel for schedule(static) reduction(max:max_rank)
+    for(size_type i = 0; i < labels.size(); i++) { max_rank = std::max(max_rank, labels[i]); }
+    size_type max_order = 0;
+    #pragma omp parallel for schedule(static) reduction(max:max_order)
+    for(size_type i = 0; i < paths.size(); i++) { max_order = std::max(max_order, paths[i].order()); }
+    size_type rank_bits = bit_length(static_cast<size_type>(max_rank) + 1);
+    size_type prefix_length = std::max(std::min(WORD_BITS / rank_bits, max_order), (size_type)1);
 
-  std::vector<PathNode> paths;
-  std::vector<PathNode::rank_type> labels;
-  this->graph.read(paths, labels, file);
+    #pragma omp parallel for schedule(static)
+    for(size_type i = 0; i < paths.size(); i++)
+    {
+      size_type key = 0;
+      for(size_type j = 0; j < prefix_length; j++)
+      {
+        key <<= rank_bits;
+        if(j < paths[i].order()) { key |= static_cast<size_type>(paths[i].firstLabel(j, labels)) + 1; }
+      }
+      keys[i] = range_type(key, i);
+    }
+    parallelRadixSort(keys, prefix_length * rank_bits);
+  }
 
-  PathFirstComparator first_c(labels);
-  parallelQuickSort(paths.begin(), paths.end(), first_c);
+  std::vector<range_type> ties;
+  for(size_type i = 0, j = 1; i < keys.size(); i = j, j = i + 1)
+  {
+    while(j < keys.size() && keys[j].first == keys[i].first) { j++; }
+    if(j - i > 1) { ties.push_back(range_type(i, j)); }
+  }
+  PathIndexComparator index_c(paths, labels);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type i = 0; i < ties.size(); i++)
+  {
+    sequentialSort(keys.begin() + ties[i].first, keys.begin() + ties[i].second, index_c);
+  }
+}
 
-  this->path_files[file].open(this->graph.path_names[file]);
-  this->rank_files[file].open(this->graph.rank_names[file]);
+/*
+  Reads the next count paths and their labels from the files, starting from the given
+  offsets, and advances the offsets. The pointers are adjusted to refer to the labels vector.
+*/
+void
+readPaths(ElementFile<PathNode>& path_file, ElementFile<PathNode::rank_type>& rank_file,
+  size_type& path_offset, size_type& rank_offset, size_type count,
+  std::vector<PathNode>& paths, std::vector<PathNode::rank_type>& labels)
+{
+  paths.resize(count);
+  path_file.read(path_offset, paths.data(), paths.size());
+  path_offset += paths.size();
+  size_type rank_count = 0;
   for(size_type i = 0; i < paths.size(); i++)
   {
-    writePath(paths[i], labels.data(), this->path_files[file], this->rank_files[file]);
+    paths[i].setPointer(rank_count); rank_count += paths[i].ranks();
+  }
+  labels.resize(rank_count);
+  rank_file.read(rank_offset, labels.data(), labels.size());
+  rank_offset += labels.size();
+}
+
+/*
+  Merges sorted runs [first, last) into the output files and removes the runs.
+*/
+template<size_type LABEL_LENGTH>
+void
+mergeRuns(std::vector<std::string>& path_names, std::vector<std::string>& rank_names,
+  size_type first, size_type last, size_type path_buffer_size, size_type rank_buffer_size,
+  WriteBuffer<PathNode>& path_file, WriteBuffer<PathNode::rank_type>& rank_file)
+{
+  size_type runs = last - first;
+  std::vector<ReadBuffer<PathNode>> run_path_files(runs);
+  std::vector<ReadBuffer<PathNode::rank_type>> run_rank_files(runs);
+  std::vector<size_type> offsets(runs, 0);
+  PriorityQueue<PriorityNode<LABEL_LENGTH>> inputs(runs);
+  for(size_type run = 0; run < runs; run++)
+  {
+    run_path_files[run].open(path_names[first + run], 0, path_buffer_size, PathGraph::COMPRESSED);
+    run_rank_files[run].open(rank_names[first + run], 0, rank_buffer_size, PathGraph::COMPRESSED);
+    inputs[run].file = run;
+    readPriorityNode(inputs[run], run_path_files[run], run_rank_files[run], offsets[run], run_path_files[run].size());
+  }
+  inputs.heapify();
+
+  while(!(inputs[0].eof()))
+  {
+    writePath(inputs[0].node, inputs[0].label, path_file, rank_file);
+    size_type run = inputs[0].file;
+    readPriorityNode(inputs[0], run_path_files[run], run_rank_files[run], offsets[run], run_path_files[run].size());
+    inputs.down(0);
+  }
+
+  for(size_type run = 0; run < runs; run++)
+  {
+    run_path_files[run].close(); run_rank_files[run].close();
+    TempFile::remove(path_names[first + run]); TempFile::remove(rank_names[first + run]);
+  }
+}
+
+/*
+  Chooses the label length for paths after the given number of doubling steps.
+*/
+void
+mergeRuns(size_type steps, std::vector<std::string>& path_names, std::vector<std::string>& rank_names,
+  size_type first, size_type last, size_type path_buffer_size, size_type rank_buffer_size,
+  WriteBuffer<PathNode>& path_file, WriteBuffer<PathNode::rank_type>& rank_file)
+{
+  switch(steps)
+  {
+    case 0:
+      mergeRuns<1>(path_names, rank_names, first, last, path_buffer_size, rank_buffer_size, path_file, rank_file); break;
+    case 1:
+      mergeRuns<2>(path_names, rank_names, first, last, path_buffer_size, rank_buffer_size, path_file, rank_file); break;
+    case 2:
+      mergeRuns<4>(path_names, rank_names, first, last, path_buffer_size, rank_buffer_size, path_file, rank_file); break;
+    case 3:
+      mergeRuns<8>(path_names, rank_names, first, last, path_buffer_size, rank_buffer_size, path_file, rank_file); break;
+    case 4:
+      mergeRuns<16>(path_names, rank_names, first, last, path_buffer_size, rank_buffer_size, path_file, rank_file); break;
+    default:
+      std::cerr << "mergeRuns(): Invalid number of doubling steps: " << steps << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+}
+
+void
+PathGraphBuilder::sort(size_type file, size_type budget)
+{
+  this->path_files[file].close();
+  this->rank_files[file].close();
+
+  budget = std::min(budget, this->memory_limit);
+  if(sortBytes(this->graph.path_counts[file], this->graph.rank_counts[file]) > budget)
+  {
+    this->externalSort(file, budget);
+  }
+  else
+  {
+    std::vector<PathNode> paths;
+    std::vector<PathNode::rank_type> labels;
+    this->graph.read(paths, labels, file);
+
+    std::vector<range_type> keys;
+    sortPaths(paths, labels, keys);
+
+    this->open(file);
+    for(size_type i = 0; i < keys.size(); i++)
+    {
+      writePath(paths[keys[i].second], labels.data(), this->path_files[file], this->rank_files[file]);
+    }
   }
 
   if(Verbosity::level >= Verbosity::FULL)
@@ -395,10 +624,347 @@ PathGraphBuilder::sort(size_type file)
   }
 }
 
+void
+PathGraphBuilder::externalSort(size_type file, size_type budget)
+{
+  size_type path_count = this->graph.path_counts[file];
+  size_type bytes_per_path = sortBytes(path_count, this->graph.rank_counts[file]) / path_count + 1;
+  size_type ranks_per_path = this->graph.rank_counts[file] / path_count + 1;
+
+  // Form the runs. There are two runs in memory at the same time.
+  size_type run_size = std::max(budget / (2 * bytes_per_path), (size_type)1);
+  std::vector<std::string> path_names, rank_names;
+  {
+    ElementFile<PathNode> path_file;
+    ElementFile<PathNode::rank_type> rank_file;
+    this->graph.open(path_file, rank_file, file);
+    std::vector<PathNode> paths, next_paths;
+    std::vector<PathNode::rank_type> labels, next_labels;
+    size_type path_offset = 0, rank_offset = 0;
+    readPaths(path_file, rank_file, path_offset, rank_offset, std::min(run_size, path_count), paths, labels);
+    while(!(paths.empty()))
+    {
+      std::thread reader(readPaths, std::ref(path_file), std::ref(rank_file), std::ref(path_offset),
+        std::ref(rank_offset), std::min(run_size, path_count - path_offset),
+        std::ref(next_paths), std::ref(next_labels));
+
+      std::vector<range_type> keys;
+      sortPaths(paths, labels, keys);
+      path_names.push_back(TempFile::getName(PathGraph::PREFIX));
+      rank_names.push_back(TempFile::getName(PathGraph::PREFIX));
+      WriteBuffer<PathNode> run_path_file(path_names.back(), MEGABYTE, PathGraph::COMPRESSED);
+      WriteBuffer<PathNode::rank_type> run_rank_file(rank_names.back(), MEGABYTE, PathGraph::COMPRESSED);
+      for(size_type i = 0; i < keys.size(); i++)
+      {
+        writePath(paths[keys[i].second], labels.data(), run_path_file, run_rank_file);
+      }
+      run_path_file.close(); run_rank_file.close();
+
+      reader.join();
+      paths.swap(next_paths); labels.swap(next_labels);
+    }
+    path_file.close(); rank_file.close();
+  }
+
+  /*
+    Merge the runs, at most MAX_RUNS at a time, until there are few enough runs left for the
+    final merge. Each run gets a share of the budget for its buffers.
+  */
+  size_type runs = path_names.size(), max_runs = MAX_RUNS, passes = 1;
+  size_type buffer_size = Range::bound(budget / (4 * std::min(runs, max_runs) * bytes_per_path),
+    1, ReadBuffer<PathNode>::READ_BUFFER_SIZE);
+  while(path_names.size() > max_runs)
+  {
+    std::vector<std::string> next_path_names, next_rank_names;
+    for(size_type first = 0; first < path_names.size(); first += max_runs)
+    {
+      next_path_names.push_back(TempFile::getName(PathGraph::PREFIX));
+      next_rank_names.push_back(TempFile::getName(PathGraph::PREFIX));
+      WriteBuffer<PathNode> run_path_file(next_path_names.back(), MEGABYTE, PathGraph::COMPRESSED);
+      WriteBuffer<PathNode::rank_type> run_rank_file(next_rank_names.back(), MEGABYTE, PathGraph::COMPRESSED);
+      mergeRuns(this->graph.step(), path_names, rank_names, first, std::min(first + max_runs, path_names.size()),
+        buffer_size, buffer_size * ranks_per_path, run_path_file, run_rank_file);
+    }
+    path_names.swap(next_path_names); rank_names.swap(next_rank_names);
+    passes++;
+  }
+  this->open(file);
+  mergeRuns(this->graph.step(), path_names, rank_names, 0, path_names.size(),
+    buffer_size, buffer_size * ranks_per_path, this->path_files[file], this->rank_files[file]);
+
+  if(Verbosity::level >= Verbosity::FULL)
+  {
+    std::cerr << "PathGraphBuilder::externalSort(): File " << file << ": Merged " << runs
+              << " runs of up to " << run_size << " paths in " << passes << " pass(es)" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+/*
+  The merge can be partitioned into ranges that are processed independently. A range is
+  defined by semiopen ranges of offsets [start, limit) in each file. The last path before
+  the range and the first path after it are needed for the LCP values at the borders.
+
+  A merged range of paths corresponds to a suffix tree node with the same from nodes in
+  all leaves. If the suffix tree node corresponding to the LCA of the paths on both sides
+  of a border has leaves with different sets of from nodes, no merged range can cross
+  the border.
+*/
+
+template<size_type LABEL_LENGTH>
+struct MergeRange
+{
+  std::vector<size_type>       start, limit;
+  bool                         has_prev, has_next;
+  PriorityNode<LABEL_LENGTH>   prev, next;
+
+  // Do not partition the merge into ranges shorter than this.
+  const static size_type MINIMUM_SIZE = MEGABYTE;
+
+  // Try this many borders for each cut and scan this many groups of paths for each border.
+  const static size_type MAX_ATTEMPTS = 16;
+  const static size_type MAX_GROUPS = 64;
+
+  explicit MergeRange(const PathGraph& graph) :
+    start(graph.files(), 0), limit(graph.path_counts),
+    has_prev(false), has_next(false), prev(), next()
+  {
+  }
+
+  inline size_type size() const
+  {
+    size_type result = 0;
+    for(size_type file = 0; file < this->start.size(); file++) { result += this->limit[file] - this->start[file]; }
+    return result;
+  }
+};
+
+/*
+  Random access to the paths in a PathGraph.
+*/
+
+template<size_type LABEL_LENGTH>
+struct PathGraphFiles
+{
+  const PathGraph&                              graph;
+  const LCP&                                    lcp;
+  std::vector<ElementFile<PathNode>>            path_files;
+  std::vector<ElementFile<PathNode::rank_type>> rank_files;
+
+  PathGraphFiles(const PathGraph& path_graph, const LCP& kmer_lcp);
+
+  void read(PriorityNode<LABEL_LENGTH>& path, size_type file, size_type offset);
+
+  // The first offset in the file that is not before the path.
+  size_type lowerBound(const PriorityNode<LABEL_LENGTH>& path, size_type file);
+
+  /*
+    Move the offsets past the next/previous group of paths with the same label. Store
+    a path from the group and the set of from nodes in the group. Return false if there
+    are no more paths.
+  */
+  bool nextGroup(std::vector<size_type>& offsets, PriorityNode<LABEL_LENGTH>& path, std::vector<node_type>& from);
+  bool prevGroup(std::vector<size_type>& offsets, PriorityNode<LABEL_LENGTH>& path, std::vector<node_type>& from);
+
+  /*
+    Moves the cut forward until it is at a safe border. Stores the paths on both sides of
+    the cut in prev and next. Returns false if no suitable cut was found.
+  */
+  bool adjustCut(std::vector<size_type>& cut, PriorityNode<LABEL_LENGTH>& prev, PriorityNode<LABEL_LENGTH>& next);
+};
+
+template<size_type LABEL_LENGTH>
+PathGraphFiles<LABEL_LENGTH>::PathGraphFiles(const PathGraph& path_graph, const LCP& kmer_lcp) :
+  graph(path_graph), lcp(kmer_lcp),
+  path_files(path_graph.files()), rank_files(path_graph.files())
+{
+  for(size_type file = 0; file < this->graph.files(); file++)
+  {
+    this->graph.open(this->path_files[file], this->rank_files[file], file);
+  }
+}
+
+template<size_type LABEL_LENGTH>
+void
+PathGraphFiles<LABEL_LENGTH>::read(PriorityNode<LABEL_LENGTH>& path, size_type file, size_type offset)
+{
+  path.file = file;
+  this->path_files[file].read(offset, &(path.node), 1);
+  this->rank_files[file].read(path.node.pointer(), path.label, path.node.ranks());
+  path.node.setPointer(0);  // Label is now stored in the PriorityNode.
+}
+
+template<size_type LABEL_LENGTH>
+size_type
+PathGraphFiles<LABEL_LENGTH>::lowerBound(const PriorityNode<LABEL_LENGTH>& path, size_type file)
+{
+  PriorityNode<LABEL_LENGTH> temp;
+  size_type low = 0, high = this->graph.path_counts[file];
+  while(low < high)
+  {
+    size_type mid = low + (high - low) / 2;
+    this->read(temp, file, mid);
+    if(temp < path) { low = mid + 1; }
+    else { high = mid; }
+  }
+  return low;
+}
+
+template<size_type LABEL_LENGTH>
+bool
+PathGraphFiles<LABEL_LENGTH>::nextGroup(std::vector<size_type>& offsets, PriorityNode<LABEL_LENGTH>& path, std::vector<node_type>& from)
+{
+  PriorityNode<LABEL_LENGTH> temp;
+  bool found = false;
+  for(size_type file = 0; file < offsets.size(); file++)
+  {
+    if(offsets[file] >= this->graph.path_counts[file]) { continue; }
+    this->read(temp, file, offsets[file]);
+    if(!found || temp < path) { path = temp; found = true; }
+  }
+  if(!found) { return false; }
+
+  from.clear();
+  for(size_type file = 0; file < offsets.size(); file++)
+  {
+    while(offsets[file] < this->graph.path_counts[file])
+    {
+      this->read(temp, file, offsets[file]);
+      if(path < temp) { break; }
+      from.push_back(temp.node.from); offsets[file]++;
+    }
+  }
+  removeDuplicates(from, false);
+  return true;
+}
+
+template<size_type LABEL_LENGTH>
+bool
+PathGraphFiles<LABEL_LENGTH>::prevGroup(std::vector<size_type>& offsets, PriorityNode<LABEL_LENGTH>& path, std::vector<node_type>& from)
+{
+  PriorityNode<LABEL_LENGTH> temp;
+  bool found = false;
+  for(size_type file = 0; file < offsets.size(); file++)
+  {
+    if(offsets[file] == 0) { continue; }
+    this->read(temp, file, offsets[file] - 1);
+    if(!found || path < temp) { path = temp; found = true; }
+  }
+  if(!found) { return false; }
+
+  from.clear();
+  for(size_type file = 0; file < offsets.size(); file++)
+  {
+    while(offsets[file] > 0)
+    {
+      this->read(temp, file, offsets[file] - 1);
+      if(temp < path) { break; }
+      from.push_back(temp.node.from); offsets[file]--;
+    }
+  }
+  removeDuplicates(from, false);
+  return true;
+}
+
+template<size_type LABEL_LENGTH>
+bool
+PathGraphFiles<LABEL_LENGTH>::adjustCut(std::vector<size_type>& cut, PriorityNode<LABEL_LENGTH>& prev, PriorityNode<LABEL_LENGTH>& next)
+{
+  PriorityNode<LABEL_LENGTH> temp, last;
+  std::vector<size_type> left, right, next_cut;
+  std::vector<node_type> reference, from;
+
+  for(size_type attempt = 0; attempt < MergeRange<LABEL_LENGTH>::MAX_ATTEMPTS; attempt++)
+  {
+    // The groups on both sides of the cut.
+    left = cut; right = cut;
+    if(!(this->prevGroup(left, prev, reference)) || !(this->nextGroup(right, next, from))) { return false; }
+    next_cut = right;
+    range_type border = this->lcp.max_lcp(prev.node, next.node, prev.label, next.label);
+    bool safe = (from != reference);
+
+    // Scan the leaves of the suffix tree node corresponding to the LCA.
+    last = next;
+    for(size_type i = 0; !safe && i < MergeRange<LABEL_LENGTH>::MAX_GROUPS; i++)
+    {
+      if(!(this->nextGroup(right, temp, from))) { break; }
+      if(this->lcp.max_lcp(last.node, temp.node, last.label, temp.label) < border) { break; }
+      safe = (from != reference); last = temp;
+    }
+    last = prev;
+    for(size_type i = 0; !safe && i < MergeRange<LABEL_LENGTH>::MAX_GROUPS; i++)
+    {
+      if(!(this->prevGroup(left, temp, from))) { break; }
+      if(this->lcp.max_lcp(temp.node, last.node, temp.label, last.label) < border) { break; }
+      safe = (from != reference); last = temp;
+    }
+    if(safe) { return true; }
+
+    cut = next_cut;
+  }
+
+  return false;
+}
+
+template<size_type LABEL_LENGTH>
+std::vector<MergeRange<LABEL_LENGTH>>
+partitionMerge(const PathGraph& graph, const LCP& lcp)
+{
+  std::vector<MergeRange<LABEL_LENGTH>> result;
+  MergeRange<LABEL_LENGTH> curr(graph);
+  size_type parts = std::min((size_type)omp_get_max_threads(), graph.size() / MergeRange<LABEL_LENGTH>::MINIMUM_SIZE);
+  if(parts <= 1 || graph.files() == 0) { result.push_back(curr); return result; }
+
+  // Sample the splitters.
+  PathGraphFiles<LABEL_LENGTH> files(graph, lcp);
+  std::vector<PriorityNode<LABEL_LENGTH>> samples;
+  for(size_type file = 0; file < graph.files(); file++)
+  {
+    for(size_type i = 1; i < parts; i++)
+    {
+      size_type offset = (i * graph.path_counts[file]) / parts;
+      if(offset >= graph.path_counts[file]) { continue; }
+      samples.push_back(PriorityNode<LABEL_LENGTH>());
+      files.read(samples.back(), file, offset);
+    }
+  }
+  if(samples.empty()) { result.push_back(curr); return result; }
+  sequentialSort(samples.begin(), samples.end());
+
+  // Find the cuts.
+  std::vector<size_type> cut(graph.files());
+  for(size_type i = 1; i < parts; i++)
+  {
+    const PriorityNode<LABEL_LENGTH>& splitter = samples[(i * samples.size()) / parts];
+    for(size_type file = 0; file < graph.files(); file++) { cut[file] = files.lowerBound(splitter, file); }
+    PriorityNode<LABEL_LENGTH> prev, next;
+    if(!(files.adjustCut(cut, prev, next))) { continue; }
+
+    // The cut must be after the previous one.
+    bool valid = true; size_type length = 0;
+    for(size_type file = 0; file < graph.files(); file++)
+    {
+      if(cut[file] < curr.start[file]) { valid = false; break; }
+      length += cut[file] - curr.start[file];
+    }
+    if(!valid || length == 0) { continue; }
+
+    curr.limit = cut; curr.has_next = true; curr.next = next;
+    result.push_back(curr);
+    curr.start = cut; curr.limit = graph.path_counts;
+    curr.has_prev = true; curr.prev = prev; curr.has_next = false;
+  }
+  result.push_back(curr);
+
+  return result;
+}
+
 //------------------------------------------------------------------------------
 
-struct PathGraphMerger;
+template<size_type LABEL_LENGTH> struct PathGraphMerger;
 
+template<size_type LABEL_LENGTH>
 struct PathRange
 {
   size_type  from, to;
@@ -407,7 +973,7 @@ struct PathRange
   inline range_type range() const { return range_type(this->from, this->to); }
   inline size_type length() const { return this->to + 1 - this->from; }
 
-  PathRange(size_type start, size_type stop, range_type _left_lcp, PathGraphMerger& merger);
+  PathRange(size_type start, size_type stop, range_type _left_lcp, PathGraphMerger<LABEL_LENGTH>& merger);
 };
 
 /*
@@ -415,25 +981,29 @@ struct PathRange
   stream of ranges of PriorityNodes with the same label.
 */
 
+template<size_type LABEL_LENGTH>
 struct PathGraphMerger
 {
   const PathGraph&                              graph;
   const LCP&                                    lcp;
+  const MergeRange<LABEL_LENGTH>&               bounds;
+  size_type                                     total;
 
   // Buffers.
-  std::deque<PathRange>                         ranges;
-  BufferWindow<PriorityNode>                    buffer;
+  std::deque<PathRange<LABEL_LENGTH>>           ranges;
+  BufferWindow<PriorityNode<LABEL_LENGTH>>      buffer;
 
   // Priority queue.
   std::vector<ReadBuffer<PathNode>>             path_files;
   std::vector<ReadBuffer<PathNode::rank_type>>  rank_files;
   std::vector<size_type>                        offsets;
-  PriorityQueue<PriorityNode>                   inputs;
+  PriorityQueue<PriorityNode<LABEL_LENGTH>>     inputs;
 
-  PathGraphMerger(const PathGraph& path_graph, const LCP& kmer_lcp);
+  PathGraphMerger(const PathGraph& path_graph, const LCP& kmer_lcp, const MergeRange<LABEL_LENGTH>& range,
+    size_type buffer_size);
   void close();
 
-  inline size_type size() const { return this->graph.size(); }
+  inline size_type size() const { return this->total; }
 
   /*
     Iterates through ranges of paths with the same label.
@@ -471,30 +1041,38 @@ struct PathGraphMerger
   // Find the rightmost path with the same label.
   size_type rangeEnd(size_type start);
 
-  // Add the next PriorityNode to buffer.
+  // Add the next PriorityNode<LABEL_LENGTH> to buffer.
   void bufferNext();
 
-  // Read the next PriorityNode from the file.
-  void read(PriorityNode& path);
+  // Read the next PriorityNode<LABEL_LENGTH> from the file.
+  void read(PriorityNode<LABEL_LENGTH>& path);
 };
 
-PathGraphMerger::PathGraphMerger(const PathGraph& path_graph, const LCP& kmer_lcp) :
-  graph(path_graph), lcp(kmer_lcp),
+template<size_type LABEL_LENGTH>
+PathGraphMerger<LABEL_LENGTH>::PathGraphMerger(const PathGraph& path_graph, const LCP& kmer_lcp,
+  const MergeRange<LABEL_LENGTH>& range, size_type buffer_size) :
+  graph(path_graph), lcp(kmer_lcp), bounds(range), total(range.size()),
   path_files(path_graph.files()), rank_files(path_graph.files()),
   offsets(path_graph.files()), inputs(path_graph.files())
 {
   for(size_type file = 0; file < path_graph.files(); file++)
   {
-    this->path_files[file].open(path_graph.path_names[file]);
-    this->rank_files[file].open(path_graph.rank_names[file]);
-    this->offsets[file] = 0;
+    this->offsets[file] = range.start[file];
+    this->path_files[file].open(path_graph.path_names[file], this->offsets[file], buffer_size, PathGraph::COMPRESSED);
+    size_type rank_offset = 0;
+    if(this->offsets[file] < range.limit[file])
+    {
+      rank_offset = this->path_files[file][this->offsets[file]].pointer();
+    }
+    this->rank_files[file].open(path_graph.rank_names[file], rank_offset, buffer_size, PathGraph::COMPRESSED);
     this->inputs[file].file = file; this->read(this->inputs[file]);
   }
   this->inputs.heapify();
 }
 
+template<size_type LABEL_LENGTH>
 void
-PathGraphMerger::close()
+PathGraphMerger<LABEL_LENGTH>::close()
 {
   sdsl::util::clear(this->ranges);
   sdsl::util::clear(this->buffer);
@@ -510,8 +1088,9 @@ PathGraphMerger::close()
   this->inputs.clear();
 }
 
+template<size_type LABEL_LENGTH>
 range_type
-PathGraphMerger::first()
+PathGraphMerger<LABEL_LENGTH>::first()
 {
   if(this->buffer.offset > 0)
   {
@@ -520,28 +1099,37 @@ PathGraphMerger::first()
   }
   this->ranges.clear();
 
-  this->ranges.push_back(PathRange(0, this->rangeEnd(0), range_type(0, 0), *this));
+  size_type stop = this->rangeEnd(0);
+  range_type left_lcp(0, 0);
+  if(this->bounds.has_prev && this->size() > 0)
+  {
+    left_lcp = this->lcp.max_lcp(this->bounds.prev.node, this->buffer[0].node,
+      this->bounds.prev.label, this->buffer[0].label);
+  }
+  this->ranges.push_back(PathRange<LABEL_LENGTH>(0, stop, left_lcp, *this));
   return this->ranges.front().range();
 }
 
+template<size_type LABEL_LENGTH>
 range_type
-PathGraphMerger::next()
+PathGraphMerger<LABEL_LENGTH>::next()
 {
-  PathRange temp = this->ranges.front(); this->ranges.pop_front();
+  PathRange<LABEL_LENGTH> temp = this->ranges.front(); this->ranges.pop_front();
   if(this->ranges.empty())
   {
     this->ranges.push_back(
-      PathRange(temp.to + 1, this->rangeEnd(temp.to + 1), temp.right_lcp, *this));
+      PathRange<LABEL_LENGTH>(temp.to + 1, this->rangeEnd(temp.to + 1), temp.right_lcp, *this));
   }
   this->buffer.seek(this->ranges.front().from);
   return this->ranges.front().range();
 }
 
+template<size_type LABEL_LENGTH>
 template<class FromComparator>
 range_type
-PathGraphMerger::extendRange(FromComparator& comp)
+PathGraphMerger<LABEL_LENGTH>::extendRange(FromComparator& comp)
 {
-  PathRange range = this->ranges.front();
+  PathRange<LABEL_LENGTH> range = this->ranges.front();
   size_type curr = 1;
   range_type parent_lcp = range.range_lcp;
 
@@ -550,10 +1138,10 @@ PathGraphMerger::extendRange(FromComparator& comp)
     // Find the next range.
     if(curr >= this->ranges.size())
     {
-      const PathRange& temp = this->ranges.back();
-      this->ranges.push_back(PathRange(temp.to + 1, this->rangeEnd(temp.to + 1), temp.right_lcp, *this));
+      const PathRange<LABEL_LENGTH>& temp = this->ranges.back();
+      this->ranges.push_back(PathRange<LABEL_LENGTH>(temp.to + 1, this->rangeEnd(temp.to + 1), temp.right_lcp, *this));
     }
-    const PathRange& next_range = this->ranges[curr];
+    const PathRange<LABEL_LENGTH>& next_range = this->ranges[curr];
     if(next_range.from >= this->size()) { break; }
 
     // Is this a suffix tree node with the same from nodes as range and lcp > range.left_lcp?
@@ -572,10 +1160,11 @@ PathGraphMerger::extendRange(FromComparator& comp)
   return range.range();
 }
 
+template<size_type LABEL_LENGTH>
 void
-PathGraphMerger::mergePathNodes()
+PathGraphMerger<LABEL_LENGTH>::mergePathNodes()
 {
-  PathRange& range = this->ranges.front();
+  PathRange<LABEL_LENGTH>& range = this->ranges.front();
   if(range.length() == 1)
   {
     this->buffer[range.to].node.makeSorted();
@@ -601,8 +1190,9 @@ PathGraphMerger::mergePathNodes()
   }
 }
 
+template<size_type LABEL_LENGTH>
 size_type
-PathGraphMerger::rangeEnd(size_type start)
+PathGraphMerger<LABEL_LENGTH>::rangeEnd(size_type start)
 {
   if(!(this->buffer.buffered(start))) { this->bufferNext(); }
 
@@ -616,38 +1206,38 @@ PathGraphMerger::rangeEnd(size_type start)
   return stop;
 }
 
+template<size_type LABEL_LENGTH>
 void
-PathGraphMerger::bufferNext()
+PathGraphMerger<LABEL_LENGTH>::bufferNext()
 {
   this->buffer.push_back(this->inputs[0]);  // Add to the buffer.
   this->read(this->inputs[0]);  // Read the next.
   this->inputs.down(0); // Restore heap order.
 }
 
+template<size_type LABEL_LENGTH>
 void
-PathGraphMerger::read(PriorityNode& path)
+PathGraphMerger<LABEL_LENGTH>::read(PriorityNode<LABEL_LENGTH>& path)
 {
-  if(this->offsets[path.file] >= this->graph.path_counts[path.file])
-  {
-    path.node.setOrder(1);
-    path.node.setLCP(1);
-    path.label[0] = PriorityNode::NO_RANK;
-  }
-  else
-  {
-    this->path_files[path.file].seek(this->offsets[path.file]);
-    path.node = this->path_files[path.file][this->offsets[path.file]];
-    this->rank_files[path.file].seek(path.node.pointer());
-    for(size_type i = 0; i < path.node.ranks(); i++)
-    {
-      path.label[i] = this->rank_files[path.file][path.node.pointer() + i];
-    }
-    path.node.setPointer(0);  // Label is now stored in the PriorityNode.
-    this->offsets[path.file]++;
-  }
+  readPriorityNode(path, this->path_files[path.file], this->rank_files[path.file],
+    this->offsets[path.file], this->bounds.limit[path.file]);
+}
+
+/*
+  Buffer size per file for each of the parallel PathGraphMergers. The buffers may use a
+  quarter of the memory limit. ReadBuffer may hold two buffers for each file.
+*/
+size_type
+mergerBufferSize(const PathGraph& graph, size_type ranges, size_type memory_limit)
+{
+  size_type bytes_per_path = 2 * (sizeof(PathNode) + sizeof(PathNode::rank_type));
+  size_type buffer_size = memory_limit / (4 * bytes_per_path * graph.files() * ranges);
+  return Range::bound(buffer_size, 1, ReadBuffer<PathNode>::READ_BUFFER_SIZE / ranges);
 }
 
-PathRange::PathRange(size_type start, size_type stop, range_type _left_lcp, PathGraphMerger& merger) :
+template<size_type LABEL_LENGTH>
+PathRange<LABEL_LENGTH>::PathRange(size_type start, size_type stop, range_type _left_lcp,
+  PathGraphMerger<LABEL_LENGTH>& merger) :
   from(start), to(stop),
   left_lcp(_left_lcp),
   range_lcp(0, 0),
@@ -655,47 +1245,253 @@ PathRange::PathRange(size_type start, size_type stop, range_type _left_lcp, Path
 {
   if(stop < merger.size()) { this->range_lcp = merger.range_lcp(start, stop); }
   if(stop + 1 < merger.size()) { this->right_lcp = merger.border_lcp(stop, stop + 1); }
+  else if(stop + 1 == merger.size() && merger.bounds.has_next)
+  {
+    this->right_lcp = merger.lcp.max_lcp(merger.buffer[stop].node, merger.bounds.next.node,
+      merger.buffer[stop].label, merger.bounds.next.label);
+  }
 }
 
 //------------------------------------------------------------------------------
 
 const std::string PathGraph::PREFIX = ".gcsa";
 
-PathGraph::PathGraph(const InputGraph& source, sdsl::sd_vector<>& key_exists)
+/*
+  Schedules the processing of independent files. Large files are processed one at a time
+  using all threads. Small files are processed concurrently by groups of threads, with each
+  group using memory_limit / groups bytes. A file is small if it fits in that budget even
+  with one group per thread. Small files are processed from the largest to the smallest.
+*/
+
+struct FileSchedule
+{
+  std::vector<size_type> small_files, large_files;
+  size_type              groups, group_threads;
+
+  FileSchedule(const std::vector<size_type>& bytes, size_type threads, size_type memory_limit);
+
+  // Runs the loop over small files with nested parallelism.
+  inline void beginSmall() { this->nested = omp_get_nested(); omp_set_nested(1); }
+  inline void endSmall() { omp_set_nested(this->nested); }
+
+  int nested;
+};
+
+FileSchedule::FileSchedule(const std::vector<size_type>& bytes, size_type threads, size_type memory_limit) :
+  groups(1), group_threads(threads), nested(0)
+{
+  std::vector<range_type> small;  // (bytes, file)
+  for(size_type file = 0; file < bytes.size(); file++)
+  {
+    if(threads > 1 && bytes[file] <= memory_limit / threads) { small.push_back(range_type(bytes[file], file)); }
+    else { this->large_files.push_back(file); }
+  }
+  std::sort(small.begin(), small.end(), std::greater<range_type>());
+  for(size_type i = 0; i < small.size(); i++) { this->small_files.push_back(small[i].second); }
+  if(!(this->small_files.empty()))
+  {
+    this->groups = std::min(threads, (size_type)(this->small_files.size()));
+    this->group_threads = std::max(threads / this->groups, (size_type)1);
+  }
+}
+
+void
+readKMers(const InputGraph& source, std::vector<KMer>& kmers, size_type file)
+{
+  source.read(kmers, file);
+}
+
+/*
+  Sorts the KMers of a file and extracts the keys and the from nodes. Keys sharing the same
+  label are merged, and the from nodes are sorted and unique.
+*/
+void
+prepareKMers(std::vector<KMer>& kmers, std::vector<key_type>& keys, std::vector<node_type>& from_nodes)
+{
+  parallelQuickSort(kmers.begin(), kmers.end());
+
+  sdsl::util::clear(keys);
+  for(size_type i = 0; i < kmers.size(); i++)
+  {
+    if(!(keys.empty()) && Key::label(keys.back()) == Key::label(kmers[i].key))
+    {
+      keys.back() = Key::merge(keys.back(), kmers[i].key);
+    }
+    else { keys.push_back(kmers[i].key); }
+  }
+
+  from_nodes.resize(kmers.size());
+  #pragma omp parallel for schedule(static)
+  for(size_type i = 0; i < kmers.size(); i++) { from_nodes[i] = kmers[i].from; }
+  removeDuplicates(from_nodes, true);
+}
+
+// Writes the sorted KMers to a temporary file and clears them.
+void
+writeKMerFile(std::vector<KMer>& kmers, const std::string& kmer_name)
+{
+  WriteBuffer<KMer> kmer_file(kmer_name, MEGABYTE, PathGraph::COMPRESSED);
+  for(size_type i = 0; i < kmers.size(); i++) { kmer_file.push_back(kmers[i]); }
+  kmer_file.close();
+  sdsl::util::clear(kmers);
+}
+
+/*
+  Returns the rank of the label of the kmer in the sorted unique keys. The search starts
+  from keys[from], which must not be past the answer, so the kmers should be processed
+  in sorted order. We use a galloping search, as the answer is usually close.
+*/
+size_type
+keyRank(const std::vector<key_type>& keys, size_type from, const KMer& kmer)
+{
+  size_type low = from, high = from, step = 1;
+  while(high < keys.size() && keys[high] < kmer)
+  {
+    low = high + 1; high += step; step *= 2;
+  }
+  high = std::min(high, keys.size());
+  return std::lower_bound(keys.begin() + low, keys.begin() + high, kmer) - keys.begin();
+}
+
+/*
+  Converts the sorted KMers in the temporary file to PathNodes, replacing the key labels
+  with their ranks, and removes the temporary file.
+*/
+void
+convertKMerFile(std::string& kmer_name, const std::vector<key_type>& keys,
+  const std::string& path_name, const std::string& rank_name, size_type& path_count, size_type& rank_count)
+{
+  ElementFile<KMer> kmer_file;
+  kmer_file.open(kmer_name, PathGraph::COMPRESSED);
+  WriteBuffer<PathNode> path_buffer(path_name, MEGABYTE, PathGraph::COMPRESSED);
+  WriteBuffer<PathNode::rank_type> rank_buffer(rank_name, MEGABYTE, PathGraph::COMPRESSED);
+  std::vector<KMer> buffer;
+  size_type buffer_size = ReadBuffer<KMer>::READ_BUFFER_SIZE;  // avoid direct use of static const
+  size_type rank = 0;
+  for(size_type offset = 0; offset < kmer_file.size(); offset += buffer.size())
+  {
+    buffer.resize(std::min(buffer_size, kmer_file.size() - offset));
+    kmer_file.read(offset, buffer.data(), buffer.size());
+    for(size_type i = 0; i < buffer.size(); i++)
+    {
+      rank = keyRank(keys, rank, buffer[i]);
+      buffer[i].key = Key::replace(buffer[i].key, rank);
+      path_buffer.push_back(PathNode(buffer[i], rank_buffer));
+    }
+  }
+  path_count = path_buffer.size(); rank_count = rank_buffer.size();
+  path_buffer.close(); rank_buffer.close();
+  kmer_file.close();
+  TempFile::remove(kmer_name);
+}
+
+PathGraph::PathGraph(const InputGraph& source, std::vector<key_type>& keys, std::vector<node_type>& from_nodes,
+  size_type memory_limit) :
+  path_names(source.files()), rank_names(source.files()),
+  path_counts(source.files(), 0), rank_counts(source.files(), 0)
 {
   this->path_count = 0; this->rank_count = 0; this->range_count = 0;
   this->order = source.k(); this->doubling_steps = 0;
   this->unique = UNKNOWN; this->redundant = UNKNOWN;
   this->unsorted = UNKNOWN; this->nondeterministic = UNKNOWN;
 
-  sdsl::sd_vector<>::rank_1_type key_rank(&key_exists);
-  for(size_type file = 0; file < source.files(); file++)
+  std::vector<std::string> kmer_names(this->files());
+  for(size_type file = 0; file < this->files(); file++)
   {
-    std::string path_name = TempFile::getName(PREFIX);
-    this->path_names.push_back(path_name);
-    std::string rank_name = TempFile::getName(PREFIX);
-    this->rank_names.push_back(rank_name);
+    this->path_names[file] = TempFile::getName(PREFIX);
+    this->rank_names[file] = TempFile::getName(PREFIX);
+    kmer_names[file] = TempFile::getName(PREFIX);
+  }
 
-    // Read KMers, sort them, and convert the keys labels to the ranks of those labels.
-    std::vector<KMer> kmers;
-    source.read(kmers, file);
-    parallelQuickSort(kmers.begin(), kmers.end());
-    #pragma omp parallel for schedule(static)
-    for(size_type i = 0; i < kmers.size(); i++)
+  // Read the KMers, sort them, extract the keys and the from nodes, and write the KMers.
+  std::vector<std::vector<key_type>> file_keys(this->files());
+  std::vector<std::vector<node_type>> file_from(this->files());
+  std::vector<size_type> file_bytes(this->files());
+  for(size_type file = 0; file < this->files(); file++) { file_bytes[file] = source.sizes[file] * sizeof(KMer); }
+  FileSchedule schedule(file_bytes, omp_get_max_threads(), memory_limit);
+  if(!(schedule.small_files.empty()))
+  {
+    schedule.beginSmall();
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(schedule.groups)
+    for(size_type i = 0; i < schedule.small_files.size(); i++)
     {
-      kmers[i].key = Key::replace(kmers[i].key, key_rank(Key::label(kmers[i].key)));
+      omp_set_num_threads(schedule.group_threads);
+      size_type file = schedule.small_files[i];
+      std::vector<KMer> kmers;
+      source.read(kmers, file);
+      prepareKMers(kmers, file_keys[file], file_from[file]);
+      writeKMerFile(kmers, kmer_names[file]);
     }
+    schedule.endSmall();
+  }
 
-    // Convert the KMers to PathNodes.
-    WriteBuffer<PathNode> path_buffer(path_name);
-    WriteBuffer<PathNode::rank_type> rank_buffer(rank_name);
-    for(size_type i = 0; i < kmers.size(); i++)
+  /*
+    With large files, we read the next file and write the previous one in the background,
+    if three files fit in the memory limit.
+  */
+  size_type max_bytes = 0;
+  for(size_type i = 0; i < schedule.large_files.size(); i++)
+  {
+    max_bytes = std::max(max_bytes, source.sizes[schedule.large_files[i]] * sizeof(KMer));
+  }
+  bool pipeline = (3 * max_bytes <= memory_limit);
+  std::vector<KMer> kmers, next_kmers, prev_kmers;
+  std::thread writer;
+  if(!(schedule.large_files.empty())) { source.read(kmers, schedule.large_files[0]); }
+  for(size_type i = 0; i < schedule.large_files.size(); i++)
+  {
+    size_type file = schedule.large_files[i];
+    bool has_next = (i + 1 < schedule.large_files.size());
+    std::thread reader;
+    if(pipeline && has_next)
     {
-      path_buffer.push_back(PathNode(kmers[i], rank_buffer));
+      reader = std::thread(readKMers, std::cref(source), std::ref(next_kmers), schedule.large_files[i + 1]);
     }
-    this->path_counts.push_back(path_buffer.size()); this->path_count += path_buffer.size();
-    this->rank_counts.push_back(rank_buffer.size()); this->rank_count += rank_buffer.size();
-    path_buffer.close(); rank_buffer.close();
+    prepareKMers(kmers, file_keys[file], file_from[file]);
+    if(writer.joinable()) { writer.join(); }
+    prev_kmers.swap(kmers);
+    if(pipeline) { writer = std::thread(writeKMerFile, std::ref(prev_kmers), std::cref(kmer_names[file])); }
+    else { writeKMerFile(prev_kmers, kmer_names[file]); }
+    if(reader.joinable()) { reader.join(); kmers.swap(next_kmers); }
+    else if(has_next) { source.read(kmers, schedule.large_files[i + 1]); }
+  }
+  if(writer.joinable()) { writer.join(); }
+
+  // Merge the keys sharing the same label and the from nodes.
+  sdsl::util::clear(keys); sdsl::util::clear(from_nodes);
+  for(size_type file = 0; file < this->files(); file++)
+  {
+    keys.insert(keys.end(), file_keys[file].begin(), file_keys[file].end());
+    sdsl::util::clear(file_keys[file]);
+    from_nodes.insert(from_nodes.end(), file_from[file].begin(), file_from[file].end());
+    sdsl::util::clear(file_from[file]);
+  }
+  parallelQuickSort(keys.begin(), keys.end());
+  size_type tail = 0;
+  for(size_type i = 1; i < keys.size(); i++)
+  {
+    if(Key::label(keys[tail]) == Key::label(keys[i])) { keys[tail] = Key::merge(keys[tail], keys[i]); }
+    else { tail++; keys[tail] = keys[i]; }
+  }
+  if(!(keys.empty())) { keys.resize(tail + 1); }
+  removeDuplicates(from_nodes, true);
+  if(Verbosity::level >= Verbosity::BASIC)
+  {
+    std::cerr << "PathGraph::PathGraph(): " << keys.size() << " unique keys, "
+              << from_nodes.size() << " unique from nodes" << std::endl;
+  }
+
+  // Convert the KMers to PathNodes.
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type file = 0; file < this->files(); file++)
+  {
+    convertKMerFile(kmer_names[file], keys, this->path_names[file], this->rank_names[file],
+      this->path_counts[file], this->rank_counts[file]);
+  }
+
+  for(size_type file = 0; file < this->files(); file++)
+  {
+    this->path_count += this->path_counts[file]; this->rank_count += this->rank_counts[file];
   }
 
   if(Verbosity::level >= Verbosity::EXTENDED)
@@ -763,40 +1559,113 @@ PathGraph::swap(PathGraph& another)
   std::swap(this->nondeterministic, another.nondeterministic);
 }
 
+/*
+  Helper functions for serializing the file names and other construction state.
+*/
+
 void
-PathGraph::open(std::ifstream& path_file, std::ifstream& rank_file, size_type file) const
+serializeString(const std::string& str, std::ostream& out)
 {
-  if(file >= this->files())
+  size_type length = str.length();
+  sdsl::write_member(length, out);
+  out.write(str.data(), length);
+}
+
+void
+loadString(std::string& str, std::istream& in)
+{
+  size_type length = 0;
+  sdsl::read_member(length, in);
+  str.resize(length);
+  in.read(&(str[0]), length);
+}
+
+template<class Element>
+void
+serializeVector(const std::vector<Element>& vec, std::ostream& out)
+{
+  size_type length = vec.size();
+  sdsl::write_member(length, out);
+  out.write((const char*)(vec.data()), length * sizeof(Element));
+}
+
+template<class Element>
+void
+loadVector(std::vector<Element>& vec, std::istream& in)
+{
+  size_type length = 0;
+  sdsl::read_member(length, in);
+  vec.resize(length);
+  in.read((char*)(vec.data()), length * sizeof(Element));
+}
+
+void
+PathGraph::serialize(std::ostream& out) const
+{
+  size_type file_count = this->files();
+  sdsl::write_member(file_count, out);
+  for(size_type file = 0; file < file_count; file++)
   {
-    std::cerr << "PathGraph::open(): Invalid file number: " << file << std::endl;
-    std::exit(EXIT_FAILURE);
+    serializeString(this->path_names[file], out);
+    serializeString(this->rank_names[file], out);
   }
+  serializeVector(this->path_counts, out);
+  serializeVector(this->rank_counts, out);
+
+  sdsl::write_member(this->path_count, out); sdsl::write_member(this->rank_count, out);
+  sdsl::write_member(this->range_count, out);
+  sdsl::write_member(this->order, out); sdsl::write_member(this->doubling_steps, out);
+  sdsl::write_member(this->unique, out); sdsl::write_member(this->redundant, out);
+  sdsl::write_member(this->unsorted, out); sdsl::write_member(this->nondeterministic, out);
+}
 
-  path_file.open(this->path_names[file].c_str(), std::ios_base::binary);
-  if(!path_file)
+void
+PathGraph::load(std::istream& in)
+{
+  this->clear();
+
+  size_type file_count = 0;
+  sdsl::read_member(file_count, in);
+  this->path_names.resize(file_count); this->rank_names.resize(file_count);
+  for(size_type file = 0; file < file_count; file++)
   {
-    std::cerr << "PathGraph::open(): Cannot open path file " << this->path_names[file] << std::endl;
-    std::exit(EXIT_FAILURE);
+    loadString(this->path_names[file], in);
+    loadString(this->rank_names[file], in);
   }
+  loadVector(this->path_counts, in);
+  loadVector(this->rank_counts, in);
+
+  sdsl::read_member(this->path_count, in); sdsl::read_member(this->rank_count, in);
+  sdsl::read_member(this->range_count, in);
+  sdsl::read_member(this->order, in); sdsl::read_member(this->doubling_steps, in);
+  sdsl::read_member(this->unique, in); sdsl::read_member(this->redundant, in);
+  sdsl::read_member(this->unsorted, in); sdsl::read_member(this->nondeterministic, in);
+}
 
-  rank_file.open(this->rank_names[file].c_str(), std::ios_base::binary);
-  if(!rank_file)
+void
+PathGraph::open(ElementFile<PathNode>& path_file, ElementFile<PathNode::rank_type>& rank_file, size_type file) const
+{
+  if(file >= this->files())
   {
-    std::cerr << "PathGraph::open(): Cannot open rank file " << this->rank_names[file] << std::endl;
+    std::cerr << "PathGraph::open(): Invalid file number: " << file << std::endl;
     std::exit(EXIT_FAILURE);
   }
+
+  path_file.open(this->path_names[file], COMPRESSED);
+  rank_file.open(this->rank_names[file], COMPRESSED);
 }
 
 //------------------------------------------------------------------------------
 
+template<size_type LABEL_LENGTH>
 struct SameFromFile
 {
-  const PathGraphMerger& merger;
-  node_type              from;
-  size_type              file;
-  bool                   same_from, same_file;
+  const PathGraphMerger<LABEL_LENGTH>& merger;
+  node_type                            from;
+  size_type                            file;
+  bool                                 same_from, same_file;
 
-  SameFromFile(const PathGraphMerger& source, range_type range) :
+  SameFromFile(const PathGraphMerger<LABEL_LENGTH>& source, range_type range) :
     merger(source), from(source.buffer[range.first].node.from), file(source.buffer[range.first].file),
     same_from(true), same_file(true)
   {
@@ -820,16 +1689,43 @@ struct SameFromFile
   }
 };
 
+/*
+  Appends the elements in the file to the output, transforming each element with the
+  given function.
+*/
+template<class Element, class Transform>
 void
-PathGraph::prune(const LCP& lcp, size_type size_limit)
+appendFile(const std::string& filename, WriteBuffer<Element>& output, const Transform& transform,
+  bool compressed = false)
 {
-  size_type old_path_count = this->size();
+  ElementFile<Element> input;
+  input.open(filename, compressed);
 
-  PathGraphMerger merger(*this, lcp);
-  PathGraphBuilder builder(this->files(), this->k(), this->step(), size_limit);
+  size_type elements = input.size();
+  std::vector<Element> buffer(std::min(elements, MEGABYTE));
+  for(size_type i = 0; i < elements; i += buffer.size())
+  {
+    size_type n = std::min(buffer.size(), elements - i);
+    input.read(i, buffer.data(), n);
+    for(size_type j = 0; j < n; j++) { output.push_back(transform(buffer[j])); }
+  }
+  input.close();
+}
+
+template<class Element>
+inline Element
+identity(const Element& element)
+{
+  return element;
+}
+
+template<size_type LABEL_LENGTH>
+void
+pruneRange(PathGraphMerger<LABEL_LENGTH>& merger, PathGraphBuilder& builder)
+{
   for(range_type range = merger.first(); !(merger.atEnd(range)); range = merger.next())
   {
-    SameFromFile same_from(merger, range);
+    SameFromFile<LABEL_LENGTH> same_from(merger, range);
     if(same_from.same_from)
     {
       if(same_from.same_file)
@@ -862,7 +1758,91 @@ PathGraph::prune(const LCP& lcp, size_type size_limit)
     builder.graph.range_count++;
   }
   merger.close(); builder.close();
-  this->clear(); this->swap(builder.graph);
+}
+
+// Prunes the ranges in parallel, with one builder for each range.
+template<size_type LABEL_LENGTH>
+void
+pruneRanges(const PathGraph& graph, const LCP& lcp, std::deque<PathGraphBuilder>& builders,
+  size_type size_limit, size_type memory_limit)
+{
+  std::vector<MergeRange<LABEL_LENGTH>> ranges = partitionMerge<LABEL_LENGTH>(graph, lcp);
+  for(size_type i = 0; i < ranges.size(); i++)
+  {
+    builders.emplace_back(graph.files(), graph.k(), graph.step(), size_limit, memory_limit);
+  }
+  size_type buffer_size = mergerBufferSize(graph, ranges.size(), memory_limit);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type i = 0; i < ranges.size(); i++)
+  {
+    PathGraphMerger<LABEL_LENGTH> merger(graph, lcp, ranges[i], buffer_size);
+    pruneRange(merger, builders[i]);
+  }
+}
+
+void
+PathGraph::prune(const LCP& lcp, size_type size_limit, size_type memory_limit)
+{
+  size_type old_path_count = this->size();
+
+  // Prune the ranges in parallel using labels of length 1 << step.
+  std::deque<PathGraphBuilder> builders;
+  switch(this->step())
+  {
+    case 0:
+      pruneRanges<1>(*this, lcp, builders, size_limit, memory_limit); break;
+    case 1:
+      pruneRanges<2>(*this, lcp, builders, size_limit, memory_limit); break;
+    case 2:
+      pruneRanges<4>(*this, lcp, builders, size_limit, memory_limit); break;
+    case 3:
+      pruneRanges<8>(*this, lcp, builders, size_limit, memory_limit); break;
+    default:
+      std::cerr << "PathGraph::prune(): Invalid number of doubling steps: " << this->step() << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+
+  // Concatenate the pruned ranges.
+  PathGraph result(this->files(), this->k(), this->step());
+  if(builders.size() == 1) { result.swap(builders[0].graph); }
+  else
+  {
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(size_type file = 0; file < this->files(); file++)
+    {
+      WriteBuffer<PathNode> path_file(result.path_names[file], MEGABYTE, COMPRESSED);
+      WriteBuffer<PathNode::rank_type> rank_file(result.rank_names[file], MEGABYTE, COMPRESSED);
+      for(size_type i = 0; i < builders.size(); i++)
+      {
+        PathGraph& part = builders[i].graph;
+        size_type rank_offset = rank_file.size();
+        appendFile(part.path_names[file], path_file, [rank_offset](const PathNode& path)
+        {
+          PathNode temp = path; temp.setPointer(temp.pointer() + rank_offset);
+          return temp;
+        }, COMPRESSED);
+        appendFile(part.rank_names[file], rank_file, identity<PathNode::rank_type>, COMPRESSED);
+        TempFile::remove(part.path_names[file]); TempFile::remove(part.rank_names[file]);
+      }
+      result.path_counts[file] = path_file.size(); result.rank_counts[file] = rank_file.size();
+      path_file.close(); rank_file.close();
+    }
+    for(size_type i = 0; i < builders.size(); i++)
+    {
+      const PathGraph& part = builders[i].graph;
+      result.path_count += part.path_count; result.rank_count += part.rank_count;
+      result.range_count += part.range_count;
+      result.unique += part.unique; result.redundant += part.redundant;
+      result.unsorted += part.unsorted; result.nondeterministic += part.nondeterministic;
+    }
+    if(result.bytes() > size_limit)
+    {
+      std::cerr << "PathGraph::prune(): Size limit exceeded, construction aborted" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  builders.clear();
+  this->clear(); this->swap(result);
 
   if(Verbosity::level >= Verbosity::EXTENDED)
   {
@@ -880,74 +1860,148 @@ PathGraph::prune(const LCP& lcp, size_type size_limit)
 
 //------------------------------------------------------------------------------
 
+// Memory used by the file in PathGraph::extend().
+inline size_type
+extendBytes(const PathGraph& graph, size_type file)
+{
+  return graph.path_counts[file] * (sizeof(PathNode) + sizeof(size_type))
+    + graph.rank_counts[file] * sizeof(PathNode::rank_type);
+}
+
+/*
+  Creates the next generation of paths from the file, sorts them, and clears the input.
+  The memory limit is the budget for this file.
+*/
 void
-PathGraph::extend(size_type size_limit)
+extendFile(PathGraphBuilder& builder, std::vector<PathNode>& paths, std::vector<PathNode::rank_type>& labels,
+  size_type file, size_type memory_limit)
 {
-  size_type old_path_count = this->size();
+  // Initialization.
+  PathFromComparator from_c;  // Sort the paths by from.
+  parallelQuickSort(paths.begin(), paths.end(), from_c);
+  ValueIndex<PathNode, FromGetter> from_index(paths);
+  size_type threads = omp_get_max_threads();
+
+  // The thread-specific buffers may use the memory not needed for the current file.
+  size_type file_bytes = paths.size() * (sizeof(PathNode) + sizeof(size_type))
+    + labels.size() * sizeof(PathNode::rank_type);
+  size_type label_count = (1 << builder.graph.step()) + 1;
+  size_type bytes_per_path = sizeof(PathNode) + label_count * sizeof(PathNode::rank_type);
+  size_type free_bytes = (file_bytes < memory_limit ? memory_limit - file_bytes : 0);
+  size_type buffer_size = Range::bound(free_bytes / (2 * threads * bytes_per_path),
+    PathGraphBuilder::MIN_BUFFER_SIZE, PathGraphBuilder::WRITE_BUFFER_SIZE);
+
+  // Create thread-specific buffers.
+  std::vector<std::vector<PathNode>> temp_nodes(threads);
+  std::vector<std::vector<PathNode::rank_type>> temp_labels(threads);
+  for(size_type thread = 0; thread < threads; thread++)
+  {
+    temp_nodes[thread].reserve(buffer_size);
+    temp_labels[thread].reserve(label_count * buffer_size);
+  }
 
-  PathGraphBuilder builder(this->files(), 2 * this->k(), this->step() + 1, size_limit);
-  for(size_type file = 0; file < this->files(); file++)
+  // Create the next generation.
+  #pragma omp parallel for schedule(static)
+  for(size_type i = 0; i < paths.size(); i++)
   {
-    // Read the current file.
-    std::vector<PathNode> paths;
-    std::vector<PathNode::rank_type> labels;
-    this->read(paths, labels, file);
-
-    // Initialization.
-    PathFromComparator from_c;  // Sort the paths by from.
-    parallelQuickSort(paths.begin(), paths.end(), from_c);
-    ValueIndex<PathNode, FromGetter> from_index(paths);
-    size_type threads = omp_get_max_threads();
-
-    // Create thread-specific buffers.
-    std::vector<std::vector<PathNode>> temp_nodes(threads);
-    std::vector<std::vector<PathNode::rank_type>> temp_labels(threads);
-    for(size_type thread = 0; thread < threads; thread++)
+    size_type thread = omp_get_thread_num();
+    if(paths[i].sorted())
     {
-      temp_nodes[thread].reserve(PathGraphBuilder::WRITE_BUFFER_SIZE);
-      temp_labels[thread].reserve(((1 << builder.graph.step()) + 1) * PathGraphBuilder::WRITE_BUFFER_SIZE);
+      temp_nodes[thread].push_back(PathNode(paths[i], labels, temp_labels[thread]));
+      if(temp_nodes[thread].size() >= buffer_size)
+      {
+        builder.write(temp_nodes[thread], temp_labels[thread], file);
+      }
     }
-
-    // Create the next generation.
-    #pragma omp parallel for schedule(static)
-    for(size_type i = 0; i < paths.size(); i++)
+    else
     {
-      size_type thread = omp_get_thread_num();
-      if(paths[i].sorted())
+      size_type first = from_index.find(paths[i].to);
+      for(size_type j = first; j < paths.size() && paths[j].from == paths[i].to; j++)
       {
-        temp_nodes[thread].push_back(PathNode(paths[i], labels, temp_labels[thread]));
-        if(temp_nodes[thread].size() >= PathGraphBuilder::WRITE_BUFFER_SIZE)
+        temp_nodes[thread].push_back(PathNode(paths[i], paths[j], labels, temp_labels[thread]));
+        if(temp_nodes[thread].size() >= buffer_size)
         {
           builder.write(temp_nodes[thread], temp_labels[thread], file);
         }
       }
-      else
-      {
-        size_type first = from_index.find(paths[i].to);
-        for(size_type j = first; j < paths.size() && paths[j].from == paths[i].to; j++)
-        {
-          temp_nodes[thread].push_back(PathNode(paths[i], paths[j], labels, temp_labels[thread]));
-          if(temp_nodes[thread].size() >= PathGraphBuilder::WRITE_BUFFER_SIZE)
-          {
-            builder.write(temp_nodes[thread], temp_labels[thread], file);
-          }
-        }
-      }
     }
-    for(size_type thread = 0; thread < threads; thread++)
+  }
+  for(size_type thread = 0; thread < threads; thread++)
+  {
+    builder.write(temp_nodes[thread], temp_labels[thread], file);
+  }
+  sdsl::util::clear(paths); sdsl::util::clear(labels);
+
+  if(Verbosity::level >= Verbosity::FULL)
+  {
+    std::cerr << "PathGraph::extend(): File " << file << ": Created " << builder.graph.path_counts[file]
+              << " order-" << builder.graph.k() << " paths" << std::endl;
+  }
+
+  // Sort the next generation.
+  builder.sort(file, memory_limit);
+}
+
+void
+PathGraph::extend(size_type size_limit, size_type memory_limit)
+{
+  size_type old_path_count = this->size();
+
+  /*
+    Extending a file joins each path with the paths starting where it ends, so the entire
+    file must be in memory. Files correspond to independent parts of the input, so they
+    cannot be split further.
+  */
+  for(size_type file = 0; file < this->files(); file++)
+  {
+    if(extendBytes(*this, file) > memory_limit)
     {
-      builder.write(temp_nodes[thread], temp_labels[thread], file);
+      std::cerr << "PathGraph::extend(): File " << file << " requires " << inGigabytes(extendBytes(*this, file))
+                << " GB, exceeding the memory limit of " << inGigabytes(memory_limit) << " GB" << std::endl;
+      std::cerr << "PathGraph::extend(): Increase the memory limit or reduce the size of the input" << std::endl;
+      std::exit(EXIT_FAILURE);
     }
-    sdsl::util::clear(paths); sdsl::util::clear(labels);
+  }
 
-    if(Verbosity::level >= Verbosity::FULL)
+  PathGraphBuilder builder(this->files(), 2 * this->k(), this->step() + 1, size_limit, memory_limit);
+  std::vector<size_type> file_bytes(this->files());
+  for(size_type file = 0; file < this->files(); file++) { file_bytes[file] = extendBytes(*this, file); }
+  FileSchedule schedule(file_bytes, omp_get_max_threads(), memory_limit);
+  if(!(schedule.small_files.empty()))
+  {
+    schedule.beginSmall();
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(schedule.groups)
+    for(size_type i = 0; i < schedule.small_files.size(); i++)
     {
-      std::cerr << "PathGraph::extend(): File " << file << ": Created " << builder.graph.path_counts[file]
-                << " order-" << builder.graph.k() << " paths" << std::endl;
+      omp_set_num_threads(schedule.group_threads);
+      size_type file = schedule.small_files[i];
+      std::vector<PathNode> paths;
+      std::vector<PathNode::rank_type> labels;
+      this->read(paths, labels, file);
+      extendFile(builder, paths, labels, file, memory_limit / schedule.groups);
     }
+    schedule.endSmall();
+  }
 
-    // Sort the next generation.
-    builder.sort(file);
+  // With large files, read the next file in the background if both files fit in the memory limit.
+  std::vector<PathNode> paths, next_paths;
+  std::vector<PathNode::rank_type> labels, next_labels;
+  if(!(schedule.large_files.empty())) { this->read(paths, labels, schedule.large_files[0]); }
+  for(size_type i = 0; i < schedule.large_files.size(); i++)
+  {
+    size_type file = schedule.large_files[i];
+    bool has_next = (i + 1 < schedule.large_files.size());
+    size_type next_bytes = (has_next ? extendBytes(*this, schedule.large_files[i + 1]) : 0);
+    std::thread reader;
+    if(has_next && extendBytes(*this, file) + next_bytes <= memory_limit)
+    {
+      reader = std::thread(&PathGraph::read, this, std::ref(next_paths), std::ref(next_labels),
+        schedule.large_files[i + 1]);
+    }
+    else { next_bytes = 0; }
+    extendFile(builder, paths, labels, file, memory_limit - next_bytes);
+    if(reader.joinable()) { reader.join(); paths.swap(next_paths); labels.swap(next_labels); }
+    else if(has_next) { this->read(paths, labels, schedule.large_files[i + 1]); }
   }
   builder.close();
   this->clear(); this->swap(builder.graph);
@@ -969,10 +2023,11 @@ PathGraph::read(std::vector<PathNode>& paths, std::vector<PathNode::rank_type>&
   paths.resize(this->path_counts[file]);
   labels.resize(this->rank_counts[file]);
 
-  std::ifstream path_file, rank_file;
+  ElementFile<PathNode> path_file;
+  ElementFile<PathNode::rank_type> rank_file;
   this->open(path_file, rank_file, file);
-  DiskIO::read(path_file, paths.data(), this->path_counts[file]);
-  DiskIO::read(rank_file, labels.data(), this->rank_counts[file]);
+  path_file.read(0, paths.data(), paths.size(), true);
+  rank_file.read(0, labels.data(), labels.size(), true);
   path_file.close(); rank_file.close();
 
   if(Verbosity::level >= Verbosity::FULL)
@@ -986,12 +2041,13 @@ PathGraph::read(std::vector<PathNode>& paths, std::vector<PathNode::rank_type>&
 
 const std::string MergedGraph::PREFIX = ".gcsa";
 
+template<size_type LABEL_LENGTH>
 struct SameFromSet
 {
-  const PathGraphMerger& merger;
-  std::vector<node_type> nodes, buffer;
+  const PathGraphMerger<LABEL_LENGTH>& merger;
+  std::vector<node_type>               nodes, buffer;
 
-  SameFromSet(const PathGraphMerger& source) :
+  SameFromSet(const PathGraphMerger<LABEL_LENGTH>& source) :
     merger(source)
   {
   }
@@ -1027,33 +2083,33 @@ struct SameFromSet
   }
 };
 
-MergedGraph::MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, const LCP& kmer_lcp, size_type size_limit) :
-  path_name(TempFile::getName(PREFIX)), rank_name(TempFile::getName(PREFIX)),
-  from_name(TempFile::getName(PREFIX)), lcp_name(TempFile::getName(PREFIX)),
-  path_count(0), rank_count(0), from_count(0),
-  order(source.k()),
-  next(mapper.alpha.sigma + 1, 0), next_from(mapper.alpha.sigma + 1, 0)
+/*
+  A part of MergedGraph built from a MergeRange. first_paths[comp] is a pair (path, from)
+  for the first path with firstLabel(0) at least the rank of the first kmer starting with
+  comp, or UNKNOWN if there is no such path in this part.
+*/
+struct MergedGraphPart
 {
-  WriteBuffer<PathNode>            path_file(this->path_name);
-  WriteBuffer<PathNode::rank_type> rank_file(this->rank_name);
-  WriteBuffer<range_type>          from_file(this->from_name);
-  WriteBuffer<uint8_t>             lcp_file(this->lcp_name);
+  std::string             path_name, rank_name, from_name, lcp_name;
+  size_type               path_count, rank_count, from_count;
+  std::vector<range_type> first_paths;
 
-  /*
-     Initialize next[comp] to be the the rank of the first kmer starting with
-     the corresponding character. Later, next[comp] is transformed into the rank
-     of the first path with firstLabel(0) >= next[comp].
-  */
-  for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
-  {
-    this->next[comp] = mapper.charRange(comp).first;
-  }
-  this->next[mapper.alpha.sigma] = ~(size_type)0;
-  this->next_from[mapper.alpha.sigma] = ~(size_type)0;
+  MergedGraphPart() : path_count(0), rank_count(0), from_count(0) { }
+};
 
-  PathGraphMerger merger(source, kmer_lcp);
-  SameFromSet same_from_set(merger);
-  size_type curr_comp = 0;  // Used to transform next.
+template<size_type LABEL_LENGTH>
+void
+mergeRange(PathGraphMerger<LABEL_LENGTH>& merger, const DeBruijnGraph& mapper, size_type size_limit,
+  MergedGraphPart& part)
+{
+  WriteBuffer<PathNode>            path_file(part.path_name);
+  WriteBuffer<PathNode::rank_type> rank_file(part.rank_name);
+  WriteBuffer<range_type>          from_file(part.from_name);
+  WriteBuffer<uint8_t>             lcp_file(part.lcp_name);
+
+  part.first_paths = std::vector<range_type>(mapper.alpha.sigma, range_type(MergedGraph::UNKNOWN, 0));
+  SameFromSet<LABEL_LENGTH> same_from_set(merger);
+  size_type curr_comp = 0;
 
   size_type bytes = 0;
   for(range_type range = merger.first(); !(merger.atEnd(range)); range = merger.next())
@@ -1062,7 +2118,7 @@ MergedGraph::MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, c
     same_from_set.select(range);
     range = merger.extendRange(same_from_set);
     merger.mergePathNodes();
-    PriorityNode& curr = merger.buffer[range.second];
+    PriorityNode<LABEL_LENGTH>& curr = merger.buffer[range.second];
     curr.node.from = same_from_set.nodes[0];
 
     // Write the actual data
@@ -1075,23 +2131,143 @@ MergedGraph::MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, c
     writePath(curr.node, curr.label, path_file, rank_file);
     for(size_type i = 1; i < same_from_set.nodes.size(); i++)
     {
-      from_file.push_back(range_type(this->path_count, same_from_set.nodes[i]));
+      from_file.push_back(range_type(part.path_count, same_from_set.nodes[i]));
     }
-    lcp_file.push_back(path_lcp.first * mapper.order() + path_lcp.second);
+    size_type lcp_value = path_lcp.first * mapper.order() + path_lcp.second;
+    lcp_file.push_back(std::min(lcp_value, (size_type)(~(uint8_t)0)));  // Orders above 255 with wide keys.
 
-    // Update the counts and the pointers to paths starting with each comp value.
-    while(curr.firstLabel(0) >= this->next[curr_comp])
+    // Update the counts and find the first paths starting with each comp value.
+    while(curr_comp < mapper.alpha.sigma && curr.firstLabel(0) >= mapper.charRange(curr_comp).first)
     {
-      this->next[curr_comp] = this->path_count;
-      this->next_from[curr_comp] = this->from_count;
+      part.first_paths[curr_comp] = range_type(part.path_count, part.from_count);
       curr_comp++;
     }
-    this->path_count++;
-    this->rank_count += curr.node.ranks();
-    this->from_count += same_from_set.nodes.size() - 1;
+    part.path_count++;
+    part.rank_count += curr.node.ranks();
+    part.from_count += same_from_set.nodes.size() - 1;
   }
   merger.close();
   path_file.close(); rank_file.close(); from_file.close(); lcp_file.close();
+}
+
+/*
+  Merges the ranges in parallel, with one part for each range. If there is only one part,
+  it uses the files of the merged graph directly.
+*/
+template<size_type LABEL_LENGTH>
+void
+mergeRanges(const MergedGraph& graph, const PathGraph& source, const DeBruijnGraph& mapper, const LCP& kmer_lcp,
+  size_type size_limit, size_type memory_limit, std::vector<MergedGraphPart>& parts)
+{
+  std::vector<MergeRange<LABEL_LENGTH>> ranges = partitionMerge<LABEL_LENGTH>(source, kmer_lcp);
+  parts = std::vector<MergedGraphPart>(ranges.size());
+  for(size_type i = 0; i < parts.size(); i++)
+  {
+    if(parts.size() == 1)
+    {
+      parts[i].path_name = graph.path_name; parts[i].rank_name = graph.rank_name;
+      parts[i].from_name = graph.from_name; parts[i].lcp_name = graph.lcp_name;
+    }
+    else
+    {
+      parts[i].path_name = TempFile::getName(MergedGraph::PREFIX); parts[i].rank_name = TempFile::getName(MergedGraph::PREFIX);
+      parts[i].from_name = TempFile::getName(MergedGraph::PREFIX); parts[i].lcp_name = TempFile::getName(MergedGraph::PREFIX);
+    }
+  }
+  size_type buffer_size = mergerBufferSize(source, ranges.size(), memory_limit);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type i = 0; i < ranges.size(); i++)
+  {
+    PathGraphMerger<LABEL_LENGTH> merger(source, kmer_lcp, ranges[i], buffer_size);
+    mergeRange(merger, mapper, size_limit, parts[i]);
+  }
+}
+
+MergedGraph::MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, const LCP& kmer_lcp,
+  size_type size_limit, size_type memory_limit) :
+  path_name(TempFile::getName(PREFIX)), rank_name(TempFile::getName(PREFIX)),
+  from_name(TempFile::getName(PREFIX)), lcp_name(TempFile::getName(PREFIX)),
+  path_count(0), rank_count(0), from_count(0),
+  order(source.k()),
+  next(mapper.alpha.sigma + 1, 0), next_from(mapper.alpha.sigma + 1, 0)
+{
+  // Merge the ranges in parallel using labels of length 1 << step.
+  std::vector<MergedGraphPart> parts;
+  switch(source.step())
+  {
+    case 1:
+      mergeRanges<2>(*this, source, mapper, kmer_lcp, size_limit, memory_limit, parts); break;
+    case 2:
+      mergeRanges<4>(*this, source, mapper, kmer_lcp, size_limit, memory_limit, parts); break;
+    case 3:
+      mergeRanges<8>(*this, source, mapper, kmer_lcp, size_limit, memory_limit, parts); break;
+    case 4:
+      mergeRanges<16>(*this, source, mapper, kmer_lcp, size_limit, memory_limit, parts); break;
+    default:
+      std::cerr << "MergedGraph::MergedGraph(): Invalid number of doubling steps: " << source.step() << std::endl;
+      std::exit(EXIT_FAILURE);
+  }
+
+  /*
+     next[comp] is the first path with firstLabel(0) at least the rank of the first kmer
+     starting with the corresponding character. If there is no such path, we use the
+     rank instead.
+  */
+  for(size_type comp = 0; comp < mapper.alpha.sigma; comp++)
+  {
+    this->next[comp] = mapper.charRange(comp).first;
+    size_type path_offset = 0, from_offset = 0;
+    for(size_type i = 0; i < parts.size(); i++)
+    {
+      if(parts[i].first_paths[comp].first != UNKNOWN)
+      {
+        this->next[comp] = path_offset + parts[i].first_paths[comp].first;
+        this->next_from[comp] = from_offset + parts[i].first_paths[comp].second;
+        break;
+      }
+      path_offset += parts[i].path_count; from_offset += parts[i].from_count;
+    }
+  }
+  this->next[mapper.alpha.sigma] = ~(size_type)0;
+  this->next_from[mapper.alpha.sigma] = ~(size_type)0;
+
+  // Concatenate the parts.
+  if(parts.size() > 1)
+  {
+    WriteBuffer<PathNode>            path_file(this->path_name);
+    WriteBuffer<PathNode::rank_type> rank_file(this->rank_name);
+    WriteBuffer<range_type>          from_file(this->from_name);
+    WriteBuffer<uint8_t>             lcp_file(this->lcp_name);
+    for(size_type i = 0; i < parts.size(); i++)
+    {
+      size_type path_offset = path_file.size(), rank_offset = rank_file.size();
+      appendFile(parts[i].path_name, path_file, [rank_offset](const PathNode& path)
+      {
+        PathNode temp = path; temp.setPointer(temp.pointer() + rank_offset);
+        return temp;
+      });
+      appendFile(parts[i].rank_name, rank_file, identity<PathNode::rank_type>);
+      appendFile(parts[i].from_name, from_file, [path_offset](const range_type& from)
+      {
+        return range_type(from.first + path_offset, from.second);
+      });
+      appendFile(parts[i].lcp_name, lcp_file, identity<uint8_t>);
+      TempFile::remove(parts[i].path_name); TempFile::remove(parts[i].rank_name);
+      TempFile::remove(parts[i].from_name); TempFile::remove(parts[i].lcp_name);
+    }
+    path_file.close(); rank_file.close(); from_file.close(); lcp_file.close();
+  }
+  for(size_type i = 0; i < parts.size(); i++)
+  {
+    this->path_count += parts[i].path_count;
+    this->rank_count += parts[i].rank_count;
+    this->from_count += parts[i].from_count;
+  }
+  if(this->bytes() > size_limit)
+  {
+    std::cerr << "MergedGraph::MergedGraph(): Size limit exceeded, construction aborted" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
 
   if(Verbosity::level >= Verbosity::EXTENDED)
   {
@@ -1101,11 +2277,61 @@ MergedGraph::MergedGraph(const PathGraph& source, const DeBruijnGraph& mapper, c
   }
 }
 
+MergedGraph::MergedGraph() :
+  path_count(0), rank_count(0), from_count(0), order(0)
+{
+}
+
 MergedGraph::~MergedGraph()
 {
   this->clear();
 }
 
+void
+MergedGraph::swap(MergedGraph& another)
+{
+  this->path_name.swap(another.path_name);
+  this->rank_name.swap(another.rank_name);
+  this->from_name.swap(another.from_name);
+  this->lcp_name.swap(another.lcp_name);
+
+  std::swap(this->path_count, another.path_count);
+  std::swap(this->rank_count, another.rank_count);
+  std::swap(this->from_count, another.from_count);
+  std::swap(this->order, another.order);
+
+  this->next.swap(another.next);
+  this->next_from.swap(another.next_from);
+}
+
+void
+MergedGraph::serialize(std::ostream& out) const
+{
+  serializeString(this->path_name, out); serializeString(this->rank_name, out);
+  serializeString(this->from_name, out); serializeString(this->lcp_name, out);
+
+  sdsl::write_member(this->path_count, out); sdsl::write_member(this->rank_count, out);
+  sdsl::write_member(this->from_count, out); sdsl::write_member(this->order, out);
+
+  serializeVector(this->next, out);
+  serializeVector(this->next_from, out);
+}
+
+void
+MergedGraph::load(std::istream& in)
+{
+  this->clear();
+
+  loadString(this->path_name, in); loadString(this->rank_name, in);
+  loadString(this->from_name, in); loadString(this->lcp_name, in);
+
+  sdsl::read_member(this->path_count, in); sdsl::read_member(this->rank_count, in);
+  sdsl::read_member(this->from_count, in); sdsl::read_member(this->order, in);
+
+  loadVector(this->next, in);
+  loadVector(this->next_from, in);
+}
+
 void
 MergedGraph::clear()
 {
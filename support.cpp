@@ -22,6 +22,9 @@
   SOFTWARE.
 */
 
+#include <cstdio>
+
+#include <gcsa/internal.h>
 #include <gcsa/support.h>
 
 namespace gcsa
@@ -31,14 +34,14 @@ namespace gcsa
 
 ConstructionParameters::ConstructionParameters() :
   doubling_steps(DOUBLING_STEPS), size_limit(SIZE_LIMIT * GIGABYTE),
-  lcp_branching(LCP_BRANCHING)
+  memory_limit(MEMORY_LIMIT * GIGABYTE), lcp_branching(LCP_BRANCHING)
 {
 }
 
 void
 ConstructionParameters::setSteps(size_type steps)
 {
-  this->doubling_steps = Range::bound(steps, 1, DOUBLING_STEPS);
+  this->doubling_steps = Range::bound(steps, 1, MAX_STEPS);
 }
 
 void
@@ -47,12 +50,163 @@ ConstructionParameters::setLimit(size_type gigabytes)
   this->size_limit = Range::bound(gigabytes, 1, ABSOLUTE_LIMIT) * GIGABYTE;
 }
 
+void
+ConstructionParameters::setMemoryLimit(size_type gigabytes)
+{
+  this->memory_limit = Range::bound(gigabytes, 1, ABSOLUTE_LIMIT) * GIGABYTE;
+}
+
 void
 ConstructionParameters::setLCPBranching(size_type factor)
 {
   this->lcp_branching = std::max((size_type)2, factor);
 }
 
+void
+ConstructionParameters::setCheckpoint(const std::string& filename)
+{
+  this->checkpoint_file = filename;
+}
+
+void
+ConstructionParameters::setProfile(const std::string& filename)
+{
+  this->profile_file = filename;
+}
+
+//------------------------------------------------------------------------------
+
+const std::string ConstructionProfile::EXTENSION = ".profile.json";
+
+ConstructionProfile::ConstructionProfile() :
+  start_time(readTimer()), start_cpu(readCPUTimer()),
+  start_read(readVolume()), start_write(writeVolume()),
+  start_logical_read(logicalReadVolume()), start_logical_write(logicalWriteVolume())
+{
+  TempFile::resetPeakDiskUsage();
+}
+
+ConstructionProfile::Phase&
+ConstructionProfile::record(const std::string& name, size_type step)
+{
+  double time = readTimer(), cpu = readCPUTimer();
+  size_type read = readVolume(), write = writeVolume();
+  size_type logical_read = logicalReadVolume(), logical_write = logicalWriteVolume();
+
+  Phase phase;
+  phase.name = name; phase.step = step;
+  phase.seconds = time - this->start_time; phase.cpu_seconds = cpu - this->start_cpu;
+  phase.peak_memory = memoryUsage(); phase.memory = currentMemoryUsage();
+  phase.read_bytes = read - this->start_read; phase.write_bytes = write - this->start_write;
+  phase.logical_read_bytes = logical_read - this->start_logical_read;
+  phase.logical_write_bytes = logical_write - this->start_logical_write;
+  phase.temp_disk = TempFile::peakDiskUsage();
+  this->phases.push_back(phase);
+
+  this->start_time = time; this->start_cpu = cpu;
+  this->start_read = read; this->start_write = write;
+  this->start_logical_read = logical_read; this->start_logical_write = logical_write;
+  TempFile::resetPeakDiskUsage();
+
+  return this->phases.back();
+}
+
+std::string
+jsonString(const std::string& value)
+{
+  std::string result = "\"";
+  for(char c : value)
+  {
+    if(c == '"' || c == '\\') { result += '\\'; result += c; }
+    else if(static_cast<unsigned char>(c) < 0x20)
+    {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+      result += buf;
+    }
+    else { result += c; }
+  }
+  result += '"';
+  return result;
+}
+
+bool
+ConstructionProfile::write(const std::string& filename, const ConstructionParameters& parameters) const
+{
+  std::ofstream out(filename.c_str(), std::ios_base::binary);
+  if(!out) { return false; }
+
+  out << "{" << std::endl;
+  out << "  \"parameters\": {" << std::endl;
+  out << "    \"doubling_steps\": " << parameters.doubling_steps << "," << std::endl;
+  out << "    \"size_limit\": " << parameters.size_limit << "," << std::endl;
+  out << "    \"memory_limit\": " << parameters.memory_limit << "," << std::endl;
+  out << "    \"lcp_branching\": " << parameters.lcp_branching << "," << std::endl;
+  out << "    \"threads\": " << omp_get_max_threads() << "," << std::endl;
+  out << "    \"io_backend\": " << jsonString(DiskIO::backendName()) << "," << std::endl;
+  out << "    \"direct_io\": " << (DiskIO::direct ? "true" : "false") << "," << std::endl;
+  out << "    \"temp_directories\": [";
+  std::vector<std::string> temp_dirs = TempFile::directories();
+  for(size_type i = 0; i < temp_dirs.size(); i++)
+  {
+    out << (i > 0 ? ", " : "") << jsonString(temp_dirs[i]);
+  }
+  out << "]" << std::endl;
+  out << "  }," << std::endl;
+
+  Phase total;
+  total.seconds = 0.0; total.cpu_seconds = 0.0;
+  total.peak_memory = 0; total.read_bytes = 0; total.write_bytes = 0;
+  total.logical_read_bytes = 0; total.logical_write_bytes = 0; total.temp_disk = 0;
+  out << "  \"phases\": [" << std::endl;
+  for(size_type i = 0; i < this->phases.size(); i++)
+  {
+    const Phase& phase = this->phases[i];
+    out << "    {" << std::endl;
+    out << "      \"name\": " << jsonString(phase.name) << "," << std::endl;
+    if(phase.step != NO_STEP) { out << "      \"step\": " << phase.step << "," << std::endl; }
+    out << "      \"seconds\": " << phase.seconds << "," << std::endl;
+    out << "      \"cpu_seconds\": " << phase.cpu_seconds << "," << std::endl;
+    out << "      \"peak_memory\": " << phase.peak_memory << "," << std::endl;
+    out << "      \"memory\": " << phase.memory << "," << std::endl;
+    out << "      \"read_bytes\": " << phase.read_bytes << "," << std::endl;
+    out << "      \"write_bytes\": " << phase.write_bytes << "," << std::endl;
+    out << "      \"logical_read_bytes\": " << phase.logical_read_bytes << "," << std::endl;
+    out << "      \"logical_write_bytes\": " << phase.logical_write_bytes << "," << std::endl;
+    out << "      \"temp_disk\": " << phase.temp_disk << "," << std::endl;
+    out << "      \"counts\": {";
+    for(size_type j = 0; j < phase.counts.size(); j++)
+    {
+      out << (j > 0 ? ", " : "") << jsonString(phase.counts[j].first) << ": " << phase.counts[j].second;
+    }
+    out << "}" << std::endl;
+    out << "    }" << (i + 1 < this->phases.size() ? "," : "") << std::endl;
+
+    total.seconds += phase.seconds; total.cpu_seconds += phase.cpu_seconds;
+    total.peak_memory = std::max(total.peak_memory, phase.peak_memory);
+    total.read_bytes += phase.read_bytes; total.write_bytes += phase.write_bytes;
+    total.logical_read_bytes += phase.logical_read_bytes;
+    total.logical_write_bytes += phase.logical_write_bytes;
+    total.temp_disk = std::max(total.temp_disk, phase.temp_disk);
+  }
+  out << "  ]," << std::endl;
+
+  out << "  \"total\": {" << std::endl;
+  out << "    \"seconds\": " << total.seconds << "," << std::endl;
+  out << "    \"cpu_seconds\": " << total.cpu_seconds << "," << std::endl;
+  out << "    \"peak_memory\": " << total.peak_memory << "," << std::endl;
+  out << "    \"read_bytes\": " << total.read_bytes << "," << std::endl;
+  out << "    \"write_bytes\": " << total.write_bytes << "," << std::endl;
+  out << "    \"logical_read_bytes\": " << total.logical_read_bytes << "," << std::endl;
+  out << "    \"logical_write_bytes\": " << total.logical_write_bytes << "," << std::endl;
+  out << "    \"temp_disk\": " << total.temp_disk << std::endl;
+  out << "  }" << std::endl;
+  out << "}" << std::endl;
+
+  out.close();
+  return !(out.fail());
+}
+
 //------------------------------------------------------------------------------
 
 /*
@@ -383,7 +537,7 @@ Key::decode(key_type key, size_type kmer_length, const Alphabet& alpha)
   std::string res(kmer_length, '\0');
   for(size_type i = 1; i <= kmer_length; i++)
   {
-    res[kmer_length - i] = alpha.comp2char[key & CHAR_MASK];
+    res[kmer_length - i] = alpha.comp2char[static_cast<size_type>(key & CHAR_MASK)];
     key >>= CHAR_WIDTH;
   }
 
@@ -403,26 +557,43 @@ Key::lastChars(const std::vector<key_type>& keys, sdsl::int_vector<0>& last_char
 node_type
 Node::encode(const std::string& token)
 {
-  size_t separator = 0;
-  size_type node = std::stoul(token, &separator);
-  if(separator + 1 >= token.length())
+  return encode(token.data(), token.data() + token.length());
+}
+
+node_type
+Node::encode(const char* begin, const char* end)
+{
+  const char* pos = begin;
+  size_type node = 0;
+  while(pos < end && *pos >= '0' && *pos <= '9') { node = 10 * node + (*pos - '0'); pos++; }
+  if(pos == begin || pos + 1 >= end || *pos != ':')
   {
-    std::cerr << "Node::encode(): Invalid position token " << token << std::endl;
+    std::cerr << "Node::encode(): Invalid position token " << std::string(begin, end) << std::endl;
     return 0;
   }
+  pos++;
 
   bool reverse_complement = false;
-  if(token[separator + 1] == '-')
+  if(*pos == '-')
   {
     reverse_complement = true;
-    separator++;
+    pos++;
   }
 
-  std::string temp = token.substr(separator + 1);
-  size_type offset = std::stoul(temp);
+  const char* offset_start = pos;
+  size_type offset = 0;
+  while(pos < end && *pos >= '0' && *pos <= '9' && offset <= OFFSET_MASK)
+  {
+    offset = 10 * offset + (*pos - '0'); pos++;
+  }
+  if(pos == offset_start)
+  {
+    std::cerr << "Node::encode(): Invalid position token " << std::string(begin, end) << std::endl;
+    return 0;
+  }
   if(offset > OFFSET_MASK)
   {
-    std::cerr << "Node::encode(): Offset " << offset << " too large" << std::endl;
+    std::cerr << "Node::encode(): Offset " << std::string(offset_start, end) << " too large" << std::endl;
     return 0;
   }
 
@@ -456,16 +627,37 @@ KMer::KMer(const std::vector<std::string>& tokens, const Alphabet& alpha, size_t
 
 byte_type
 KMer::chars(const std::string& token, const Alphabet& alpha)
+{
+  return chars(token.data(), token.data() + token.length(), alpha);
+}
+
+byte_type
+KMer::chars(const char* begin, const char* end, const Alphabet& alpha)
 {
   byte_type val = 0;
-  for(size_type i = 0; i < token.length(); i += 2) { val |= 1 << alpha.char2comp[token[i]]; }
+  for(const char* pos = begin; pos < end; pos += 2) { val |= 1 << alpha.char2comp[*pos]; }
   return val;
 }
 
+// Streams do not support 128-bit integers, so we print the labels ourselves.
+std::string
+labelString(key_type label)
+{
+  std::string res;
+  do
+  {
+    res.push_back('0' + static_cast<char>(label % 10));
+    label /= 10;
+  }
+  while(label > 0);
+  std::reverse(res.begin(), res.end());
+  return res;
+}
+
 std::ostream&
 operator<< (std::ostream& out, const KMer& kmer)
 {
-  out << "(key " << Key::label(kmer.key)
+  out << "(key " << labelString(Key::label(kmer.key))
       << ", in " << (size_type)(Key::predecessors(kmer.key))
       << ", out " << (size_type)(Key::successors(kmer.key))
       << ", from " << Node::decode(kmer.from)
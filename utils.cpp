@@ -24,8 +24,12 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <mutex>
 
 #include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <unistd.h>
 
 #include <gcsa/internal.h>
@@ -86,6 +90,15 @@ readTimer()
   return omp_get_wtime();
 }
 
+double
+readCPUTimer()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / MILLION_DOUBLE;
+}
+
 size_type
 memoryUsage()
 {
@@ -98,6 +111,20 @@ memoryUsage()
 #endif
 }
 
+size_type
+currentMemoryUsage()
+{
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  size_type total_pages = 0, resident_pages = 0;
+  if(statm >> total_pages >> resident_pages)
+  {
+    return resident_pages * sysconf(_SC_PAGESIZE);
+  }
+#endif
+  return 0;
+}
+
 size_type
 readVolume()
 {
@@ -110,41 +137,324 @@ writeVolume()
   return DiskIO::write_volume;
 }
 
+size_type
+logicalReadVolume()
+{
+  return DiskIO::logical_read_volume;
+}
+
+size_type
+logicalWriteVolume()
+{
+  return DiskIO::logical_write_volume;
+}
+
 //------------------------------------------------------------------------------
 
 const std::string TempFile::DEFAULT_TEMP_DIR = ".";
 std::string TempFile::temp_dir = TempFile::DEFAULT_TEMP_DIR;
+std::vector<std::string> TempFile::temp_dirs(1, TempFile::DEFAULT_TEMP_DIR);
+bool TempFile::in_memory = false;
+size_type TempFile::ram_limit = ~(size_type)0;
+
+/*
+  Bookkeeping for choosing the directory for a new temporary file. Directories on the
+  same device share the device's load. The sizes of the files are updated as they are
+  written, and the total is kept up to date.
+*/
+struct TempDirectories
+{
+  std::vector<size_type>           device;        // Device of each directory.
+  std::vector<dev_t>               device_ids;
+  std::vector<size_type>           directory_files, device_files;  // Live files.
+  std::vector<size_type>           directory_bytes, device_bytes;  // Bytes in live files.
+  std::map<std::string, range_type> owner;        // File name -> (directory, size).
+  size_type                        disk_usage, peak_usage;
+  std::map<std::string, size_type> ram_files;     // Ram file name -> size.
+  size_type                        ram_usage;
+  std::mutex                       mtx;
+
+  TempDirectories() : disk_usage(0), peak_usage(0), ram_usage(0) { }
+
+  // The mutex must be held in the following functions.
+  void init();
+  void sync();
+  size_type choose(dev_t neighbor_device, bool use_neighbor);
+  void add(const std::string& filename, size_type directory);
+  void resize(const std::string& filename, size_type bytes);
+  void remove(const std::string& filename);
+};
+
+TempDirectories temp_directories;
+
+void
+TempDirectories::init()
+{
+  this->device.clear(); this->device_ids.clear();
+  for(const std::string& directory : TempFile::temp_dirs)
+  {
+    struct stat info;
+    dev_t id = (stat(directory.c_str(), &info) == 0 ? info.st_dev : 0);
+    size_type i = std::find(this->device_ids.begin(), this->device_ids.end(), id) - this->device_ids.begin();
+    if(i >= this->device_ids.size()) { this->device_ids.push_back(id); }
+    this->device.push_back(i);
+  }
+  this->directory_files = std::vector<size_type>(TempFile::temp_dirs.size(), 0);
+  this->device_files = std::vector<size_type>(this->device_ids.size(), 0);
+  this->directory_bytes = std::vector<size_type>(TempFile::temp_dirs.size(), 0);
+  this->device_bytes = std::vector<size_type>(this->device_ids.size(), 0);
+  this->owner.clear();
+  this->disk_usage = 0;
+}
+
+void
+TempDirectories::sync()
+{
+  if(TempFile::temp_dirs.empty() || TempFile::temp_dirs.front() != TempFile::temp_dir)
+  {
+    TempFile::temp_dirs = std::vector<std::string>(1, TempFile::temp_dir);
+    this->init();
+  }
+  else if(this->device.size() != TempFile::temp_dirs.size()) { this->init(); }
+}
+
+size_type
+TempDirectories::choose(dev_t neighbor_device, bool use_neighbor)
+{
+  this->sync();
+  if(TempFile::temp_dirs.size() == 1) { return 0; }
+
+  // Choose the device. Use the device of the neighbor if possible. Otherwise use the
+  // device with the fewest bytes in live files among the devices with at least a quarter
+  // of the maximum free space, breaking ties by live files and then by free space.
+  std::vector<double> free_space(this->device_ids.size(), 0.0);
+  double max_free = 0.0;
+  for(size_type i = 0; i < TempFile::temp_dirs.size(); i++)
+  {
+    struct statvfs info;
+    if(statvfs(TempFile::temp_dirs[i].c_str(), &info) == 0)
+    {
+      free_space[this->device[i]] = static_cast<double>(info.f_bavail) * info.f_frsize;
+      max_free = std::max(max_free, free_space[this->device[i]]);
+    }
+  }
+  size_type best_device = this->device_ids.size();
+  for(size_type i = 0; i < this->device_ids.size(); i++)
+  {
+    if(use_neighbor && this->device_ids[i] == neighbor_device) { best_device = i; break; }
+    if(free_space[i] < max_free / 4) { continue; }
+    if(best_device >= this->device_ids.size()) { best_device = i; continue; }
+    range_type load(this->device_bytes[i], this->device_files[i]);
+    range_type best_load(this->device_bytes[best_device], this->device_files[best_device]);
+    if(load < best_load || (load == best_load && free_space[i] > free_space[best_device]))
+    {
+      best_device = i;
+    }
+  }
+  if(best_device >= this->device_ids.size()) { best_device = 0; }
+
+  // Choose the directory with the fewest bytes in live files on the device.
+  size_type best = TempFile::temp_dirs.size();
+  for(size_type i = 0; i < TempFile::temp_dirs.size(); i++)
+  {
+    if(this->device[i] != best_device) { continue; }
+    if(best >= TempFile::temp_dirs.size() ||
+      range_type(this->directory_bytes[i], this->directory_files[i]) <
+      range_type(this->directory_bytes[best], this->directory_files[best]))
+    {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void
+TempDirectories::add(const std::string& filename, size_type directory)
+{
+  this->owner[filename] = range_type(directory, 0);
+  this->directory_files[directory]++;
+  this->device_files[this->device[directory]]++;
+}
+
+void
+TempDirectories::resize(const std::string& filename, size_type bytes)
+{
+  auto iter = this->owner.find(filename);
+  if(iter == this->owner.end()) { return; }
+  size_type directory = iter->second.first, old_bytes = iter->second.second;
+  this->directory_bytes[directory] += bytes - old_bytes;
+  this->device_bytes[this->device[directory]] += bytes - old_bytes;
+  this->disk_usage += bytes - old_bytes;
+  this->peak_usage = std::max(this->peak_usage, this->disk_usage);
+  iter->second.second = bytes;
+}
+
+void
+TempDirectories::remove(const std::string& filename)
+{
+  auto iter = this->owner.find(filename);
+  if(iter == this->owner.end()) { return; }
+  this->resize(filename, 0);
+  this->directory_files[iter->second.first]--;
+  this->device_files[this->device[iter->second.first]]--;
+  this->owner.erase(iter);
+}
 
 void
 TempFile::setDirectory(const std::string& directory)
 {
-  if(directory.empty()) { temp_dir = DEFAULT_TEMP_DIR; }
-  else if(directory[directory.length() - 1] != '/') { temp_dir = directory; }
-  else { temp_dir = directory.substr(0, directory.length() - 1); }
+  std::vector<std::string> directories;
+  size_type start = 0;
+  while(true)
+  {
+    size_type end = directory.find(',', start);
+    directories.push_back(directory.substr(start, (end == std::string::npos ? end : end - start)));
+    if(end == std::string::npos) { break; }
+    start = end + 1;
+  }
+  setDirectories(directories);
+}
+
+void
+TempFile::setDirectories(const std::vector<std::string>& directories)
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  temp_dirs.clear();
+  for(const std::string& directory : directories)
+  {
+    if(directory.empty()) { continue; }
+    else if(directory[directory.length() - 1] != '/') { temp_dirs.push_back(directory); }
+    else if(directory.length() > 1) { temp_dirs.push_back(directory.substr(0, directory.length() - 1)); }
+    else { temp_dirs.push_back(directory); }
+  }
+  if(temp_dirs.empty()) { temp_dirs.push_back(DEFAULT_TEMP_DIR); }
+  temp_dir = temp_dirs.front();
+  temp_directories.init();
+}
+
+std::vector<std::string>
+TempFile::directories()
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  temp_directories.sync();
+  return temp_dirs;
 }
 
 std::string
-TempFile::getName(const std::string& name_part)
+TempFile::directoryNames()
+{
+  std::vector<std::string> names = directories();
+  std::string result;
+  for(size_type i = 0; i < names.size(); i++)
+  {
+    if(i > 0) { result += ", "; }
+    result += names[i];
+  }
+  return result;
+}
+
+std::string
+tempFileName(const std::string& directory, const std::string& name_part)
 {
   char hostname[32];
   gethostname(hostname, 32); hostname[31] = 0;
 
-  return temp_dir + '/' + name_part + '_'
+  return directory + '/' + name_part + '_'
     + std::string(hostname) + '_'
     + sdsl::util::to_string(sdsl::util::pid()) + '_'
     + sdsl::util::to_string(sdsl::util::id());
 }
 
+std::string
+TempFile::getName(const std::string& name_part)
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  if(in_memory && temp_directories.ram_usage < ram_limit)
+  {
+    std::string filename = sdsl::ram_file_name(tempFileName(temp_dir, name_part));
+    temp_directories.ram_files[filename] = 0;
+    return filename;
+  }
+
+  size_type directory = temp_directories.choose(0, false);
+  std::string filename = tempFileName(temp_dirs[directory], name_part);
+  temp_directories.add(filename, directory);
+  return filename;
+}
+
+std::string
+TempFile::getName(const std::string& name_part, const std::string& neighbor)
+{
+  if(in_memory) { return getName(name_part); }
+
+  struct stat info;
+  if(stat(neighbor.c_str(), &info) != 0) { return getName(name_part); }
+
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  size_type directory = temp_directories.choose(info.st_dev, true);
+  std::string filename = tempFileName(temp_dirs[directory], name_part);
+  temp_directories.add(filename, directory);
+  return filename;
+}
+
 void
 TempFile::remove(std::string& filename)
 {
   if(!(filename.empty()))
   {
-    std::remove(filename.c_str());
+    {
+      std::lock_guard<std::mutex> lock(temp_directories.mtx);
+      temp_directories.remove(filename);
+      auto iter = temp_directories.ram_files.find(filename);
+      if(iter != temp_directories.ram_files.end())
+      {
+        temp_directories.ram_usage -= iter->second;
+        temp_directories.ram_files.erase(iter);
+      }
+    }
+    sdsl::remove(filename);
     filename.clear();
   }
 }
 
+size_type
+TempFile::diskUsage()
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  return temp_directories.disk_usage;
+}
+
+size_type
+TempFile::peakDiskUsage()
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  return temp_directories.peak_usage;
+}
+
+void
+TempFile::resetPeakDiskUsage()
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  temp_directories.peak_usage = temp_directories.disk_usage;
+}
+
+size_type
+TempFile::ramUsage()
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  return temp_directories.ram_usage;
+}
+
+void
+TempFile::setSize(const std::string& filename, size_type bytes)
+{
+  std::lock_guard<std::mutex> lock(temp_directories.mtx);
+  auto iter = temp_directories.ram_files.find(filename);
+  if(iter == temp_directories.ram_files.end()) { temp_directories.resize(filename, bytes); return; }
+  temp_directories.ram_usage += bytes - iter->second;
+  iter->second = bytes;
+}
+
 size_type
 readRows(const std::string& filename, std::vector<std::string>& rows, bool skip_empty_rows)
 {
@@ -170,7 +480,7 @@ readRows(const std::string& filename, std::vector<std::string>& rows, bool skip_
 }
 
 size_type
-fileSize(std::ifstream& file)
+fileSize(std::istream& file)
 {
   std::streamoff curr = file.tellg();
 
@@ -184,7 +494,7 @@ fileSize(std::ifstream& file)
 }
 
 size_type
-fileSize(std::ofstream& file)
+fileSize(std::ostream& file)
 {
   std::streamoff curr = file.tellp();
 
@@ -199,4 +509,136 @@ fileSize(std::ofstream& file)
 
 //------------------------------------------------------------------------------
 
+const size_type RADIX_BITS = 8;
+const size_type RADIX = static_cast<size_type>(1) << RADIX_BITS;
+
+// Use comparison sort for ranges shorter than this.
+const size_type RADIX_SORT_THRESHOLD = 64;
+
+struct RadixKeyComparator
+{
+  inline bool operator() (const range_type& a, const range_type& b) const
+  {
+    return (a.first < b.first);
+  }
+};
+
+inline size_type
+radixDigit(size_type key, size_type shift, size_type mask)
+{
+  return (key >> shift) & mask;
+}
+
+/*
+  Histogram space for sequentialRadixSort(). Each level of recursion uses its own offsets
+  and tails, so one RadixScratch per thread is enough for the entire recursion.
+*/
+struct RadixScratch
+{
+  std::vector<size_type> offsets, tails;
+
+  explicit RadixScratch(size_type key_bits) :
+    offsets(levels(key_bits) * (RADIX + 1), 0), tails(levels(key_bits) * RADIX, 0)
+  {
+  }
+
+  inline static size_type levels(size_type key_bits) { return (key_bits + RADIX_BITS - 1) / RADIX_BITS; }
+};
+
+/*
+  Sorts data[from, to) by the low key_bits bits of the keys, using buffer[from, to) as
+  working space.
+*/
+void
+sequentialRadixSort(std::vector<range_type>& data, std::vector<range_type>& buffer,
+  size_type from, size_type to, size_type key_bits, RadixScratch& scratch, size_type level)
+{
+  if(to - from <= 1 || key_bits == 0) { return; }
+  if(to - from < RADIX_SORT_THRESHOLD)
+  {
+    sequentialSort(data.begin() + from, data.begin() + to, RadixKeyComparator());
+    return;
+  }
+
+  size_type shift = (key_bits > RADIX_BITS ? key_bits - RADIX_BITS : 0);
+  size_type mask = (static_cast<size_type>(1) << (key_bits - shift)) - 1;
+
+  size_type* offsets = scratch.offsets.data() + level * (RADIX + 1);
+  size_type* tails = scratch.tails.data() + level * RADIX;
+  std::fill(offsets, offsets + RADIX + 1, 0);
+  for(size_type i = from; i < to; i++) { offsets[radixDigit(data[i].first, shift, mask) + 1]++; }
+  offsets[0] = from;
+  for(size_type digit = 1; digit <= RADIX; digit++) { offsets[digit] += offsets[digit - 1]; }
+  std::copy(offsets, offsets + RADIX, tails);
+  for(size_type i = from; i < to; i++)
+  {
+    buffer[tails[radixDigit(data[i].first, shift, mask)]++] = data[i];
+  }
+  std::copy(buffer.begin() + from, buffer.begin() + to, data.begin() + from);
+
+  for(size_type digit = 0; digit < RADIX; digit++)
+  {
+    sequentialRadixSort(data, buffer, offsets[digit], offsets[digit + 1], shift, scratch, level + 1);
+  }
+}
+
+void
+parallelRadixSort(std::vector<range_type>& data, size_type key_bits)
+{
+  if(data.size() <= 1 || key_bits == 0) { return; }
+
+  std::vector<range_type> buffer(data.size());
+  size_type shift = (key_bits > RADIX_BITS ? key_bits - RADIX_BITS : 0);
+  size_type mask = (static_cast<size_type>(1) << (key_bits - shift)) - 1;
+
+  // Count the most significant digits in each block.
+  size_type blocks = std::max(static_cast<size_type>(omp_get_max_threads()), static_cast<size_type>(1));
+  size_type block_size = (data.size() + blocks - 1) / blocks;
+  std::vector<std::vector<size_type>> counts(blocks, std::vector<size_type>(RADIX, 0));
+  #pragma omp parallel for schedule(static, 1)
+  for(size_type block = 0; block < blocks; block++)
+  {
+    size_type limit = std::min(data.size(), (block + 1) * block_size);
+    for(size_type i = block * block_size; i < limit; i++)
+    {
+      counts[block][radixDigit(data[i].first, shift, mask)]++;
+    }
+  }
+
+  // Convert the counts into starting offsets for each (digit, block) pair.
+  std::vector<size_type> bucket_starts(RADIX + 1, 0);
+  for(size_type digit = 0, offset = 0; digit < RADIX; digit++)
+  {
+    bucket_starts[digit] = offset;
+    for(size_type block = 0; block < blocks; block++)
+    {
+      size_type temp = counts[block][digit]; counts[block][digit] = offset; offset += temp;
+    }
+  }
+  bucket_starts[RADIX] = data.size();
+
+  // Distribute the pairs into the buckets.
+  #pragma omp parallel for schedule(static, 1)
+  for(size_type block = 0; block < blocks; block++)
+  {
+    size_type limit = std::min(data.size(), (block + 1) * block_size);
+    for(size_type i = block * block_size; i < limit; i++)
+    {
+      buffer[counts[block][radixDigit(data[i].first, shift, mask)]++] = data[i];
+    }
+  }
+  data.swap(buffer);
+
+  // Sort the buckets.
+  std::vector<RadixScratch> scratch(omp_get_max_threads(), RadixScratch(shift));
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(size_type digit = 0; digit < RADIX; digit++)
+  {
+    sequentialRadixSort(data, buffer, bucket_starts[digit], bucket_starts[digit + 1], shift,
+      scratch[omp_get_thread_num()], 0);
+  }
+}
+
+//------------------------------------------------------------------------------
+
 } // namespace gcsa